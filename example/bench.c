@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#ifdef __APPLE__
+#include <OpenGL/gl3.h>
+
+#include <glad/glad.h>
+#define GLFW_INCLUDE_GLCOREARB
+#include <GLFW/glfw3.h>
+#else
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#endif
+
+#include <msdfgl.h>
+
+#include FT_FONT_FORMATS_H
+
+/**
+ * Measures per-glyph generation time of one or more fonts, e.g. a TrueType
+ * (quadratic) and a CFF (cubic) version of the same family:
+ *
+ *     msdfglbench SourceSansPro-Regular.ttf SourceSansPro-Regular.otf
+ */
+
+#define BENCH_ROUNDS 10
+#define BENCH_FIRST 32
+#define BENCH_LAST 126
+
+static double now_ms(void) {
+    return (double)clock() * 1000.0 / CLOCKS_PER_SEC;
+}
+
+static double wall_ms(void) {
+    return glfwGetTime() * 1000.0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage msdfglbench <font file> [<font file> ...]\n");
+        return -1;
+    }
+
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+    GLFWwindow *window = glfwCreateWindow(64, 64, "MSDFGL Benchmark", NULL, NULL);
+    if (window == NULL) {
+        fprintf(stderr, "Failed to create GLFW window\n");
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        fprintf(stderr, "Failed to initialize GLAD\n");
+        return -1;
+    }
+
+    msdfgl_context_t ctx = msdfgl_create_context("330 core");
+    if (!ctx) {
+        fprintf(stderr, "Failed to create context!\n");
+        return -1;
+    }
+
+    FT_Library library;
+    FT_Init_FreeType(&library);
+
+    int nglyphs = BENCH_LAST - BENCH_FIRST + 1;
+    printf("%-40s %-10s %12s %12s\n", "font", "format", "ms/glyph", "cpu ms/glyph");
+
+    for (int i = 1; i < argc; ++i) {
+        FT_Face face;
+        if (FT_New_Face(library, argv[i], 0, &face)) {
+            fprintf(stderr, "Failed to load font %s\n", argv[i]);
+            continue;
+        }
+        const char *format = FT_Get_Font_Format(face);
+
+        double wall = 0.0, cpu = 0.0;
+        for (int round = 0; round < BENCH_ROUNDS; ++round) {
+            msdfgl_font_t font = msdfgl_load_font(ctx, argv[i], 4.0, 2.0, NULL);
+            if (!font) {
+                fprintf(stderr, "Failed to load font %s\n", argv[i]);
+                break;
+            }
+            glFinish();
+
+            double w = wall_ms(), c = now_ms();
+            msdfgl_generate_glyphs(font, BENCH_FIRST, BENCH_LAST);
+            glFinish();
+            wall += wall_ms() - w;
+            cpu += now_ms() - c;
+
+            msdfgl_destroy_font(font);
+        }
+
+        printf("%-40s %-10s %12.4f %12.4f\n", argv[i], format,
+               wall / BENCH_ROUNDS / nglyphs, cpu / BENCH_ROUNDS / nglyphs);
+        FT_Done_Face(face);
+    }
+
+    FT_Done_FreeType(library);
+    msdfgl_destroy_context(ctx);
+
+    glfwTerminate();
+    return 0;
+}
@@ -34,10 +34,10 @@ const char *vertexShaderSource = "#version 330 core\n"
 const char *fragmentShaderSource = "#version 330 core\n"
                                    "precision mediump float;\n"
                                    "in vec2 text_pos;\n"
-                                   "uniform sampler2D tex;\n"
+                                   "uniform sampler2DArray tex;\n"
                                    "out vec4 color;\n"
                                    "void main() {\n"
-                                   "color = texture(tex, text_pos);\n"
+                                   "color = texture(tex, vec3(text_pos, 0.0));\n"
                                    "}\n";
 
 int main(int argc, char *argv[]) {
@@ -156,7 +156,7 @@ int main(int argc, char *argv[]) {
         glUseProgram(shaderProgram);
 
         glActiveTexture(GL_TEXTURE8);
-        glBindTexture(GL_TEXTURE_2D, _msdfgl_atlas_texture(font));
+        glBindTexture(GL_TEXTURE_2D_ARRAY, _msdfgl_atlas_texture(font));
         glUniform1i(texture_uniform, 8);
 
         glBindVertexArray(vao);
@@ -165,7 +165,7 @@ int main(int argc, char *argv[]) {
         glEnableVertexAttribArray(0);
         glDrawArrays(GL_TRIANGLES, 0, 6);
 
-        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
 
         glUseProgram(0);
 
@@ -1,11 +1,15 @@
 
 precision highp float;
 in vec2 text_pos;
+flat in float text_page;
+/* Resolution of the glyph on the atlas relative to the font's. */
+flat in float text_scale;
 in vec4 text_color;
 in float strength;
 out vec4 color;
 
-uniform sampler2D font_atlas;
+precision mediump sampler2DArray;
+uniform sampler2DArray font_atlas;
 uniform mat4 font_projection;
 
 float median(float r, float g, float b) {
@@ -19,8 +23,8 @@ void main() {
     /* Invert the strength so that 1.0 becomes bold and 0.0 becomes thin */
     float threshold = 1.0 - strength;
 
-    vec2 msdfUnit = pxRange/vec2(textureSize(font_atlas, 0));
-    vec3 s = texture(font_atlas, coords).rgb;
+    vec2 msdfUnit = pxRange * text_scale / vec2(textureSize(font_atlas, 0).xy);
+    vec3 s = texture(font_atlas, vec3(coords, text_page)).rgb;
     float sigDist = median(s.r, s.g, s.b) - threshold;
     sigDist *= dot(msdfUnit, 0.5/fwidth(coords));
     float opacity = clamp(sigDist + 0.5, 0.0, 1.0);
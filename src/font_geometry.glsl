@@ -12,6 +12,8 @@ in VS_OUT {
 } gs_in[];
 
 out vec2 text_pos;
+flat out float text_page;
+flat out float text_scale;
 out vec4 text_color;
 out float strength;
 
@@ -30,7 +32,7 @@ void main() {
 
     vec4 font_size = vec4(gs_in[0].size * dpi / 72.0 / units_per_em, 1.0, 1.0);
 
-    int _offset = 8 * gs_in[0].glyph;
+    int _offset = 10 * gs_in[0].glyph;
     vec2 text_offset = vec2(texelFetch(font_index, _offset + 0).r,
                             texelFetch(font_index, _offset + 1).r);
     vec2 glyph_texture_width = vec2(texelFetch(font_index, _offset + 2).r, 0.0 );
@@ -41,6 +43,8 @@ void main() {
 
     vec4 glyph_width = vec4(texelFetch(font_index, _offset + 6).r, 0.0, 0.0, 0.0) * font_size;
     vec4 glyph_height = vec4(0.0, texelFetch(font_index, _offset + 7).r, 0.0, 0.0) * font_size;
+    text_page = texelFetch(font_index, _offset + 8).r;
+    text_scale = texelFetch(font_index, _offset + 9).r;
 
     vec4 padding_x = vec4(padding, 0.0, 0.0, 0.0) * font_size;
     vec4 padding_y = vec4(0.0, padding, 0.0, 0.0) * font_size;
@@ -0,0 +1,67 @@
+/* Work groups are tiles of GEN_TILE_SIZE (msdfgl.c) pixels of a glyph. */
+layout (local_size_x = 8, local_size_y = 8) in;
+
+/* The buffers of the fragment path, as storage buffers. Points are packed
+   pairs of 16-bit font units. */
+layout (std430, binding = 0) readonly buffer metadata_buffer { uint metadata[]; };
+layout (std430, binding = 1) readonly buffer point_buffer { int point_data[]; };
+layout (std430, binding = 2) readonly buffer segment_buffer { vec4 segment_data[]; };
+
+/* Three texels per glyph, see msdf_vertex.glsl. */
+layout (std430, binding = 3) readonly buffer instance_buffer { ivec4 instance_data[]; };
+
+/* Per work group: instance, tile x | tile y << 16. */
+layout (std430, binding = 4) readonly buffer tile_buffer { uvec2 tiles[]; };
+
+/* All pages of the atlas, a layer each. Write-only, so it takes any of the
+   atlas formats without a format qualifier. */
+layout (binding = 0) uniform writeonly image2DArray atlas;
+
+uniform float range;
+uniform int tile_offset;
+
+int meta_offset;
+int point_offset;
+int segment_offset;
+
+ivec2 unpack_point(int point) {
+    return ivec2((point << 16) >> 16, point >> 16);
+}
+
+/* Accessors for the generator, see msdf_generator.glsl. */
+#define meta_at(i) metadata[meta_offset + (i)]
+#define segment_at(e, i) segment_data[3 * (e) + (i)]
+#define point_at(i) (vec2(unpack_point(point_data[int(i)])) / POINT_SCALE)
+
+vec3 msdf_distance(vec2 p);
+
+void main() {
+    uvec2 tile = tiles[tile_offset + int(gl_WorkGroupID.x)];
+    int instance = 3 * int(tile.x);
+    ivec4 area = instance_data[instance];
+    ivec4 data = instance_data[instance + 1];
+
+    vec2 offset = intBitsToFloat(area.xy);
+    vec2 size = intBitsToFloat(area.zw);
+    vec2 translate = intBitsToFloat(data.xy);
+    meta_offset = data.z;
+    point_offset = data.w;
+    ivec4 extra = instance_data[instance + 2];
+    segment_offset = extra.x;
+    int page = extra.y;
+    vec2 scale = vec2(intBitsToFloat(extra.z));
+
+    /* The pixels whose centers the fragment path would rasterize. */
+    ivec2 pixel = ivec2(tile.y & 0xffffu, tile.y >> 16) * ivec2(gl_WorkGroupSize.xy) +
+                  ivec2(gl_LocalInvocationID.xy);
+    vec2 coords = vec2(pixel) + 0.5;
+    if (coords.x >= size.x || coords.y >= size.y)
+        return;
+
+    vec2 p = ((coords + 0.49) / scale) - vec2(translate.x, -translate.y);
+    p.y  = (size.y / scale.y) - p.y;
+
+    vec3 d = msdf_distance(p);
+
+    imageStore(atlas, ivec3(ivec2(offset) + pixel, page), vec4(d / range + 0.5, 1.0));
+}
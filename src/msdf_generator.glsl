@@ -0,0 +1,504 @@
+
+#define IDX_CURR 0
+#define IDX_SHAPE 1
+#define IDX_INNER 2
+#define IDX_OUTER 3
+#define IDX_RED 0
+#define IDX_GREEN 1
+#define IDX_BLUE 2
+#define IDX_NEGATIVE 0
+#define IDX_POSITIVE 1
+#define IDX_MAX_INNER 0
+#define IDX_MIN_OUTER 1
+
+/**
+ * Distance computation of the generator, shared by the fragment and compute
+ * shaders. They provide the accessors of the serialized glyph data:
+ *
+ *     meta_at(i)        word i of the glyph's metadata
+ *     segment_at(e, i)  texel i of the segment table entry e
+ *     point_at(i)       point i of the point data
+ *
+ * and the glyph's `point_offset` and `segment_offset`, see
+ * msdfgl_serializer.h.
+ */
+
+/* Single-channel fields have all segments white and take the true distance
+   of the nearest one, without the pseudo-distances the channels of a
+   multi-channel field are built from. */
+uniform bool single_channel;
+
+/* Points are stored in font units, SERIALIZER_SCALE on the CPU side. */
+const float POINT_SCALE = 64.0;
+
+#define meta_float_at(i) uintBitsToFloat(meta_at(i))
+
+const float PI = 3.1415926535897932384626433832795;
+const int CUBIC_SEARCH_STARTS = 4;
+const int CUBIC_SEARCH_STEPS = 4;
+const float INFINITY = 3.402823466e+38;
+/* SERIALIZER_GRID_HEADER on the CPU side. */
+const int GRID_HEADER = 6;
+
+const uint BLACK = 0u;
+const uint RED = 1u;
+const uint GREEN = 2u;
+const uint BLUE = 4u;
+const uint YELLOW = RED | GREEN;
+const uint MAGENTA = BLUE | RED;
+const uint CYAN = BLUE | GREEN;
+const uint WHITE = RED | GREEN | BLUE;
+
+struct segment {
+    vec3 min_true;
+    vec2 mins[2];
+    int nearest;
+};
+
+struct workspace {
+    segment segments[4 * 3];
+
+    /* The farthest inside of the positive contours and the farthest outside
+       of the negative ones, and the nearest contours of either winding on
+       either side, IDX_NEGATIVE or IDX_POSITIVE + 2 * (winding > 0). */
+    vec3 extremes[2];
+    vec3 nearest_contours[4];
+};
+
+workspace ws;
+
+vec3 signed_distance_linear(vec2 p0, vec2 p1, vec2 origin);
+vec3 signed_distance_quad(vec2 p0, vec2 p1, vec2 p2, vec2 origin);
+vec3 signed_distance_cubic(vec2 p0, vec2 p1, vec2 p2, vec2 p3, vec2 origin);
+void add_segment_true_distance(int segment_index, int e, vec3 d);
+vec3 get_pixel_distance(vec2);
+
+vec2 orthonormal(vec2 v) {float len = length(v); return vec2(v.y / len, -v.x / len);}
+float cross_(vec2 a, vec2 b) { return a.x * b.y - a.y * b.x; }
+/* Points on the line of a segment take a side, as in msdfgen. */
+float non_zero_sign(float f) {return f > 0.0 ? 1.0 : -1.0;}
+float median(vec3 d) {return max(min(d.r, d.g), min(max(d.r, d.g), d.b));}
+void add_segment_pseudo_distance(int segment_index, vec2 d);
+vec2 distance_to_pseudo_distance(int e, vec3 d, vec2 p);
+bool point_facing_edge(int e, int points, int npoints, vec2 p, float param);
+float add_segment(int e, vec2 point);
+void set_contour_edge(int winding, vec2 point);
+void reset_segment(int s);
+void set_far_contour(int winding, float far, vec2 point);
+float compute_distance(int segment_index, vec2 point);
+
+
+bool less(vec2 a, vec2 b) {
+    return abs(a.x) < abs(b.x) || (abs(a.x) == abs(b.x) && a.y < b.y);
+}
+
+
+/* Multi-channel signed distance of the point p from the glyph. */
+vec3 msdf_distance(vec2 p) {
+    ws.extremes[IDX_MAX_INNER] = vec3(-INFINITY);
+    ws.extremes[IDX_MIN_OUTER] = vec3(INFINITY);
+    for (int i = 0; i < 4; ++i)
+        ws.nearest_contours[i] = vec3(-INFINITY);
+
+    for (int i = 0; i < (4 * 3); ++i)
+        reset_segment(i);
+
+    /* The cell of the pixel in the glyph's grid, see msdfgl_serializer.h.
+       Pixels on the border may fall just outside of the grid. */
+    int n = int(meta_at(0));
+    vec2 origin = vec2(meta_float_at(1), meta_float_at(2));
+    vec2 cell_size = vec2(meta_float_at(3), meta_float_at(4));
+    float reach = meta_float_at(5);
+
+    ivec2 cell = clamp(ivec2(floor((p - origin) / cell_size)), 0, n - 1);
+    vec2 cell_min = origin + vec2(cell) * cell_size;
+    vec2 outside = max(max(cell_min - p, p - cell_min - cell_size), 0.0);
+
+    int cell_index = GRID_HEADER + 2 * (cell.y * n + cell.x);
+    int list = int(meta_at(cell_index));
+    uint cell_info = meta_at(cell_index + 1);
+    int nsegments = int(cell_info >> 3);
+
+    /* The listed segments are in table order, so contours follow each other. */
+    int contour = -1;
+    int winding = 0;
+    float nearest = INFINITY;
+    for (int _i = 0; _i < nsegments; ++_i) {
+        int e = segment_offset + int(meta_at(list + _i));
+        int header = int(segment_at(e, 0).w);
+
+        if (header >> 1 != contour) {
+            if (contour >= 0)
+                set_contour_edge(winding, p);
+            contour = header >> 1;
+            winding = (header & 1) != 0 ? 1 : -1;
+        }
+        nearest = min(nearest, add_segment(e, p));
+    }
+    if (contour >= 0)
+        set_contour_edge(winding, p);
+
+    /* Nothing further than `far` is known, unlisted segments may be closer.
+       Channels without a listed segment of their color are still at
+       -INFINITY, and are clamped with the rest. */
+    vec3 d;
+    float far = reach - length(outside);
+    uint around = (cell_info >> 1) & 3u;
+    if (nearest > far) {
+        d = vec3((cell_info & 1u) != 0u ? far : -far);
+    } else {
+        if (around != 0u)
+            set_far_contour(around == 1u ? 1 : -1, far, p);
+        d = clamp(get_pixel_distance(p), -far, far);
+    }
+
+    return d;
+}
+
+void merge_segment(int s, int other) {
+    if (less(ws.segments[other].min_true.xy, ws.segments[s].min_true.xy)) {
+        ws.segments[s].min_true = ws.segments[other].min_true;
+
+        ws.segments[s].nearest = ws.segments[other].nearest;
+    }
+    if (less(ws.segments[other].mins[IDX_NEGATIVE], ws.segments[s].mins[IDX_NEGATIVE]))
+        ws.segments[s].mins[IDX_NEGATIVE] = ws.segments[other].mins[IDX_NEGATIVE];
+    if (less(ws.segments[other].mins[IDX_POSITIVE], ws.segments[s].mins[IDX_POSITIVE])) {
+        ws.segments[s].mins[IDX_POSITIVE] = ws.segments[other].mins[IDX_POSITIVE];
+    }
+}
+
+void merge_multi_segment(int e, int other) {
+    merge_segment(e * 3 + IDX_RED, other * 3 + IDX_RED);
+    merge_segment(e * 3 + IDX_GREEN, other * 3 + IDX_GREEN);
+    merge_segment(e * 3 + IDX_BLUE, other * 3 + IDX_BLUE);
+}
+
+/* Returns the distance of the point from the segment. */
+float add_segment(int e, vec2 point) {
+    vec4 info = segment_at(e, 0);
+    int cur_points = point_offset + int(info.x);
+    int cur_npoints = int(info.y);
+    uint s_color = uint(info.z);
+
+    vec3 d;
+    if (cur_npoints == 2)
+        d = signed_distance_linear(point_at(cur_points),
+                                   point_at(cur_points + 1),
+                                   point);
+    else if (cur_npoints == 3)
+        d = signed_distance_quad(point_at(cur_points),
+                                 point_at(cur_points + 1),
+                                 point_at(cur_points + 2),
+                                 point);
+    else
+        d = signed_distance_cubic(point_at(cur_points),
+                                  point_at(cur_points + 1),
+                                  point_at(cur_points + 2),
+                                  point_at(cur_points + 3),
+                                  point);
+
+    if ((s_color & RED) > 0u)
+        add_segment_true_distance(IDX_CURR * 3 + IDX_RED, e, d);
+    if ((s_color & GREEN) > 0u)
+        add_segment_true_distance(IDX_CURR * 3 + IDX_GREEN, e, d);
+    if ((s_color & BLUE) > 0u)
+        add_segment_true_distance(IDX_CURR * 3 + IDX_BLUE, e, d);
+
+    if (!single_channel && point_facing_edge(e, cur_points, cur_npoints, point, d.z)) {
+
+        vec2 pd = distance_to_pseudo_distance(e, d, point);
+        if ((s_color & RED) > 0u)
+            add_segment_pseudo_distance(IDX_CURR * 3 + IDX_RED, pd);
+        if ((s_color & GREEN) > 0u)
+            add_segment_pseudo_distance(IDX_CURR * 3 + IDX_GREEN, pd);
+        if ((s_color & BLUE) > 0u)
+            add_segment_pseudo_distance(IDX_CURR * 3 + IDX_BLUE, pd);
+    }
+    return abs(d.x);
+}
+
+vec3 get_distance(int segment_index, vec2 point) {
+    vec3 d;
+    d.r = compute_distance(segment_index * 3 + IDX_RED, point);
+    d.g = compute_distance(segment_index * 3 + IDX_GREEN, point);
+    d.b = compute_distance(segment_index * 3 + IDX_BLUE, point);
+    return d;
+}
+
+void set_contour_edge(int winding, vec2 point) {
+
+    vec3 d = get_distance(IDX_CURR, point);
+
+    merge_multi_segment(IDX_SHAPE, IDX_CURR);
+    if (winding > 0 && median(d) >= 0.0)
+        merge_multi_segment(IDX_INNER, IDX_CURR);
+    if (winding < 0 && median(d) <= 0.0)
+        merge_multi_segment(IDX_OUTER, IDX_CURR);
+
+    if (winding > 0 && median(d) > median(ws.extremes[IDX_MAX_INNER]))
+        ws.extremes[IDX_MAX_INNER] = d;
+    if (winding < 0 && median(d) < median(ws.extremes[IDX_MIN_OUTER]))
+        ws.extremes[IDX_MIN_OUTER] = d;
+
+    int i = (median(d) < 0.0 ? IDX_NEGATIVE : IDX_POSITIVE) + (winding > 0 ? 2 : 0);
+    if (abs(median(d)) < abs(median(ws.nearest_contours[i])))
+        ws.nearest_contours[i] = d;
+
+    /* The next contour starts over. */
+    reset_segment(IDX_CURR * 3 + IDX_RED);
+    reset_segment(IDX_CURR * 3 + IDX_GREEN);
+    reset_segment(IDX_CURR * 3 + IDX_BLUE);
+}
+
+/* The contours around the cell without listed segments, as one contour which
+   is `far` away, on the inside of those winding positively. */
+void set_far_contour(int winding, float far, vec2 point) {
+    float d = winding > 0 ? far : -far;
+    for (int i = IDX_CURR * 3; i < IDX_CURR * 3 + 3; ++i) {
+        ws.segments[i].min_true = vec3(d, 0.0, 0.5);
+        ws.segments[i].mins[winding > 0 ? IDX_POSITIVE : IDX_NEGATIVE] = vec2(d, 0.0);
+    }
+    set_contour_edge(winding, point);
+}
+
+void reset_segment(int s) {
+    ws.segments[s].mins[IDX_NEGATIVE].x = -INFINITY;
+    ws.segments[s].mins[IDX_POSITIVE].x = -INFINITY;
+    ws.segments[s].min_true.x = -INFINITY;
+    ws.segments[s].nearest = -1;
+}
+
+vec2 distance_to_pseudo_distance(int e, vec3 d, vec2 p) {
+    if (d.z >= 0.0 && d.z <= 1.0)
+        return d.xy;
+
+    vec4 info = segment_at(e, 0);
+    vec4 dirs = segment_at(e, 1);
+    int points = point_offset + int(info.x);
+    int npoints = int(info.y);
+
+    vec2 dir = d.z < 0.0 ? dirs.xy : dirs.zw;
+    vec2 aq = p - point_at(d.z < 0.0 ? points : points + npoints - 1);
+    float ts = dot(aq, dir);
+    if (d.z < 0.0 ? ts < 0.0 : ts > 0.0) {
+        float pseudo_distance = cross_(aq, dir);
+        if (abs(pseudo_distance) <= abs(d.x)) {
+            d.x = pseudo_distance;
+            d.y = 0.0;
+        }
+    }
+    return d.xy;
+}
+
+void add_segment_true_distance(int segment_index, int e, vec3 d) {
+    bool is_less = less(d.xy, ws.segments[segment_index].min_true.xy);
+    ws.segments[segment_index].min_true =
+        is_less ? d : ws.segments[segment_index].min_true;
+
+    ws.segments[segment_index].nearest =
+        is_less ? e : ws.segments[segment_index].nearest;
+}
+
+
+void add_segment_pseudo_distance(int segment_index, vec2 d) {
+    int i = d.x < 0.0 ? IDX_NEGATIVE : IDX_POSITIVE;
+    vec2 _d = ws.segments[segment_index].mins[i];
+    ws.segments[segment_index].mins[i] = less(d, _d) ? d : _d;
+}
+
+bool point_facing_edge(int e, int points, int npoints, vec2 p, float param) {
+
+    if (param >= 0.0 && param <= 1.0)
+        return true;
+
+    /* Directions at the segment's ends, and those of its neighbours at the
+       shared end points. */
+    vec4 dirs = segment_at(e, 1);
+    vec4 neighbour_dirs = segment_at(e, 2);
+
+    vec2 prev_edge_dir = -neighbour_dirs.xy;
+    vec2 edge_dir = param < 0.0 ? dirs.xy : -dirs.zw;
+    vec2 next_edge_dir = neighbour_dirs.zw;
+    vec2 point_dir = p - point_at(param < 0.0 ? points : points + npoints - 1);
+    return dot(point_dir, edge_dir) >=
+           dot(point_dir, param < 0.0 ? prev_edge_dir : next_edge_dir);
+}
+
+float compute_distance(int segment_index, vec2 point) {
+    if (single_channel)
+        return ws.segments[segment_index].min_true.x;
+
+    int i = ws.segments[segment_index].min_true.xy.x < 0.0 ? IDX_NEGATIVE : IDX_POSITIVE;
+    float min_distance = ws.segments[segment_index].mins[i].x;
+
+    if (ws.segments[segment_index].nearest == -1) return min_distance;
+    vec2 d = distance_to_pseudo_distance(ws.segments[segment_index].nearest,
+                                         ws.segments[segment_index].min_true, point);
+    min_distance = abs(d.x) < abs(min_distance) ? d.x : min_distance;
+
+    return min_distance;
+}
+
+vec3 signed_distance_linear(vec2 p0, vec2 p1, vec2 origin) {
+    vec2 aq = origin - p0;
+    vec2 ab = p1 - p0;
+    float param = dot(aq, ab) / dot(ab, ab);
+    vec2 eq = (param > .5 ? p1 : p0) - origin;
+    float endpoint_distance = length(eq);
+    if (param > 0.0 && param < 1.0) {
+        float ortho_distance = dot(orthonormal(ab), aq);
+        if (abs(ortho_distance) < endpoint_distance)
+            return vec3(ortho_distance, 0, param);
+    }
+    return vec3(non_zero_sign(cross_(aq, ab)) *endpoint_distance,
+                abs(dot(normalize(ab), normalize(eq))),
+                param);
+}
+
+vec3 signed_distance_quad(vec2 p0, vec2 p1, vec2 p2, vec2 origin) {
+    vec2 qa = p0 - origin;
+    vec2 ab = p1 - p0;
+    vec2 br = p2 - p1 - ab;
+    float a = dot(br, br);
+    float b = 3.0 * dot(ab, br);
+    float c = 2.0 * dot(ab, ab) + dot(qa, br);
+    float d = dot(qa, ab);
+    float coeffs[3];
+    float _a = b / a;
+    int solutions;
+
+    float a2 = _a * _a;
+    float q = (a2 - 3.0 * (c / a)) / 9.0;
+    float r = (_a * (2.0 * a2 - 9.0 * (c / a)) + 27.0 * (d / a)) / 54.0;
+    float r2 = r * r;
+    float q3 = q * q * q;
+    float A, B;
+    _a /= 3.0;
+    float t = r / sqrt(q3);
+    t = t < -1.0 ? -1.0 : t;
+    t = t > 1.0 ? 1.0 : t;
+    t = acos(t);
+    A = -pow(abs(r) + sqrt(r2 - q3), 1.0 / 3.0);
+    A = r < 0.0 ? -A : A;
+    B = A == 0.0 ? 0.0 : q / A;
+    if (r2 < q3) {
+        q = -2.0 * sqrt(q);
+        coeffs[0] = q * cos(t / 3.0) - _a;
+        coeffs[1] = q * cos((t + 2.0 * PI) / 3.0) - _a;
+        coeffs[2] = q * cos((t - 2.0 * PI) / 3.0) - _a;
+        solutions = 3;
+    } else {
+        coeffs[0] = (A + B) - _a;
+        coeffs[1] = -0.5 * (A + B) - _a;
+        coeffs[2] = 0.5 * sqrt(3.0) * (A - B);
+        solutions = abs(coeffs[2]) < 1.0e-14 ? 2 : 1;
+    }
+
+    float min_distance = non_zero_sign(cross_(ab, qa)) * length(qa); // distance from A
+    float param = -dot(qa, ab) / dot(ab, ab);
+    // distance from B
+    float distance = non_zero_sign(cross_(p2 - p1, p2 - origin)) * length(p2 - origin);
+    if (abs(distance) < abs(min_distance)) {
+        min_distance = distance;
+        param = dot(origin - p1, p2 - p1) / dot(p2 - p1, p2 - p1);
+    }
+    for (int i = 0; i < solutions; ++i) {
+        if (coeffs[i] > 0.0 && coeffs[i] < 1.0) {
+            vec2 endpoint = p0 + ab * 2.0 * coeffs[i] + br * coeffs[i] * coeffs[i];
+            float distance =
+                non_zero_sign(cross_(p2 - p0, endpoint - origin)) * length(endpoint - origin);
+            if (abs(distance) <= abs(min_distance)) {
+                min_distance = distance;
+                param = coeffs[i];
+            }
+        }
+    }
+    vec2 v = vec2(min_distance, 0.0);
+    v.y = param > 1.0 ? abs(dot(normalize(p2 - p1), normalize(p2 - origin))) : v.y;
+    v.y = param < 0.0 ? abs(dot(normalize(ab), normalize(qa))) : v.y;
+
+    return vec3(v, param);
+}
+
+vec2 cubic_direction(vec2 p0, vec2 p1, vec2 p2, vec2 p3, float t) {
+    return mix(mix(p1 - p0, p2 - p1, t), mix(p2 - p1, p3 - p2, t), t);
+}
+
+vec3 signed_distance_cubic(vec2 p0, vec2 p1, vec2 p2, vec2 p3, vec2 origin) {
+    vec2 qa = p0 - origin;
+    vec2 ab = p1 - p0;
+    vec2 br = p2 - p1 - ab;
+    vec2 as = (p3 - p2) - (p2 - p1) - br;
+
+    /* End point directions, skipping a control point on top of its end point. */
+    vec2 start_dir = p1 != p0 ? p1 - p0 : p2 - p0;
+    vec2 end_dir = p3 != p2 ? p3 - p2 : p3 - p1;
+
+    float min_distance = non_zero_sign(cross_(start_dir, qa)) * length(qa); // distance from A
+    float param = -dot(qa, start_dir) / dot(start_dir, start_dir);
+
+    // distance from B
+    float distance = non_zero_sign(cross_(end_dir, p3 - origin)) * length(p3 - origin);
+    if (abs(distance) < abs(min_distance)) {
+        min_distance = distance;
+        param = dot(origin + end_dir - p3, end_dir) / dot(end_dir, end_dir);
+    }
+
+    /* Iterative minimum distance search, Newton's method from a few starting points. */
+    for (int i = 0; i <= CUBIC_SEARCH_STARTS; ++i) {
+        float t = float(i) / float(CUBIC_SEARCH_STARTS);
+        vec2 qe = qa + 3.0 * t * ab + 3.0 * t * t * br + t * t * t * as;
+        for (int step = 0; step < CUBIC_SEARCH_STEPS; ++step) {
+            vec2 d1 = 3.0 * ab + 6.0 * t * br + 3.0 * t * t * as;
+            vec2 d2 = 6.0 * br + 6.0 * t * as;
+            t -= dot(qe, d1) / (dot(d1, d1) + dot(qe, d2));
+            if (t <= 0.0 || t >= 1.0)
+                break;
+            qe = qa + 3.0 * t * ab + 3.0 * t * t * br + t * t * t * as;
+            distance = non_zero_sign(cross_(cubic_direction(p0, p1, p2, p3, t), qe)) * length(qe);
+            if (abs(distance) < abs(min_distance)) {
+                min_distance = distance;
+                param = t;
+            }
+        }
+    }
+
+    vec2 v = vec2(min_distance, 0.0);
+    v.y = param > 1.0 ? abs(dot(normalize(end_dir), normalize(p3 - origin))) : v.y;
+    v.y = param < 0.0 ? abs(dot(normalize(start_dir), normalize(qa))) : v.y;
+
+    return vec3(v, param);
+}
+
+vec3 get_pixel_distance(vec2 point) {
+    vec3 shape_distance = get_distance(IDX_SHAPE, point);
+    vec3 inner_distance = get_distance(IDX_INNER, point);
+    vec3 outer_distance = get_distance(IDX_OUTER, point);
+    float inner_d = median(inner_distance);
+    float outer_d = median(outer_distance);
+
+    bool inner = inner_d >= 0.0 && abs(inner_d) <= abs(outer_d);
+    bool outer = outer_d <= 0.0 && abs(outer_d) < abs(inner_d);
+    if (!inner && !outer)
+        return shape_distance;
+
+    /* Inside of the positive contours, the deepest of them is taken, and
+       outside of the negative ones likewise, if no nearer edge of the other
+       kind bounds it. Overlapping contours fill each other's insides so. */
+    vec3 d = inner ? inner_distance : outer_distance;
+    vec3 contour_distance = ws.extremes[inner ? IDX_MAX_INNER : IDX_MIN_OUTER];
+    float contour_d = median(contour_distance);
+    if (inner && abs(contour_d) < abs(outer_d) && contour_d > median(d))
+        d = contour_distance;
+    if (outer && abs(contour_d) < abs(inner_d) && contour_d < median(d))
+        d = contour_distance;
+
+    /* A nearer contour of the other winding on the same side. */
+    contour_distance = ws.nearest_contours[(median(d) < 0.0 ? IDX_NEGATIVE : IDX_POSITIVE) +
+                                           (inner ? 0 : 2)];
+    d = abs(median(contour_distance)) < abs(median(d)) ? contour_distance : d;
+    d = median(d) == median(shape_distance) ? shape_distance : d;
+
+    return d;
+}
@@ -1,10 +1,40 @@
-
 layout (location = 0) in vec2 vertex;
 
 precision mediump float;
+precision highp isamplerBuffer;
 uniform mat4 projection;
-uniform vec2 offset;
+
+/* Three texels per glyph, msdfgl_gen_instance on the CPU side:
+   area on the atlas (offset, size), translation of the outline, the
+   offsets of its serialized data, its page and its scale. Floats are stored
+   as their bits. */
+uniform isamplerBuffer instance_data;
+
+/* First instance of the draw, a draw is made per page. */
+uniform int instance_offset;
+
+flat out vec2 offset;
+flat out vec2 translate;
+flat out float glyph_height;
+flat out int meta_offset;
+flat out int point_offset;
+flat out int segment_offset;
+flat out vec2 scale;
 
 void main() {
-    gl_Position = projection * vec4(vertex.xy + offset, 1.0, 1.0);
+    int instance = 3 * (gl_InstanceID + instance_offset);
+    ivec4 area = texelFetch(instance_data, instance);
+    ivec4 data = texelFetch(instance_data, instance + 1);
+
+    offset = intBitsToFloat(area.xy);
+    vec2 size = intBitsToFloat(area.zw);
+    translate = intBitsToFloat(data.xy);
+    glyph_height = size.y;
+    meta_offset = data.z;
+    point_offset = data.w;
+    ivec4 extra = texelFetch(instance_data, instance + 2);
+    segment_offset = extra.x;
+    scale = vec2(intBitsToFloat(extra.z));
+
+    gl_Position = projection * vec4(vertex.xy * size + offset, 1.0, 1.0);
 }
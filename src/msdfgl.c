@@ -1,4 +1,5 @@
 #include <locale.h>
+#include <math.h>
 #include <wchar.h>
 
 #if defined(_MSC_VER)
@@ -16,16 +17,19 @@ typedef SSIZE_T ssize_t;
 #endif
 
 #include "msdfgl.h"
+#include "msdfgl_cache.h"
+#include "msdfgl_cpu.h"
 #include "msdfgl_map.h"
+#include "msdfgl_packer.h"
 #include "msdfgl_serializer.h"
+#include "msdfgl_worker.h"
 
 #include "_msdfgl_shaders.h" /* Auto-generated */
 
-/* Returns 1 if the code is a unicode control character. */
-static inline int _msdfgl_is_control(int32_t code) {
-    return (code <= 31) || (code >= 128 && code <= 159);
-}
-
+/**
+ * Side of the pixel tiles of the compute generator, its work group size.
+ */
+#define GEN_TILE_SIZE 8
 
 struct _msdfgl_atlas {
 
@@ -35,7 +39,8 @@ struct _msdfgl_atlas {
     GLfloat projection[4][4];
 
     /**
-     * 2D RGBA atlas texture containing all MSDF-glyph bitmaps.
+     * 2D RGBA array texture containing all MSDF-glyph bitmaps, a layer per
+     * page.
      */
     GLuint atlas_texture;
     GLuint atlas_framebuffer;
@@ -48,7 +53,7 @@ struct _msdfgl_atlas {
     GLuint index_buffer;
 
     /**
-     * Amount of glyphs currently rendered on the textures.
+     * Amount of index entries in use, including evicted ones awaiting reuse.
      */
     size_t nglyphs;
 
@@ -58,36 +63,108 @@ struct _msdfgl_atlas {
     size_t nallocated;
 
     int texture_width;
+    /**
+     * Internal format of the atlas texture.
+     */
+    GLenum format;
     /**
      * The amount of allocated texture height.
      */
     int texture_height;
+    /**
+     * The amount of allocated pages.
+     */
+    int npages;
+    int max_texture_height;
+    int max_pages;
 
     /**
-     * The location in the atlas where the next bitmap would be rendered.
+     * Placement of the bitmaps on the atlas texture.
      */
-    size_t offset_y;
-    size_t offset_x;
-    size_t y_increment;
+    msdfgl_packer_t packer;
 
     /**
      * Amount of pixels to leave blank between MSDF bitmaps.
      */
     int padding;
 
+    /**
+     * CPU side records of the index entries, and the evicted entries to be
+     * reused before new ones are added.
+     */
+    struct msdfgl_atlas_entry *entries;
+    size_t nentries_allocated;
+    int *free_entries;
+    size_t nfree;
+
+    /**
+     * Limit of the atlas texture size in bytes, 0 for none. Least recently
+     * used glyphs are evicted to stay below it.
+     */
+    size_t budget;
+
+    /**
+     * Counts frames, glyphs remember the value of their last use. Glyphs used
+     * at the current value are never evicted. Advanced by every msdfgl_render
+     * call, or only by msdfgl_atlas_next_frame once `explicit_frames` is set
+     * by its first call.
+     */
+    unsigned long frame;
+    int explicit_frames;
+
+    /**
+     * An ongoing compaction: the new layout, the texture the glyphs are being
+     * copied to and the moves, of which the first `nmoved` are done. The
+     * texture is 0 when there is none.
+     */
+    msdfgl_packer_t compact_packer;
+    GLuint compact_texture;
+    GLuint compact_framebuffer;
+    int compact_height;
+    struct msdfgl_compaction_move *moves;
+    size_t nmoves;
+    size_t nmoved;
+
 };
 
 
 struct _msdfgl_font {
     char *font_name;
 
+    /**
+     * The font file of fonts loaded from memory, and its hash once computed
+     * for the atlas cache.
+     */
+    const void *font_data;
+    size_t font_data_size;
+    uint64_t font_hash;
+    int hashed;
+
     float scale;
     float range;
 
+    /**
+     * Outline simplification tolerance in atlas pixels, 0 disables it.
+     */
+    float outline_tolerance;
+
+    /**
+     * Bounds of the scale chosen for each glyph from its detail, 0 to use
+     * `scale` for all glyphs.
+     */
+    float min_scale;
+    float max_scale;
+
     float vertical_advance;
 
     msdfgl_map_t character_index;
 
+    /**
+     * Atlas entries of the generated glyphs, keyed by FreeType glyph index.
+     * Several character codes may share one entry.
+     */
+    msdfgl_map_t glyph_index;
+
     msdfgl_atlas_t atlas;
 
     /**
@@ -105,10 +182,16 @@ struct _msdfgl_font {
      */
     GLuint _meta_input_buffer;
     GLuint _point_input_buffer;
+    GLuint _segment_input_buffer;
     GLuint _meta_input_texture;
     GLuint _point_input_texture;
+    GLuint _segment_input_texture;
 
-    int _direct_lookup_upper_limit;
+    /**
+     * Serialization workers, each with its own serialized outlines of the
+     * batch being generated. Kept between batches to avoid reallocating.
+     */
+    msdfgl_workers_t _workers;
 };
 
 typedef struct msdfgl_index_entry {
@@ -120,8 +203,199 @@ typedef struct msdfgl_index_entry {
     GLfloat bearing_y;
     GLfloat glyph_width;
     GLfloat glyph_height;
+    GLfloat page;
+    /* Resolution of the glyph relative to the font's scale. */
+    GLfloat scale;
 } msdfgl_index_entry;
 
+/**
+ * State of an atlas index entry.
+ */
+typedef struct msdfgl_atlas_entry {
+    /**
+     * Owner of the glyph, NULL after the font is destroyed.
+     */
+    msdfgl_font_t font;
+
+    /**
+     * Area of the bitmap, without padding.
+     */
+    msdfgl_packer_rect_t rect;
+    int page;
+
+    unsigned long last_use;
+
+    /**
+     * MSDFGL_ENTRY_*.
+     */
+    int state;
+} msdfgl_atlas_entry;
+
+#define MSDFGL_ENTRY_FREE 0
+#define MSDFGL_ENTRY_USED 1
+/* Placed by the batch being generated. */
+#define MSDFGL_ENTRY_PENDING 2
+
+/**
+ * Per-instance input of the generator, one instance per generated glyph. Read
+ * by the vertex shader as three GL_RGBA32I texels, the floats as their bits.
+ */
+typedef struct msdfgl_gen_instance {
+    GLfloat offset[2];
+    GLfloat size[2];
+    GLfloat translate[2];
+    GLint meta_offset;
+    GLint point_offset;
+    GLint segment_offset;
+    GLint page;
+    GLfloat scale;
+    /* Worker whose arena holds the glyph, for the CPU generator. The shaders
+       do not read it. */
+    GLint worker;
+} msdfgl_gen_instance;
+
+/**
+ * A glyph of a batch waiting for its place on the atlas.
+ */
+typedef struct msdfgl_placement {
+    GLfloat height;
+    int index;
+} msdfgl_placement;
+
+/**
+ * The new place of an entry in an ongoing compaction.
+ */
+typedef struct msdfgl_compaction_move {
+    int entry;
+    msdfgl_packer_rect_t rect;
+    int page;
+} msdfgl_compaction_move;
+
+/**
+ * Atlas cache files, written by msdfgl_save_atlas. The header is followed by
+ * sections at offsets aligned to CACHE_ALIGN, so that the index and the
+ * texture can be uploaded straight from the mapped file. Values are stored in
+ * the byte order of the writer, other machines see a header mismatch.
+ */
+#define CACHE_MAGIC "MSDFGLA"
+#define CACHE_VERSION 2
+#define CACHE_ALIGN 64
+
+typedef struct msdfgl_cache_header {
+    char magic[8];
+    uint32_t version;
+    /* 1 in the byte order of the writer. */
+    uint32_t byte_order;
+
+    /* The configuration of the atlas, which must match the loading one. */
+    uint32_t format;
+    int32_t texture_width;
+    int32_t padding;
+    int32_t packer;
+    int32_t page_height;
+    int32_t max_pages;
+
+    int32_t texture_height;
+    int32_t npages;
+    int32_t npacker_pages;
+    uint32_t nfonts;
+    uint64_t nglyphs;
+    uint64_t nfree;
+
+    /* Offsets of the sections. */
+    uint64_t fonts_offset;
+    uint64_t entries_offset;
+    uint64_t free_offset;
+    uint64_t pages_offset;
+    uint64_t index_offset;
+    uint64_t texture_offset;
+    /* Of the whole file, which tells truncated files apart. */
+    uint64_t size;
+} msdfgl_cache_header;
+
+/**
+ * A font on a cached atlas, with the key it was saved under and its character
+ * and glyph maps.
+ */
+typedef struct msdfgl_cache_font {
+    uint64_t hash;
+    float range;
+    float scale;
+    /* The settings which change the bitmaps of the glyphs. */
+    float outline_tolerance;
+    float min_scale;
+    float max_scale;
+    uint32_t _reserved;
+    uint64_t items_offset[2];
+    uint64_t nitems[2];
+} msdfgl_cache_font;
+
+typedef struct msdfgl_cache_item {
+    uint32_t code;
+    int32_t index;
+    float advance[2];
+} msdfgl_cache_item;
+
+typedef struct msdfgl_cache_entry {
+    /* Position of the owner in the fonts saved with the atlas, -1 for none. */
+    int32_t font;
+    int32_t state;
+    int32_t page;
+    int32_t rect[4];
+} msdfgl_cache_entry;
+
+typedef struct msdfgl_cache_page {
+    int32_t shelf_x;
+    int32_t shelf_y;
+    int32_t shelf_height;
+    int32_t height;
+    uint64_t area;
+    uint64_t nrects;
+    uint64_t rects_offset;
+} msdfgl_cache_page;
+
+/**
+ * An entry which may be evicted.
+ */
+typedef struct msdfgl_eviction {
+    unsigned long last_use;
+    int index;
+} msdfgl_eviction;
+
+static int _msdfgl_compare_eviction(const void *a, const void *b) {
+    const msdfgl_eviction *ea = (const msdfgl_eviction *)a;
+    const msdfgl_eviction *eb = (const msdfgl_eviction *)b;
+    if (ea->last_use != eb->last_use)
+        return ea->last_use < eb->last_use ? -1 : 1;
+    return ea->index - eb->index;
+}
+
+static int _msdfgl_compare_instance(const void *a, const void *b) {
+    return ((const msdfgl_gen_instance *)a)->page - ((const msdfgl_gen_instance *)b)->page;
+}
+
+static int _msdfgl_compare_placement(const void *a, const void *b) {
+    const msdfgl_placement *pa = (const msdfgl_placement *)a;
+    const msdfgl_placement *pb = (const msdfgl_placement *)b;
+    if (pa->height != pb->height)
+        return pa->height < pb->height ? 1 : -1;
+    return pa->index - pb->index;
+}
+
+/**
+ * A program whose shaders were compiled and linked without waiting for the
+ * driver. It is checked, and waited for, only when first used.
+ */
+typedef struct msdfgl_program_build {
+    /* Zero if the build was not started, or was already finished. */
+    GLuint program;
+    GLuint shaders[3];
+    int nshaders;
+    /* Binary cache file to store the program to once linked, NULL if none. */
+    char *cache_path;
+    uint64_t key;
+} msdfgl_program_build;
+
 struct _msdfgl_context {
     FT_Library ft_library;
 
@@ -130,17 +404,30 @@ struct _msdfgl_context {
     GLuint gen_shader;
 
     GLint _atlas_projection_uniform;
-    GLint _texture_offset_uniform;
-    GLint _translate_uniform;
-    GLint _scale_uniform;
     GLint _range_uniform;
-    GLint _glyph_height_uniform;
-
-    GLint _meta_offset_uniform;
-    GLint _point_offset_uniform;
+    GLint _single_channel_uniform;
+    GLint _instance_offset_uniform;
 
     GLint metadata_uniform;
     GLint point_data_uniform;
+    GLint segment_data_uniform;
+    GLint instance_data_uniform;
+
+    /**
+     * Compute shader generator, used instead of gen_shader on GL 4.3 and newer
+     * contexts. Zero if not available.
+     */
+    GLuint compute_shader;
+
+    GLint _compute_range_uniform;
+    GLint _compute_single_channel_uniform;
+    GLint _compute_tile_offset_uniform;
+    GLint _max_compute_groups;
+
+    /**
+     * Storage buffer of the tiles of a batch, see msdf_compute.glsl.
+     */
+    GLuint _tile_buffer;
 
     GLuint render_shader;
 
@@ -154,10 +441,52 @@ struct _msdfgl_context {
     GLint _units_per_em_uniform;
 
     GLint _max_texture_size;
+    GLint _max_texture_layers;
+
+    /**
+     * Directory of the program binary cache, NULL without one or if the
+     * driver cannot load program binaries.
+     */
+    char *_program_cache;
+
+    /**
+     * GLSL version of the shaders, NULL for the default.
+     */
+    char *_glsl_version;
+
+    /**
+     * Builds in progress of the programs above.
+     */
+    msdfgl_program_build _gen_build;
+    msdfgl_program_build _compute_build;
+    msdfgl_program_build _render_build;
+
+    /**
+     * Whether the driver compiles in the background, with
+     * GL_KHR_parallel_shader_compile or GL_ARB_parallel_shader_compile.
+     */
+    int _parallel_compile;
+
+    /**
+     * Maximum amount of threads used for serializing glyph outlines, and for
+     * generating them on the CPU.
+     */
+    int nthreads;
 
+    enum msdfgl_generator generator;
+
+    /**
+     * A unit quad, scaled to the area of each glyph.
+     */
     GLuint bbox_vao;
     GLuint bbox_vbo;
 
+    /**
+     * Texture buffer for the per-instance input of the generator.
+     */
+    GLuint _instance_buffer;
+    GLuint _instance_texture;
+
     int (*missing_glyph_cb)(msdfgl_font_t, int32_t, void *);
     void *missing_glyph_user_data;
 };
@@ -186,28 +515,38 @@ void _msdfgl_ortho(GLfloat left, GLfloat right, GLfloat bottom, GLfloat top,
     dest[3][3] = 1.0f;
 }
 
-int compile_shader(const char *source, GLenum type, GLuint *shader, const char *version) {
+/* Start compiling the concatenation of `nsources` sources, at most four,
+   without waiting for the result. Returns 0 on failure. */
+static GLuint _msdfgl_start_shader(const char *const *sources, int nsources, GLenum type,
+                                   const char *version) {
 
     /* Default to versio */
     if (!version)
         version = "330 core";
 
-    *shader = glCreateShader(type);
-    if (!*shader) {
+    GLuint shader = glCreateShader(type);
+    if (!shader) {
         fprintf(stderr, "failed to create shader\n");
+        return 0;
     }
 
-    const char *src[] = {"#version ", version, "\n", source};
+    const char *src[7] = {"#version ", version, "\n"};
+    for (int i = 0; i < nsources && i < 4; ++i)
+        src[3 + i] = sources[i];
 
-    glShaderSource(*shader, 4, src, NULL);
-    glCompileShader(*shader);
+    glShaderSource(shader, 3 + (nsources < 4 ? nsources : 4), src, NULL);
+    glCompileShader(shader);
+    return shader;
+}
 
+/* Returns whether a shader compiled, and prints its log if not. */
+static int _msdfgl_check_shader(GLuint shader) {
     GLint status;
-    glGetShaderiv(*shader, GL_COMPILE_STATUS, &status);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
     if (!status) {
         char log[1000];
         GLsizei len;
-        glGetShaderInfoLog(*shader, 1000, &len, log);
+        glGetShaderInfoLog(shader, 1000, &len, log);
         fprintf(stderr, "Error: compiling: %*s\n", len, log);
         return 0;
     }
@@ -215,94 +554,356 @@ int compile_shader(const char *source, GLenum type, GLuint *shader, const char *
     return 1;
 }
 
-msdfgl_context_t msdfgl_create_context(const char *version) {
-    msdfgl_context_t ctx = (msdfgl_context_t)calloc(1, sizeof(struct _msdfgl_context));
+/* Compile the concatenation of `nsources` sources, at most four. */
+int compile_shader_sources(const char *const *sources, int nsources, GLenum type, GLuint *shader,
+                           const char *version) {
+    *shader = _msdfgl_start_shader(sources, nsources, type, version);
+    return *shader && _msdfgl_check_shader(*shader);
+}
 
-/*
- * When compiling a DLL for Windows, GL bindings need to be loaded in the DLL code separately.
+int compile_shader(const char *source, GLenum type, GLuint *shader, const char *version) {
+    return compile_shader_sources(&source, 1, type, shader, version);
+}
+
+static int _msdfgl_has_extension(const char *name) {
+    GLint nextensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &nextensions);
+    for (GLint i = 0; i < nextensions; ++i) {
+        const char *extension = (const char *)glGetStringi(GL_EXTENSIONS, i);
+        if (extension && !strcmp(extension, name))
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * A stage of a program, compiled from the concatenation of its sources.
  */
-#ifdef _WIN32
-    gladLoadGL();
+typedef struct msdfgl_shader_stage {
+    GLenum type;
+    const char *sources[2];
+    int nsources;
+} msdfgl_shader_stage;
+
+/**
+ * Program binary cache files, named after the key of the program: the driver,
+ * the GLSL version and the sources. The binary follows the header.
+ */
+#define PROGRAM_CACHE_MAGIC "MSDFGLP"
+#define PROGRAM_CACHE_VERSION 1
+
+typedef struct msdfgl_program_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t format;
+    uint64_t key;
+    uint64_t length;
+} msdfgl_program_header;
+
+/**
+ * Whether program binaries can be read back and loaded, by GL 4.1 or
+ * GL_ARB_get_program_binary, with at least one binary format.
+ */
+static int _msdfgl_has_program_binary(void) {
+#ifdef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+    const char *gl_version = (const char *)glGetString(GL_VERSION);
+    if (!gl_version || strstr(gl_version, "OpenGL ES"))
+        return 0;
+
+    GLint major = 0, minor = 0, nformats = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if (major * 10 + minor >= 41 || _msdfgl_has_extension("GL_ARB_get_program_binary"))
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &nformats);
+    return nformats > 0;
+#else
+    return 0;
 #endif
+}
 
-    if (!ctx)
-        return NULL;
+static uint64_t _msdfgl_hash_string(const char *s, uint64_t seed) {
+    /* With the terminator, so that consecutive strings cannot run together. */
+    return s ? msdfgl_cache_hash(s, strlen(s) + 1, seed) : msdfgl_cache_hash("", 1, seed);
+}
 
-    FT_Error error = FT_Init_FreeType(&ctx->ft_library);
-    if (error) {
-        free(ctx);
-        return NULL;
+/**
+ * Key of a program in the binary cache. Binaries are only valid for the
+ * driver which produced them.
+ */
+static uint64_t _msdfgl_program_key(const msdfgl_shader_stage *stages, int nstages,
+                                    const char *version) {
+    uint64_t key = _msdfgl_hash_string((const char *)glGetString(GL_VENDOR), 0);
+    key = _msdfgl_hash_string((const char *)glGetString(GL_RENDERER), key);
+    key = _msdfgl_hash_string((const char *)glGetString(GL_VERSION), key);
+    key = _msdfgl_hash_string(version, key);
+    for (int i = 0; i < nstages; ++i) {
+        key = msdfgl_cache_hash(&stages[i].type, sizeof(GLenum), key);
+        for (int j = 0; j < stages[i].nsources; ++j)
+            key = _msdfgl_hash_string(stages[i].sources[j], key);
     }
+    return key;
+}
 
-    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &ctx->_max_texture_size);
+/**
+ * Load a program from the binary cache. Returns 0 if there is none, or if the
+ * driver rejects it, e.g. after an update.
+ */
+static GLuint _msdfgl_load_program(const char *path, uint64_t key) {
+#ifdef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+    msdfgl_cache_file_t file;
+    if (msdfgl_cache_open(&file, path))
+        return 0;
 
-    GLuint vertex_shader, geometry_shader, fragment_shader;
-    if (!compile_shader(_msdf_vertex, GL_VERTEX_SHADER, &vertex_shader, version))
-        return NULL;
-    if (!compile_shader(_msdf_fragment, GL_FRAGMENT_SHADER, &fragment_shader, version))
-        return NULL;
+    GLuint program = 0;
+    const msdfgl_program_header *header = (const msdfgl_program_header *)file.data;
+    if (file.size < sizeof(msdfgl_program_header) ||
+        memcmp(header->magic, PROGRAM_CACHE_MAGIC, sizeof(header->magic)) ||
+        header->version != PROGRAM_CACHE_VERSION || header->key != key ||
+        header->length != file.size - sizeof(msdfgl_program_header) ||
+        header->length > INT32_MAX)
+        goto error;
 
-    if (!(ctx->gen_shader = glCreateProgram()))
-        return NULL;
+    /* Formats the driver does not know would raise an error. */
+    GLint nformats = 0, *formats = NULL;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &nformats);
+    if (nformats <= 0 || !(formats = (GLint *)calloc(nformats, sizeof(GLint))))
+        goto error;
+    glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats);
+    int known = 0;
+    for (GLint i = 0; i < nformats; ++i)
+        known |= (GLenum)formats[i] == header->format;
+    free(formats);
+    if (!known)
+        goto error;
+
+    if (!(program = glCreateProgram()))
+        goto error;
+    glProgramBinary(program, header->format, file.data + sizeof(msdfgl_program_header),
+                    (GLsizei)header->length);
+
+    GLint status;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (!status) {
+        glDeleteProgram(program);
+        program = 0;
+    }
+
+error:
+    msdfgl_cache_close(&file);
+    return program;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * Store the binary of a linked program in the cache. Failing to do so only
+ * means compiling it again next time.
+ */
+static void _msdfgl_save_program(GLuint program, const char *path, uint64_t key) {
+#ifdef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    char *tmp_path = NULL;
+    void *binary = malloc(length);
+    if (!binary)
+        goto error;
+
+    msdfgl_program_header header;
+    memset(&header, 0, sizeof(msdfgl_program_header));
+    GLsizei written = 0;
+    GLenum format;
+    glGetProgramBinary(program, length, &written, &format, binary);
+    if (written <= 0)
+        goto error;
+    memcpy(header.magic, PROGRAM_CACHE_MAGIC, sizeof(header.magic));
+    header.version = PROGRAM_CACHE_VERSION;
+    header.format = format;
+    header.key = key;
+    header.length = (uint64_t)written;
+
+    /* Written aside under a unique name and renamed into place, so that other
+       processes never read half a file, nor write into the same one. */
+    FILE *f = msdfgl_cache_create(path, &tmp_path);
+    if (!f)
+        goto error;
+    int failed = fwrite(&header, sizeof(msdfgl_program_header), 1, f) != 1 ||
+                 fwrite(binary, 1, (size_t)written, f) != (size_t)written;
+    if (fclose(f) || failed || msdfgl_cache_replace(tmp_path, path))
+        remove(tmp_path);
+
+error:
+    if (binary)
+        free(binary);
+    if (tmp_path)
+        free(tmp_path);
+#endif
+}
+
+/**
+ * Drop a build, whether it was started or not.
+ */
+static void _msdfgl_abandon_program(msdfgl_program_build *build) {
+    for (int i = 0; i < build->nshaders; ++i)
+        glDeleteShader(build->shaders[i]);
+    if (build->program)
+        glDeleteProgram(build->program);
+    if (build->cache_path)
+        free(build->cache_path);
+    memset(build, 0, sizeof(msdfgl_program_build));
+}
+
+/**
+ * Start building a program, from the binary cache of the context if it has
+ * one. Nothing waits for the driver here, which may compile and link in the
+ * background until the build is finished. Returns -1 on failure.
+ */
+static int _msdfgl_start_program(msdfgl_context_t ctx, msdfgl_program_build *build,
+                                 const msdfgl_shader_stage *stages, int nstages,
+                                 const char *version) {
+    memset(build, 0, sizeof(msdfgl_program_build));
+    if (!version)
+        version = "330 core";
+
+    if (ctx->_program_cache &&
+        (build->cache_path = malloc(strlen(ctx->_program_cache) + 32))) {
+        build->key = _msdfgl_program_key(stages, nstages, version);
+        sprintf(build->cache_path, "%s/msdfgl-%016llx.bin", ctx->_program_cache,
+                (unsigned long long)build->key);
+
+        if ((build->program = _msdfgl_load_program(build->cache_path, build->key))) {
+            free(build->cache_path);
+            build->cache_path = NULL;
+            return 0;
+        }
+    }
+
+    for (; build->nshaders < nstages; ++build->nshaders) {
+        const msdfgl_shader_stage *stage = &stages[build->nshaders];
+        build->shaders[build->nshaders] =
+            _msdfgl_start_shader(stage->sources, stage->nsources, stage->type, version);
+        if (!build->shaders[build->nshaders])
+            goto error;
+    }
+
+    if (!(build->program = glCreateProgram()))
+        goto error;
+    for (int i = 0; i < nstages; ++i)
+        glAttachShader(build->program, build->shaders[i]);
+#ifdef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+    if (build->cache_path)
+        glProgramParameteri(build->program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+#endif
+    glLinkProgram(build->program);
+    return 0;
 
-    glAttachShader(ctx->gen_shader, vertex_shader);
-    glAttachShader(ctx->gen_shader, fragment_shader);
+error:
+    _msdfgl_abandon_program(build);
+    return -1;
+}
 
-    glLinkProgram(ctx->gen_shader);
-    glDeleteShader(vertex_shader);
-    glDeleteShader(fragment_shader);
+/**
+ * Wait for a build to finish, and store the program in the binary cache.
+ * Returns the linked program, or 0 if the build failed or was not started.
+ */
+static GLuint _msdfgl_finish_program(msdfgl_program_build *build) {
+    GLuint program = build->program;
+    if (!program)
+        return 0;
 
     GLint status;
-    glGetProgramiv(ctx->gen_shader, GL_LINK_STATUS, &status);
-    if (!status)
-        return NULL;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (!status) {
+        for (int i = 0; i < build->nshaders; ++i)
+            _msdfgl_check_shader(build->shaders[i]);
+        _msdfgl_abandon_program(build);
+        return 0;
+    }
 
-    ctx->missing_glyph_cb = NULL;
+    if (build->cache_path)
+        _msdfgl_save_program(program, build->cache_path, build->key);
+
+    /* Keep the program, release the rest. */
+    build->program = 0;
+    _msdfgl_abandon_program(build);
+    return program;
+}
+
+static int _msdfgl_start_gen(msdfgl_context_t ctx) {
+    const msdfgl_shader_stage stages[] = {
+        {GL_VERTEX_SHADER, {_msdf_vertex}, 1},
+        {GL_FRAGMENT_SHADER, {_msdf_fragment, _msdf_generator}, 2},
+    };
+    return _msdfgl_start_program(ctx, &ctx->_gen_build, stages, 2, ctx->_glsl_version);
+}
+
+static int _msdfgl_finish_gen(msdfgl_context_t ctx) {
+    if (!(ctx->gen_shader = _msdfgl_finish_program(&ctx->_gen_build)))
+        return -1;
 
     ctx->_atlas_projection_uniform = glGetUniformLocation(ctx->gen_shader, "projection");
-    ctx->_texture_offset_uniform = glGetUniformLocation(ctx->gen_shader, "offset");
-    ctx->_translate_uniform = glGetUniformLocation(ctx->gen_shader, "translate");
-    ctx->_scale_uniform = glGetUniformLocation(ctx->gen_shader, "scale");
     ctx->_range_uniform = glGetUniformLocation(ctx->gen_shader, "range");
-    ctx->_glyph_height_uniform = glGetUniformLocation(ctx->gen_shader, "glyph_height");
-
-    ctx->_meta_offset_uniform = glGetUniformLocation(ctx->gen_shader, "meta_offset");
-    ctx->_point_offset_uniform = glGetUniformLocation(ctx->gen_shader, "point_offset");
+    ctx->_single_channel_uniform = glGetUniformLocation(ctx->gen_shader, "single_channel");
 
     ctx->metadata_uniform = glGetUniformLocation(ctx->gen_shader, "metadata");
     ctx->point_data_uniform = glGetUniformLocation(ctx->gen_shader, "point_data");
+    ctx->segment_data_uniform = glGetUniformLocation(ctx->gen_shader, "segment_data");
+    ctx->instance_data_uniform = glGetUniformLocation(ctx->gen_shader, "instance_data");
+    ctx->_instance_offset_uniform = glGetUniformLocation(ctx->gen_shader, "instance_offset");
+    return 0;
+}
 
-    GLenum err = glGetError();
-    if (err) {
-        fprintf(stderr, "error: %x \n", err);
-        glDeleteProgram(ctx->gen_shader);
-        return NULL;
-    }
+/* Start building the compute shader generator, if the context is GL 4.3 or
+   newer. Returns -1 otherwise. */
+static int _msdfgl_start_compute(msdfgl_context_t ctx) {
+#ifdef GL_COMPUTE_SHADER
+    const char *gl_version = (const char *)glGetString(GL_VERSION);
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if (!gl_version || strstr(gl_version, "OpenGL ES") || major * 10 + minor < 43)
+        return -1;
 
-    if (!compile_shader(_font_vertex, GL_VERTEX_SHADER, &vertex_shader, version))
-        return NULL;
-    if (!compile_shader(_font_geometry, GL_GEOMETRY_SHADER, &geometry_shader, version))
-        return NULL;
-    if (!compile_shader(_font_fragment, GL_FRAGMENT_SHADER, &fragment_shader, version))
-        return NULL;
+    const msdfgl_shader_stage stages[] = {
+        {GL_COMPUTE_SHADER, {_msdf_compute, _msdf_generator}, 2},
+    };
+    return _msdfgl_start_program(ctx, &ctx->_compute_build, stages, 1, "430 core");
+#else
+    return -1;
+#endif
+}
 
-    if (!(ctx->render_shader = glCreateProgram()))
-        return NULL;
-    glAttachShader(ctx->render_shader, vertex_shader);
-    glAttachShader(ctx->render_shader, geometry_shader);
-    glAttachShader(ctx->render_shader, fragment_shader);
+/* Leaves the compute shader zero if it was not started or failed to build. */
+static void _msdfgl_finish_compute(msdfgl_context_t ctx) {
+#ifdef GL_COMPUTE_SHADER
+    GLuint program = _msdfgl_finish_program(&ctx->_compute_build);
+    if (!program)
+        return;
 
-    glLinkProgram(ctx->render_shader);
-    glDeleteShader(vertex_shader);
-    glDeleteShader(geometry_shader);
-    glDeleteShader(fragment_shader);
+    ctx->compute_shader = program;
+    ctx->_compute_range_uniform = glGetUniformLocation(program, "range");
+    ctx->_compute_single_channel_uniform = glGetUniformLocation(program, "single_channel");
+    ctx->_compute_tile_offset_uniform = glGetUniformLocation(program, "tile_offset");
+    glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, 0, &ctx->_max_compute_groups);
+    glGenBuffers(1, &ctx->_tile_buffer);
+#endif
+}
 
-    glGetProgramiv(ctx->render_shader, GL_LINK_STATUS, &status);
+static int _msdfgl_start_render(msdfgl_context_t ctx) {
+    const msdfgl_shader_stage stages[] = {
+        {GL_VERTEX_SHADER, {_font_vertex}, 1},
+        {GL_GEOMETRY_SHADER, {_font_geometry}, 1},
+        {GL_FRAGMENT_SHADER, {_font_fragment}, 1},
+    };
+    return _msdfgl_start_program(ctx, &ctx->_render_build, stages, 3, ctx->_glsl_version);
+}
 
-    if (!status) {
-        glDeleteProgram(ctx->gen_shader);
-        return NULL;
-    }
+static int _msdfgl_finish_render(msdfgl_context_t ctx) {
+    if (!(ctx->render_shader = _msdfgl_finish_program(&ctx->_render_build)))
+        return -1;
 
     ctx->window_projection_uniform =
         glGetUniformLocation(ctx->render_shader, "projection");
@@ -313,26 +914,136 @@ msdfgl_context_t msdfgl_create_context(const char *version) {
     ctx->_padding_uniform = glGetUniformLocation(ctx->render_shader, "padding");
     ctx->_dpi_uniform = glGetUniformLocation(ctx->render_shader, "dpi");
     ctx->_units_per_em_uniform = glGetUniformLocation(ctx->render_shader, "units_per_em");
+    return 0;
+}
 
-    ctx->dpi[0] = 72.0;
-    ctx->dpi[1] = 72.0;
-
-    if ((err = glGetError())) {
-        fprintf(stderr, "error: %x \n", err);
-        glDeleteProgram(ctx->gen_shader);
-        glDeleteProgram(ctx->render_shader);
-        return NULL;
-    }
+/**
+ * Start building the generator: the compute shader if the context supports
+ * it, the fragment shader otherwise.
+ */
+static int _msdfgl_start_generator(msdfgl_context_t ctx) {
+    return _msdfgl_start_compute(ctx) && _msdfgl_start_gen(ctx) ? -1 : 0;
+}
 
-    glGenVertexArrays(1, &ctx->bbox_vao);
-    glGenBuffers(1, &ctx->bbox_vbo);
+/**
+ * Make sure that a generator is built, starting or waiting for its build if
+ * needed. Returns -1 if none could be built.
+ */
+static int _msdfgl_ensure_generator(msdfgl_context_t ctx) {
+    if (ctx->compute_shader || ctx->gen_shader)
+        return 0;
 
-    glBindBuffer(GL_ARRAY_BUFFER, ctx->bbox_vbo);
-    glBufferData(GL_ARRAY_BUFFER, 12 * sizeof(GLfloat), 0, GL_STREAM_READ);
+    if (!ctx->_compute_build.program && !ctx->_gen_build.program &&
+        _msdfgl_start_generator(ctx))
+        return -1;
+    _msdfgl_finish_compute(ctx);
+    if (ctx->compute_shader)
+        return 0;
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    /* The fragment shader generator is the fallback. */
+    if (!ctx->_gen_build.program && _msdfgl_start_gen(ctx))
+        return -1;
+    return _msdfgl_finish_gen(ctx);
+}
 
-    return ctx;
+static int _msdfgl_ensure_render(msdfgl_context_t ctx) {
+    if (ctx->render_shader)
+        return 0;
+    if (!ctx->_render_build.program && _msdfgl_start_render(ctx))
+        return -1;
+    return _msdfgl_finish_render(ctx);
+}
+
+msdfgl_context_t msdfgl_create_context(const char *version) {
+    return msdfgl_create_context_ext(version, NULL, 0);
+}
+
+msdfgl_context_t msdfgl_create_context_cached(const char *version, const char *cache_dir) {
+    return msdfgl_create_context_ext(version, cache_dir, 0);
+}
+
+msdfgl_context_t msdfgl_create_context_ext(const char *version, const char *cache_dir,
+                                           enum msdfgl_context_flags flags) {
+    msdfgl_context_t ctx = (msdfgl_context_t)calloc(1, sizeof(struct _msdfgl_context));
+
+/*
+ * When compiling a DLL for Windows, GL bindings need to be loaded in the DLL code separately.
+ */
+#ifdef _WIN32
+    gladLoadGL();
+#endif
+
+    if (!ctx)
+        return NULL;
+
+    FT_Error error = FT_Init_FreeType(&ctx->ft_library);
+    if (error) {
+        free(ctx);
+        return NULL;
+    }
+
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &ctx->_max_texture_size);
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &ctx->_max_texture_layers);
+
+    ctx->_parallel_compile = _msdfgl_has_extension("GL_KHR_parallel_shader_compile") ||
+                             _msdfgl_has_extension("GL_ARB_parallel_shader_compile");
+
+    /* Kept for the builds that lazy contexts start later. */
+    if (version) {
+        if (!(ctx->_glsl_version = malloc(strlen(version) + 1)))
+            goto error;
+        strcpy(ctx->_glsl_version, version);
+    }
+
+    if (cache_dir && _msdfgl_has_program_binary()) {
+        if (!(ctx->_program_cache = malloc(strlen(cache_dir) + 1)))
+            goto error;
+        strcpy(ctx->_program_cache, cache_dir);
+    }
+
+    ctx->missing_glyph_cb = NULL;
+    ctx->nthreads = msdfgl_workers_default_count();
+
+    ctx->dpi[0] = 72.0;
+    ctx->dpi[1] = 72.0;
+
+    /* Every build is started before waiting for any of them, so that drivers
+       which compile in the background work on them in parallel. A build which
+       fails to start is reported when it is finished. */
+    _msdfgl_start_render(ctx);
+    if (!(flags & MSDFGL_CONTEXT_LAZY)) {
+        /* The fragment shader generator is only built if the compute shader
+           is not supported or fails to build. */
+        _msdfgl_start_generator(ctx);
+        if (_msdfgl_ensure_generator(ctx) || _msdfgl_finish_render(ctx))
+            goto error;
+    } else if (ctx->_parallel_compile) {
+        /* Costs no waiting, and the generator is ready sooner when needed. */
+        _msdfgl_start_generator(ctx);
+    }
+
+    GLenum err = glGetError();
+    if (err) {
+        fprintf(stderr, "error: %x \n", err);
+        goto error;
+    }
+
+    glGenVertexArrays(1, &ctx->bbox_vao);
+    glGenBuffers(1, &ctx->bbox_vbo);
+    glGenBuffers(1, &ctx->_instance_buffer);
+    glGenTextures(1, &ctx->_instance_texture);
+
+    GLfloat bounding_box[] = {0, 0, 1, 0, 0, 1, 0, 1, 1, 0, 1, 1};
+    glBindBuffer(GL_ARRAY_BUFFER, ctx->bbox_vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(bounding_box), bounding_box, GL_STATIC_DRAW);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    return ctx;
+
+error:
+    msdfgl_destroy_context(ctx);
+    return NULL;
 }
 
 void msdfgl_destroy_context(msdfgl_context_t ctx) {
@@ -342,15 +1053,47 @@ void msdfgl_destroy_context(msdfgl_context_t ctx) {
 
     FT_Done_FreeType(ctx->ft_library);
 
+    _msdfgl_abandon_program(&ctx->_gen_build);
+    _msdfgl_abandon_program(&ctx->_compute_build);
+    _msdfgl_abandon_program(&ctx->_render_build);
+
     glDeleteProgram(ctx->gen_shader);
     glDeleteProgram(ctx->render_shader);
+    if (ctx->compute_shader) {
+        glDeleteProgram(ctx->compute_shader);
+        glDeleteBuffers(1, &ctx->_tile_buffer);
+    }
 
     glDeleteVertexArrays(1, &ctx->bbox_vao);
     glDeleteBuffers(1, &ctx->bbox_vbo);
+    glDeleteBuffers(1, &ctx->_instance_buffer);
+    glDeleteTextures(1, &ctx->_instance_texture);
 
+    if (ctx->_glsl_version)
+        free(ctx->_glsl_version);
+    if (ctx->_program_cache)
+        free(ctx->_program_cache);
     free(ctx);
 }
 
+/**
+ * Drop an ongoing compaction, the atlas stays as it was before it.
+ */
+static void _msdfgl_cancel_compaction(msdfgl_atlas_t atlas) {
+    if (!atlas->compact_texture)
+        return;
+
+    glDeleteTextures(1, &atlas->compact_texture);
+    glDeleteFramebuffers(1, &atlas->compact_framebuffer);
+    atlas->compact_texture = 0;
+    atlas->compact_framebuffer = 0;
+    msdfgl_packer_destroy(&atlas->compact_packer);
+    free(atlas->moves);
+    atlas->moves = NULL;
+    atlas->nmoves = 0;
+    atlas->nmoved = 0;
+}
+
 msdfgl_atlas_t msdfgl_create_atlas(msdfgl_context_t ctx, int texture_width, int padding) {
     msdfgl_atlas_t atlas = calloc(1, sizeof(struct _msdfgl_atlas));
     if (!atlas) return NULL;
@@ -359,11 +1102,20 @@ msdfgl_atlas_t msdfgl_create_atlas(msdfgl_context_t ctx, int texture_width, int
 
     atlas->nglyphs = 0;
     atlas->nallocated = 0;
-    atlas->offset_x = 1;
-    atlas->offset_y = 1;
-    atlas->y_increment = 0;
     atlas->texture_height = 0;
+    atlas->npages = 0;
+    atlas->max_texture_height = ctx->_max_texture_size;
+    atlas->max_pages = ctx->_max_texture_layers;
     atlas->padding = padding;
+    atlas->format = GL_RGBA32F;
+    atlas->frame = 1;
+    atlas->explicit_frames = 0;
+
+    if (msdfgl_packer_init(&atlas->packer, MSDFGL_PACKER_SKYLINE, atlas->texture_width,
+                           atlas->max_texture_height, padding)) {
+        free(atlas);
+        return NULL;
+    }
 
     glGenBuffers(1, &atlas->index_buffer);
     glGenTextures(1, &atlas->index_texture);
@@ -376,34 +1128,207 @@ msdfgl_atlas_t msdfgl_create_atlas(msdfgl_context_t ctx, int texture_width, int
     return atlas;
 }
 void msdfgl_destroy_atlas(msdfgl_atlas_t atlas) {
+    _msdfgl_cancel_compaction(atlas);
+
     glDeleteBuffers(1, &atlas->index_buffer);
     glDeleteTextures(1, &atlas->index_texture);
 
     glDeleteTextures(1, &atlas->atlas_texture);
     glDeleteFramebuffers(1, &atlas->atlas_framebuffer);
 
+    msdfgl_packer_destroy(&atlas->packer);
+    if (atlas->entries)
+        free(atlas->entries);
+    if (atlas->free_entries)
+        free(atlas->free_entries);
     free(atlas);
 }
 
+int msdfgl_set_atlas_packer(msdfgl_atlas_t atlas, enum msdfgl_atlas_packer packer) {
+    if (atlas->nglyphs || (atlas->budget && packer != MSDFGL_PACKER_MAXRECTS))
+        return -1;
+
+    int page_height = atlas->packer.page_height;
+    msdfgl_packer_destroy(&atlas->packer);
+    return msdfgl_packer_init(&atlas->packer, packer, atlas->texture_width, page_height,
+                              atlas->padding);
+}
+
+int msdfgl_set_atlas_page_height(msdfgl_atlas_t atlas, int height) {
+    if (atlas->nglyphs || atlas->budget || height < 2 || height > atlas->max_texture_height)
+        return -1;
+
+    enum msdfgl_atlas_packer kind = atlas->packer.kind;
+    msdfgl_packer_destroy(&atlas->packer);
+    return msdfgl_packer_init(&atlas->packer, kind, atlas->texture_width, height,
+                              atlas->padding);
+}
+
+/**
+ * Bytes per texel of the atlas formats, 0 for unsupported ones.
+ */
+static size_t _msdfgl_texel_size(GLenum format) {
+    switch (format) {
+    case GL_RGBA32F:
+        return 4 * sizeof(GLfloat);
+    case GL_RGBA16F:
+        return 8;
+    case GL_RGB10_A2:
+    case GL_RGBA8:
+        return 4;
+    case GL_R16F:
+        return 2;
+    case GL_R8:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/**
+ * Client side format and type of the texels of the atlas formats, as read
+ * back and uploaded for the atlas cache.
+ */
+static void _msdfgl_texel_type(GLenum format, GLenum *client_format, GLenum *type) {
+    switch (format) {
+    case GL_RGBA16F:
+        *client_format = GL_RGBA;
+        *type = GL_HALF_FLOAT;
+        break;
+    case GL_RGB10_A2:
+        *client_format = GL_RGBA;
+        *type = GL_UNSIGNED_INT_2_10_10_10_REV;
+        break;
+    case GL_RGBA8:
+        *client_format = GL_RGBA;
+        *type = GL_UNSIGNED_BYTE;
+        break;
+    case GL_R16F:
+        *client_format = GL_RED;
+        *type = GL_HALF_FLOAT;
+        break;
+    case GL_R8:
+        *client_format = GL_RED;
+        *type = GL_UNSIGNED_BYTE;
+        break;
+    case GL_RGBA32F:
+    default:
+        *client_format = GL_RGBA;
+        *type = GL_FLOAT;
+        break;
+    }
+}
+
+/* The layout the CPU generator writes texels of an atlas format in. */
+static enum msdfgl_cpu_format _msdfgl_cpu_format(GLenum format) {
+    switch (format) {
+    case GL_RGBA16F:
+        return MSDFGL_CPU_RGBA16F;
+    case GL_RGB10_A2:
+        return MSDFGL_CPU_RGB10_A2;
+    case GL_RGBA8:
+        return MSDFGL_CPU_RGBA8;
+    case GL_R16F:
+        return MSDFGL_CPU_R16F;
+    case GL_R8:
+        return MSDFGL_CPU_R8;
+    case GL_RGBA32F:
+    default:
+        return MSDFGL_CPU_RGBA32F;
+    }
+}
+
+/**
+ * Whether atlases of the format hold single-channel distance fields.
+ */
+static int _msdfgl_single_channel(GLenum format) {
+    return format == GL_R8 || format == GL_R16F;
+}
+
+int msdfgl_set_atlas_format(msdfgl_atlas_t atlas, GLenum format) {
+    if (atlas->nglyphs || !_msdfgl_texel_size(format))
+        return -1;
+
+    atlas->format = format;
+    /* The same budget now holds a different amount of rows. */
+    return atlas->budget ? msdfgl_set_atlas_budget(atlas, atlas->budget) : 0;
+}
+
+int msdfgl_set_atlas_budget(msdfgl_atlas_t atlas, size_t bytes) {
+    if (atlas->nglyphs)
+        return -1;
+
+    size_t rows = bytes / ((size_t)atlas->texture_width * _msdfgl_texel_size(atlas->format));
+    if (rows < 2)
+        return -1;
+
+    /* As few pages as possible, and no more than the budget covers. */
+    int page_height = rows < (size_t)atlas->max_texture_height ? (int)rows
+                                                               : atlas->max_texture_height;
+    size_t npages = rows / page_height;
+    npages = npages < (size_t)atlas->max_pages ? npages : (size_t)atlas->max_pages;
+
+    /* Only MaxRects can reuse the space of evicted glyphs. */
+    msdfgl_packer_destroy(&atlas->packer);
+    if (msdfgl_packer_init(&atlas->packer, MSDFGL_PACKER_MAXRECTS, atlas->texture_width,
+                           page_height, atlas->padding))
+        return -1;
+    atlas->packer.max_pages = (int)npages;
+    atlas->budget = bytes;
+    return 0;
+}
+
+void msdfgl_atlas_next_frame(msdfgl_atlas_t atlas) {
+    atlas->explicit_frames = 1;
+    atlas->frame++;
+}
+
+float msdfgl_atlas_fill_ratio(msdfgl_atlas_t atlas) {
+    double rows = 0.0;
+    for (int i = 0; i < atlas->packer.npages; ++i)
+        rows += atlas->packer.pages[i].height - 1;
+    if (rows <= 0.0)
+        return 0.0f;
+    return (float)((double)msdfgl_packer_area(&atlas->packer) /
+                   ((double)atlas->texture_width * rows));
+}
+
 /**
  * Initialize font from a FreeType face and generate textures and buffers for it.
  */
 msdfgl_font_t _msdfgl_init_font_internal(msdfgl_context_t ctx, FT_Face* face,
-                                         float range, float scale,
-                                         msdfgl_atlas_t atlas) {
+                                         const FT_Open_Args *source, float range,
+                                         float scale, msdfgl_atlas_t atlas) {
 
     msdfgl_font_t f = (msdfgl_font_t)calloc(1, sizeof(struct _msdfgl_font));
     if (!f)
         return NULL;
 
+    /* Worker threads open their own faces from the same source. */
+    FT_Open_Args worker_source = *source;
+    if (source->flags & FT_OPEN_PATHNAME) {
+        size_t len = strlen(source->pathname);
+        if (!(f->font_name = malloc(len + 1))) {
+            free(f);
+            return NULL;
+        }
+        memcpy(f->font_name, source->pathname, len + 1);
+        worker_source.pathname = f->font_name;
+    }
+
+    if (source->flags & FT_OPEN_MEMORY) {
+        f->font_data = source->memory_base;
+        f->font_data_size = (size_t)source->memory_size;
+    }
+
     f->face  = *face;
     f->scale = scale;
     f->range = range;
 
     f->context = ctx;
-    f->_direct_lookup_upper_limit = 0;
 
     if (!(f->atlas = atlas ? atlas : msdfgl_create_atlas(ctx, 0, 2))) {
+        free(f->font_name);
         free(f);
         return NULL;
     }
@@ -413,11 +1338,15 @@ msdfgl_font_t _msdfgl_init_font_internal(msdfgl_context_t ctx, FT_Face* face,
     f->vertical_advance = (float)(f->face->ascender - f->face->descender);
 
     msdfgl_map_init(&f->character_index);
+    msdfgl_map_init(&f->glyph_index);
+    msdfgl_workers_init(&f->_workers, f->face, &worker_source);
 
     glGenBuffers(1, &f->_meta_input_buffer);
     glGenBuffers(1, &f->_point_input_buffer);
+    glGenBuffers(1, &f->_segment_input_buffer);
     glGenTextures(1, &f->_meta_input_texture);
     glGenTextures(1, &f->_point_input_texture);
+    glGenTextures(1, &f->_segment_input_texture);
 
     return f;
 }
@@ -425,387 +1354,1655 @@ msdfgl_font_t _msdfgl_init_font_internal(msdfgl_context_t ctx, FT_Face* face,
 msdfgl_font_t msdfgl_load_font(msdfgl_context_t ctx, const char *font_name, float range,
                                float scale, msdfgl_atlas_t atlas) {
 
-    FT_Face face;
-    if (FT_New_Face(ctx->ft_library, font_name, 0, &face)) {
-        return NULL;
-    }
+    FT_Face face;
+    if (FT_New_Face(ctx->ft_library, font_name, 0, &face)) {
+        return NULL;
+    }
+
+    FT_Open_Args source;
+    memset(&source, 0, sizeof(FT_Open_Args));
+    source.flags = FT_OPEN_PATHNAME;
+    source.pathname = (char *)font_name;
+
+    return _msdfgl_init_font_internal(ctx, &face, &source, range, scale, atlas);
+}
+
+/**
+ * Load font from memory and generate textures and buffers for it.
+ */
+MSDFGL_EXPORT msdfgl_font_t msdfgl_load_font_mem(msdfgl_context_t ctx, void *font_buffer,
+                                                 size_t font_buffer_size, float range,
+                                                 float scale, msdfgl_atlas_t atlas)
+{
+    FT_Face face;
+    if (FT_New_Memory_Face(ctx->ft_library, font_buffer, font_buffer_size, 0, &face)) {
+        return NULL;
+    }
+
+    FT_Open_Args source;
+    memset(&source, 0, sizeof(FT_Open_Args));
+    source.flags = FT_OPEN_MEMORY;
+    source.memory_base = (const FT_Byte *)font_buffer;
+    source.memory_size = (FT_Long)font_buffer_size;
+
+    return _msdfgl_init_font_internal(ctx, &face, &source, range, scale, atlas);
+}
+
+void msdfgl_destroy_font(msdfgl_font_t font) {
+    /* The glyphs stay on a shared atlas until evicted, first in line. */
+    for (size_t i = 0; i < font->atlas->nglyphs; ++i) {
+        msdfgl_atlas_entry *entry = &font->atlas->entries[i];
+        if (entry->font == font) {
+            entry->font = NULL;
+            entry->last_use = 0;
+        }
+    }
+
+    FT_Done_Face(font->face);
+
+    glDeleteBuffers(1, &font->_meta_input_buffer);
+    glDeleteBuffers(1, &font->_point_input_buffer);
+    glDeleteBuffers(1, &font->_segment_input_buffer);
+    glDeleteTextures(1, &font->_meta_input_texture);
+    glDeleteTextures(1, &font->_point_input_texture);
+    glDeleteTextures(1, &font->_segment_input_texture);
+
+    if (font->atlas->_implicit && !--font->atlas->_refcount)
+        msdfgl_destroy_atlas(font->atlas);
+
+    msdfgl_map_destroy(&font->character_index);
+    msdfgl_map_destroy(&font->glyph_index);
+    msdfgl_workers_destroy(&font->_workers);
+
+    if (font->font_name)
+        free(font->font_name);
+    free(font);
+}
+
+/* Draw the instances of a batch, ordered by page, into the atlas framebuffer.
+   Each page is a layer of the atlas texture and takes a draw of its own. */
+static void _msdfgl_generate_fragment(msdfgl_font_t font, GLfloat projection[][4],
+                                      const msdfgl_gen_instance *instances, int ninstances) {
+    msdfgl_context_t ctx = font->context;
+
+    glUseProgram(ctx->gen_shader);
+    glUniform1i(ctx->metadata_uniform, 0);
+    glUniform1i(ctx->point_data_uniform, 1);
+    glUniform1i(ctx->segment_data_uniform, 2);
+    glUniform1i(ctx->instance_data_uniform, 3);
+
+    glUniformMatrix4fv(ctx->_atlas_projection_uniform, 1, GL_FALSE, (GLfloat *)projection);
+
+    glUniform1f(ctx->_range_uniform, font->range);
+    glUniform1i(ctx->_single_channel_uniform, _msdfgl_single_channel(font->atlas->format));
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_BUFFER, font->_meta_input_texture);
+
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_BUFFER, font->_point_input_texture);
+
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_BUFFER, font->_segment_input_texture);
+
+    glBindVertexArray(ctx->bbox_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, ctx->bbox_vbo);
+
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), 0);
+    glEnableVertexAttribArray(0);
+
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_BUFFER, ctx->_instance_texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32I, ctx->_instance_buffer);
+
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, font->atlas->atlas_framebuffer);
+    for (int first = 0, last; first < ninstances; first = last) {
+        int page = instances[first].page;
+        for (last = first + 1; last < ninstances && instances[last].page == page; ++last)
+            ;
+
+        glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                  font->atlas->atlas_texture, 0, page);
+        if (glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            fprintf(stderr, "msdfgl: framebuffer incomplete: %x\n",
+                    glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER));
+
+        glUniform1i(ctx->_instance_offset_uniform, first);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 6, last - first);
+    }
+
+    glDisableVertexAttribArray(0);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    glUseProgram(0);
+}
+
+#ifdef GL_COMPUTE_SHADER
+/* Write the instances of a batch to the atlas texture with the compute
+   shader, a work group per tile of a glyph. Returns 0 on success. */
+static int _msdfgl_generate_compute(msdfgl_font_t font, const msdfgl_gen_instance *instances,
+                                    int ninstances) {
+    msdfgl_context_t ctx = font->context;
+
+    size_t ntiles = 0;
+    for (int i = 0; i < ninstances; ++i) {
+        size_t x = (size_t)ceilf(instances[i].size[0] / GEN_TILE_SIZE);
+        size_t y = (size_t)ceilf(instances[i].size[1] / GEN_TILE_SIZE);
+        ntiles += x * y;
+    }
+    if (!ntiles)
+        return 0;
+
+    GLuint *tiles = (GLuint *)malloc(2 * ntiles * sizeof(GLuint));
+    if (!tiles)
+        return -1;
+    size_t tile = 0;
+    for (int i = 0; i < ninstances; ++i) {
+        GLuint nx = (GLuint)ceilf(instances[i].size[0] / GEN_TILE_SIZE);
+        GLuint ny = (GLuint)ceilf(instances[i].size[1] / GEN_TILE_SIZE);
+        for (GLuint y = 0; y < ny; ++y) {
+            for (GLuint x = 0; x < nx; ++x) {
+                tiles[2 * tile] = (GLuint)i;
+                tiles[2 * tile + 1] = x | y << 16;
+                ++tile;
+            }
+        }
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ctx->_tile_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, 2 * ntiles * sizeof(GLuint), tiles,
+                 GL_STREAM_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    free(tiles);
+
+    glUseProgram(ctx->compute_shader);
+    glUniform1f(ctx->_compute_range_uniform, font->range);
+    glUniform1i(ctx->_compute_single_channel_uniform,
+                _msdfgl_single_channel(font->atlas->format));
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, font->_meta_input_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, font->_point_input_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, font->_segment_input_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, ctx->_instance_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, ctx->_tile_buffer);
+    glBindImageTexture(0, font->atlas->atlas_texture, 0, GL_TRUE, 0, GL_WRITE_ONLY,
+                       font->atlas->format);
+
+    /* Large batches take more than one dispatch. */
+    for (size_t offset = 0; offset < ntiles; offset += ctx->_max_compute_groups) {
+        size_t n = ntiles - offset;
+        n = n < (size_t)ctx->_max_compute_groups ? n : (size_t)ctx->_max_compute_groups;
+        glUniform1i(ctx->_compute_tile_offset_uniform, (GLint)offset);
+        glDispatchCompute((GLuint)n, 1, 1);
+    }
+
+    /* The atlas is next sampled, blitted or read back. */
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT |
+                    GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+    glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, font->atlas->format);
+    for (GLuint i = 0; i < 5; ++i)
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, i, 0);
+    glUseProgram(0);
+    return 0;
+}
+#else
+static int _msdfgl_generate_compute(msdfgl_font_t font, const msdfgl_gen_instance *instances,
+                                    int ninstances) {
+    return -1;
+}
+#endif
+
+/* Generate the instances of a batch on the CPU, and upload their bitmaps to
+   the atlas texture. Returns 0 on success. */
+static int _msdfgl_generate_cpu(msdfgl_font_t font, const msdfgl_gen_instance *instances,
+                                int ninstances) {
+    msdfgl_atlas_t atlas = font->atlas;
+    msdfgl_workers_t *workers = &font->_workers;
+    if (!ninstances)
+        return 0;
+
+    enum msdfgl_cpu_format format = _msdfgl_cpu_format(atlas->format);
+    size_t texel_size = msdfgl_cpu_texel_size(format);
+    msdfgl_cpu_glyph_t *glyphs =
+        (msdfgl_cpu_glyph_t *)calloc(ninstances, sizeof(msdfgl_cpu_glyph_t));
+    if (!glyphs)
+        return -1;
+
+    size_t size = 0;
+    for (int i = 0; i < ninstances; ++i) {
+        const msdfgl_gen_instance *instance = &instances[i];
+        msdfgl_cpu_glyph_t *glyph = &glyphs[i];
+
+        /* The offsets are into the concatenation of the worker arenas. */
+        msdfgl_worker_t *w = &workers->workers[instance->worker];
+        glyph->meta = &w->serializer.meta[instance->meta_offset - w->meta_base];
+        glyph->points = &w->serializer.points[2 * (instance->point_offset - w->point_base)];
+        glyph->segments = &w->serializer.segments[SERIALIZER_SEGMENT_SIZE *
+                                                  (instance->segment_offset - w->segment_base)];
+
+        memcpy(glyph->size, instance->size, sizeof(glyph->size));
+        memcpy(glyph->translate, instance->translate, sizeof(glyph->translate));
+        glyph->scale = instance->scale;
+        glyph->width = (int)ceilf(instance->size[0]);
+        glyph->height = (int)ceilf(instance->size[1]);
+        size += (size_t)glyph->width * glyph->height * texel_size;
+    }
+
+    GLubyte *bitmaps = (GLubyte *)malloc(size);
+    if (!bitmaps) {
+        free(glyphs);
+        return -1;
+    }
+    size = 0;
+    for (int i = 0; i < ninstances; ++i) {
+        glyphs[i].bitmap = &bitmaps[size];
+        size += (size_t)glyphs[i].width * glyphs[i].height * texel_size;
+    }
+
+    int retval = msdfgl_cpu_generate(glyphs, ninstances, font->range, format,
+                                     msdfgl_cpu_best_kernel(), font->context->nthreads);
+    if (!retval) {
+        GLenum client_format, type;
+        GLint alignment;
+        _msdfgl_texel_type(atlas->format, &client_format, &type);
+        glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, atlas->atlas_texture);
+        for (int i = 0; i < ninstances; ++i) {
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, (GLint)instances[i].offset[0],
+                            (GLint)instances[i].offset[1], instances[i].page, glyphs[i].width,
+                            glyphs[i].height, 1, client_format, type, glyphs[i].bitmap);
+        }
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+    }
+
+    free(bitmaps);
+    free(glyphs);
+    return retval;
+}
+
+/**
+ * Create an atlas texture of `npages` layers of `height` rows, and a
+ * framebuffer to draw to it. Returns 0 on success.
+ */
+static int _msdfgl_create_atlas_texture(msdfgl_atlas_t atlas, int height, int npages,
+                                        GLuint *texture, GLuint *framebuffer) {
+    glGenTextures(1, texture);
+    glGenFramebuffers(1, framebuffer);
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, *texture);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    if (_msdfgl_single_channel(atlas->format)) {
+        /* Sampled as three equal channels, whose median the render shader
+           takes as for any other atlas. */
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_G, GL_RED);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_B, GL_RED);
+    }
+
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, atlas->format, atlas->texture_width, height, npages, 0,
+                 GL_RGBA, GL_FLOAT, NULL);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    if (glGetError() == GL_OUT_OF_MEMORY) {
+        /* Buffer size too big, are you trying to type Klingon? */
+        glDeleteFramebuffers(1, framebuffer);
+        glDeleteTextures(1, texture);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Move the atlas onto a texture of `npages` layers of `height` rows. Only the
+ * rows the packer has used are copied over.
+ */
+static int _msdfgl_resize_atlas_texture(msdfgl_atlas_t atlas, int height, int npages) {
+    GLuint new_texture;
+    GLuint new_framebuffer;
+    if (_msdfgl_create_atlas_texture(atlas, height, npages, &new_texture, &new_framebuffer))
+        return -1;
+
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, new_framebuffer);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, atlas->atlas_framebuffer);
+    glClearColor(0.0, 0.0, 0.0, 1.0);
+    for (int i = 0; i < npages; ++i) {
+        glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, new_texture, 0, i);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        if (i >= atlas->npages)
+            continue;
+
+        /* Old texture had data -> copy. */
+        int occupied = atlas->packer.pages[i].height;
+        occupied = occupied < atlas->texture_height ? occupied : atlas->texture_height;
+        glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                  atlas->atlas_texture, 0, i);
+        glBlitFramebuffer(0, 0, atlas->texture_width, occupied, 0, 0, atlas->texture_width,
+                          occupied, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    atlas->texture_height = height;
+    atlas->npages = npages;
+    glDeleteTextures(1, &atlas->atlas_texture);
+    atlas->atlas_texture = new_texture;
+    glDeleteFramebuffers(1, &atlas->atlas_framebuffer);
+    atlas->atlas_framebuffer = new_framebuffer;
+    return 0;
+}
+
+/**
+ * Height of the atlas texture needed for the bitmaps placed by `packer`. The
+ * texture grows by doubling, up to the page height.
+ */
+static int _msdfgl_texture_height(msdfgl_atlas_t atlas, const msdfgl_packer_t *packer) {
+    int height = atlas->texture_height ? atlas->texture_height : 1;
+    int needed = msdfgl_packer_height(packer);
+    while (needed > height)
+        height *= 2;
+    return height < packer->page_height ? height : packer->page_height;
+}
+
+/**
+ * Move the index onto a buffer of `size` entries.
+ */
+static int _msdfgl_resize_atlas_index(msdfgl_atlas_t atlas, int size) {
+    GLuint new_buffer;
+    glGenBuffers(1, &new_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, new_buffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(msdfgl_index_entry) * size, 0, GL_DYNAMIC_READ);
+    if (glGetError() == GL_OUT_OF_MEMORY) {
+        glDeleteBuffers(1, &new_buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        return -1;
+    }
+    if (atlas->nglyphs) {
+        glBindBuffer(GL_COPY_READ_BUFFER, atlas->index_buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_ARRAY_BUFFER, 0, 0,
+                            atlas->nglyphs * sizeof(msdfgl_index_entry));
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    atlas->nallocated = size;
+    glDeleteBuffers(1, &atlas->index_buffer);
+    atlas->index_buffer = new_buffer;
+
+    glBindTexture(GL_TEXTURE_BUFFER, atlas->index_texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, atlas->index_buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    return 0;
+}
+
+/**
+ * Make room for `n` entry records.
+ */
+static int _msdfgl_reserve_entries(msdfgl_atlas_t atlas, size_t n) {
+    if (n <= atlas->nentries_allocated)
+        return 0;
+
+    size_t nallocated = atlas->nentries_allocated ? atlas->nentries_allocated : 1;
+    while (nallocated < n)
+        nallocated *= 2;
+
+    msdfgl_atlas_entry *entries = realloc(atlas->entries, nallocated * sizeof(msdfgl_atlas_entry));
+    if (!entries)
+        return -1;
+    atlas->entries = entries;
+    int *free_entries = realloc(atlas->free_entries, nallocated * sizeof(int));
+    if (!free_entries)
+        return -1;
+    atlas->free_entries = free_entries;
+    atlas->nentries_allocated = nallocated;
+    return 0;
+}
+
+/**
+ * Recompute the free space of a page from the entries still on it, out of the
+ * first `nentries`. During a batch these include the new entries past
+ * `atlas->nglyphs`, which already hold their space.
+ */
+static int _msdfgl_rebuild_page(msdfgl_atlas_t atlas, int page, size_t nentries) {
+    msdfgl_packer_rect_t *used = malloc((nentries + 1) * sizeof(msdfgl_packer_rect_t));
+    if (!used)
+        return -1;
+
+    size_t n = 0;
+    for (size_t i = 0; i < nentries; ++i) {
+        if (atlas->entries[i].state != MSDFGL_ENTRY_FREE && atlas->entries[i].page == page)
+            used[n++] = atlas->entries[i].rect;
+    }
+    int status = msdfgl_packer_rebuild(&atlas->packer, page, used, n);
+    free(used);
+    return status;
+}
+
+/**
+ * Blank the padded area of an entry on the atlas texture, so that sampling
+ * the edges of a glyph later placed there does not pick up old pixels.
+ */
+static void _msdfgl_clear_entry(msdfgl_atlas_t atlas, const msdfgl_atlas_entry *entry) {
+    if (entry->page >= atlas->npages || entry->rect.y >= atlas->texture_height)
+        return;
+
+    glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, atlas->atlas_texture,
+                              0, entry->page);
+    glScissor(entry->rect.x, entry->rect.y, entry->rect.width + atlas->padding,
+              entry->rect.height + atlas->padding);
+    glClear(GL_COLOR_BUFFER_BIT);
+}
+
+/**
+ * Evict the least recently used glyphs, an eighth of the atlas area at a time.
+ * Glyphs used at the current frame are kept, as are the `nnew` entries a batch
+ * in progress has added past `atlas->nglyphs`. Returns -1 if there is nothing
+ * to evict.
+ */
+static int _msdfgl_evict(msdfgl_atlas_t atlas, size_t nnew) {
+    size_t ncandidates = 0;
+    int retval = -1;
+    msdfgl_eviction *candidates = NULL;
+    uint8_t *removed = NULL, *pages = NULL;
+    msdfgl_font_t *fonts = NULL;
+    size_t nfonts = 0;
+
+    if (!(candidates = (msdfgl_eviction *)calloc(atlas->nglyphs + 1, sizeof(msdfgl_eviction))))
+        goto error;
+    if (!(removed = (uint8_t *)calloc(atlas->nglyphs + 1, 1)))
+        goto error;
+    if (!(pages = (uint8_t *)calloc(atlas->packer.npages, 1)))
+        goto error;
+    if (!(fonts = (msdfgl_font_t *)calloc(atlas->nglyphs + 1, sizeof(msdfgl_font_t))))
+        goto error;
+
+    for (size_t i = 0; i < atlas->nglyphs; ++i) {
+        msdfgl_atlas_entry *entry = &atlas->entries[i];
+        if (entry->state != MSDFGL_ENTRY_USED || entry->last_use >= atlas->frame)
+            continue;
+        candidates[ncandidates].last_use = entry->last_use;
+        candidates[ncandidates].index = (int)i;
+        ++ncandidates;
+    }
+    if (!ncandidates)
+        goto error;
+    qsort(candidates, ncandidates, sizeof(msdfgl_eviction), _msdfgl_compare_eviction);
+
+    GLint scissor[4];
+    GLboolean scissor_test = glIsEnabled(GL_SCISSOR_TEST);
+    glGetIntegerv(GL_SCISSOR_BOX, scissor);
+    glEnable(GL_SCISSOR_TEST);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, atlas->atlas_framebuffer);
+    glClearColor(0.0, 0.0, 0.0, 1.0);
+
+    size_t target = (size_t)atlas->texture_width * atlas->packer.page_height *
+                    atlas->packer.npages / 8;
+    size_t freed = 0;
+    for (size_t j = 0; j < ncandidates && freed < target; ++j) {
+        int i = candidates[j].index;
+        msdfgl_atlas_entry *entry = &atlas->entries[i];
+
+        _msdfgl_clear_entry(atlas, entry);
+        freed += (size_t)(entry->rect.width + atlas->padding) *
+                 (size_t)(entry->rect.height + atlas->padding);
+
+        removed[i] = 1;
+        pages[entry->page] = 1;
+        if (entry->font) {
+            size_t k = 0;
+            while (k < nfonts && fonts[k] != entry->font)
+                ++k;
+            if (k == nfonts)
+                fonts[nfonts++] = entry->font;
+        }
+        entry->state = MSDFGL_ENTRY_FREE;
+        entry->font = NULL;
+        atlas->free_entries[atlas->nfree++] = i;
+    }
+
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glScissor(scissor[0], scissor[1], scissor[2], scissor[3]);
+    if (!scissor_test)
+        glDisable(GL_SCISSOR_TEST);
+
+    for (size_t k = 0; k < nfonts; ++k) {
+        msdfgl_map_remove_indices(&fonts[k]->character_index, removed, atlas->nglyphs);
+        msdfgl_map_remove_indices(&fonts[k]->glyph_index, removed, atlas->nglyphs);
+    }
+    for (int page = 0; page < atlas->packer.npages; ++page) {
+        if (pages[page] && _msdfgl_rebuild_page(atlas, page, atlas->nglyphs + nnew))
+            goto error;
+    }
+    retval = 0;
+
+error:
+    if (candidates)
+        free(candidates);
+    if (removed)
+        free(removed);
+    if (pages)
+        free(pages);
+    if (fonts)
+        free(fonts);
+    return retval;
+}
+
+/**
+ * Upload the glyphs serialized by the workers of the font for the GPU
+ * generators, and link the sampler textures of the fragment path to them.
+ */
+static void _msdfgl_upload_inputs(msdfgl_font_t font) {
+    msdfgl_workers_t *workers = &font->_workers;
+
+    glBindBuffer(GL_ARRAY_BUFFER, font->_meta_input_buffer);
+    glBufferData(GL_ARRAY_BUFFER, msdfgl_workers_meta_size(workers) * sizeof(GLuint), NULL,
+                 GL_DYNAMIC_READ);
+    for (int i = 0; i < workers->nactive; ++i) {
+        msdfgl_worker_t *w = &workers->workers[i];
+        glBufferSubData(GL_ARRAY_BUFFER, w->meta_base * sizeof(GLuint),
+                        w->serializer.meta_size * sizeof(GLuint), w->serializer.meta);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, font->_point_input_buffer);
+    glBufferData(GL_ARRAY_BUFFER, msdfgl_workers_point_size(workers) * 2 * sizeof(GLshort),
+                 NULL, GL_DYNAMIC_READ);
+    for (int i = 0; i < workers->nactive; ++i) {
+        msdfgl_worker_t *w = &workers->workers[i];
+        glBufferSubData(GL_ARRAY_BUFFER, w->point_base * 2 * sizeof(GLshort),
+                        w->serializer.point_size * 2 * sizeof(GLshort), w->serializer.points);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, font->_segment_input_buffer);
+    glBufferData(GL_ARRAY_BUFFER,
+                 msdfgl_workers_segment_size(workers) * SERIALIZER_SEGMENT_SIZE *
+                     sizeof(GLfloat),
+                 NULL, GL_DYNAMIC_READ);
+    for (int i = 0; i < workers->nactive; ++i) {
+        msdfgl_worker_t *w = &workers->workers[i];
+        glBufferSubData(GL_ARRAY_BUFFER,
+                        w->segment_base * SERIALIZER_SEGMENT_SIZE * sizeof(GLfloat),
+                        w->serializer.segment_size * SERIALIZER_SEGMENT_SIZE * sizeof(GLfloat),
+                        w->serializer.segments);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    /* Link sampler textures to the buffers. */
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_BUFFER, font->_meta_input_texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, font->_meta_input_buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_BUFFER, font->_point_input_texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RG16I, font->_point_input_buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_BUFFER, font->_segment_input_texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, font->_segment_input_buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    glActiveTexture(GL_TEXTURE0);
+}
+
+int _msdfgl_generate_glyphs_internal(msdfgl_font_t font, int32_t start, int32_t end,
+                                     unsigned int range, int32_t *keys, int nkeys) {
+    GLint original_viewport[4];
+    glGetIntegerv(GL_VIEWPORT, original_viewport);
+
+    msdfgl_context_t ctx = font->context;
+    int retval = -2;
+
+    int nrender = range ? (end - start) : nkeys;
+
+    if (nrender <= 0)
+        return -1;
+
+    msdfgl_atlas_t atlas = font->atlas;
+
+    msdfgl_serialized_glyph_t *serialized = NULL;
+    msdfgl_index_entry *atlas_index = NULL;
+    msdfgl_gen_instance *instances = NULL;
+    msdfgl_placement *order = NULL;
+    int32_t *codes = NULL, *glyphs = NULL;
+    msdfgl_map_item_t **items = NULL, **slots = NULL;
+    int *entries = NULL;
+    int nglyphs = 0, nnew = 0;
+    msdfgl_packer_t packer;
+    int has_packer = 0;
+
+    int new_index_size = atlas->nallocated ? atlas->nallocated : 1;
+
+    /* Reserve the map slots for the whole batch up front. */
+    if (range) {
+        if (!(codes = (int32_t *)calloc(nrender, sizeof(int32_t))))
+            goto error;
+        for (int i = 0; i < nrender; ++i)
+            codes[i] = start + i;
+    }
+    if (!(items = (msdfgl_map_item_t **)calloc(nrender, sizeof(msdfgl_map_item_t *))))
+        goto error;
+    if (msdfgl_map_insert_list(&font->character_index, range ? codes : keys, nrender,
+                               items))
+        goto error;
+
+    /* Resolve the glyph behind each code. Glyphs which are already on the atlas,
+       or which appear earlier in this batch, are not generated again. */
+    if (!(glyphs = (int32_t *)calloc(nrender, sizeof(int32_t))))
+        goto error;
+    for (int i = 0; i < nrender; ++i)
+        glyphs[i] = FT_Get_Char_Index(font->face, items[i]->code);
+    if (!(slots = (msdfgl_map_item_t **)calloc(nrender, sizeof(msdfgl_map_item_t *))))
+        goto error;
+    if (msdfgl_map_insert_list(&font->glyph_index, glyphs, nrender, slots))
+        goto error;
+
+    /* Each new glyph takes an evicted index entry if there is one, and a new
+       one at the end otherwise. */
+    if (!(entries = (int *)calloc(nrender, sizeof(int))))
+        goto error;
+    if (_msdfgl_reserve_entries(atlas, atlas->nglyphs + nrender))
+        goto error;
+    for (int i = 0; i < nrender; ++i) {
+        if (slots[i]->index != -1) {
+            /* Keep it from being evicted by this batch. */
+            atlas->entries[slots[i]->index].last_use = atlas->frame;
+            continue;
+        }
+        int entry = atlas->nfree ? atlas->free_entries[--atlas->nfree]
+                                 : (int)atlas->nglyphs + nnew++;
+        atlas->entries[entry].font = font;
+        atlas->entries[entry].page = -1;
+        atlas->entries[entry].last_use = atlas->frame;
+        atlas->entries[entry].state = MSDFGL_ENTRY_PENDING;
+        slots[i]->index = entry;
+        entries[nglyphs] = entry;
+        glyphs[nglyphs++] = glyphs[i];
+    }
+    if (!nglyphs)
+        goto commit;
+
+    if (ctx->generator == MSDFGL_GENERATOR_GPU && _msdfgl_ensure_generator(ctx))
+        goto error;
+
+    /* The new glyphs would be missing from the compacted layout. */
+    _msdfgl_cancel_compaction(atlas);
+
+    serialized = (msdfgl_serialized_glyph_t *)calloc(nglyphs,
+                                                     sizeof(msdfgl_serialized_glyph_t));
+    if (!serialized)
+        goto error;
+
+    atlas_index = (msdfgl_index_entry *)calloc(nglyphs, sizeof(msdfgl_index_entry));
+    if (!atlas_index)
+        goto error;
+
+    instances = (msdfgl_gen_instance *)calloc(nglyphs, sizeof(msdfgl_gen_instance));
+    if (!instances)
+        goto error;
+    order = (msdfgl_placement *)calloc(nglyphs, sizeof(msdfgl_placement));
+    if (!order)
+        goto error;
+    int ninstances = 0;
+
+    /* Serialize the glyphs into RAM. */
+    /* Serialized outlines are in pixels at scale 1. The tolerance is capped to
+       a fraction of the range so the distance field keeps its precision. */
+    float tolerance = font->outline_tolerance / font->scale;
+    if (tolerance > font->range / 16.0f)
+        tolerance = font->range / 16.0f;
+    if (msdfgl_workers_serialize(&font->_workers, ctx->nthreads, tolerance, font->range,
+                                 _msdfgl_single_channel(atlas->format), font->max_scale > 0,
+                                 glyphs, nglyphs, serialized))
+        goto error;
+
+    for (int i = 0; i < nglyphs; ++i) {
+        FT_Glyph_Metrics *metrics = &serialized[i].metrics;
+
+        msdfgl_map_item_t *m = msdfgl_map_get(&font->glyph_index, glyphs[i]);
+        m->advance[0] = (float)metrics->horiAdvance;
+        m->advance[1] = (float)metrics->vertAdvance;
+
+        /* Adaptive glyphs get just the resolution their detail needs. */
+        float scale = font->scale;
+        if (font->max_scale > 0) {
+            scale = serialized[i].detail;
+            scale = scale > font->min_scale ? scale : font->min_scale;
+            scale = scale < font->max_scale ? scale : font->max_scale;
+        }
+
+        atlas_index[i].size_x = (metrics->width / SERIALIZER_SCALE + font->range) * scale;
+        atlas_index[i].size_y = (metrics->height / SERIALIZER_SCALE + font->range) * scale;
+        atlas_index[i].scale = scale / font->scale;
+        atlas_index[i].bearing_x = (GLfloat)metrics->horiBearingX;
+        atlas_index[i].bearing_y = (GLfloat)metrics->horiBearingY;
+        atlas_index[i].glyph_width = (GLfloat)metrics->width;
+        atlas_index[i].glyph_height = (GLfloat)metrics->height;
+
+        order[i].height = atlas_index[i].size_y;
+        order[i].index = i;
+    }
+
+    /* Place the tallest glyphs first, they leave the least waste. */
+    qsort(order, nglyphs, sizeof(msdfgl_placement), _msdfgl_compare_placement);
+
+    /* A failed batch gives its space back by restoring this copy. */
+    if (msdfgl_packer_copy(&packer, &atlas->packer))
+        goto error;
+    has_packer = 1;
+
+    for (int j = 0; j < nglyphs; ++j) {
+        int i = order[j].index, x, y, page, status;
+        int width = (int)ceilf(atlas_index[i].size_x);
+        int height = (int)ceilf(atlas_index[i].size_y);
+
+        /* A full atlas with a budget makes room by evicting. */
+        while ((status = msdfgl_packer_insert(&atlas->packer, width, height, &x, &y, &page)) > 0) {
+            if (_msdfgl_evict(atlas, nnew))
+                goto error;
+        }
+        if (status)
+            goto error;
+        atlas->entries[entries[i]].rect = (msdfgl_packer_rect_t){x, y, width, height};
+        atlas->entries[entries[i]].page = page;
+
+        atlas_index[i].offset_x = (GLfloat)x;
+        atlas_index[i].offset_y = (GLfloat)y;
+        atlas_index[i].page = (GLfloat)page;
+
+        /* No need to draw glyphs without segments. */
+        if (serialized[i].nsegments) {
+            msdfgl_gen_instance *instance = &instances[ninstances++];
+            instance->offset[0] = atlas_index[i].offset_x;
+            instance->offset[1] = atlas_index[i].offset_y;
+            instance->size[0] = atlas_index[i].size_x;
+            instance->size[1] = atlas_index[i].size_y;
+            instance->translate[0] =
+                -atlas_index[i].bearing_x / SERIALIZER_SCALE + font->range / 2.0f;
+            instance->translate[1] =
+                (atlas_index[i].glyph_height - atlas_index[i].bearing_y) / SERIALIZER_SCALE +
+                font->range / 2.0f;
+            instance->meta_offset = (GLint)serialized[i].meta_offset;
+            instance->point_offset = (GLint)serialized[i].point_offset;
+            instance->segment_offset = (GLint)serialized[i].segment_offset;
+            instance->page = page;
+            instance->scale = atlas_index[i].scale * font->scale;
+            instance->worker = serialized[i].worker;
+        }
+    }
+    qsort(instances, ninstances, sizeof(msdfgl_gen_instance), _msdfgl_compare_instance);
+
+    int new_texture_height = _msdfgl_texture_height(atlas, &atlas->packer);
+    int new_npages = atlas->packer.npages;
+    if (new_npages > atlas->max_pages)
+        goto error;
+    while ((int)atlas->nglyphs + nnew > new_index_size) {
+        new_index_size *= 2;
+    }
+
+    /* The CPU generator reads the serialized glyphs where they are. */
+    if (ctx->generator == MSDFGL_GENERATOR_GPU)
+        _msdfgl_upload_inputs(font);
+
+    if ((int)atlas->nallocated != new_index_size &&
+        _msdfgl_resize_atlas_index(atlas, new_index_size))
+        goto error;
+    /* Reused entries come first in the batch, new ones are appended at once. */
+    glBindBuffer(GL_ARRAY_BUFFER, atlas->index_buffer);
+    for (int i = 0; i < nglyphs - nnew; ++i) {
+        glBufferSubData(GL_ARRAY_BUFFER, sizeof(msdfgl_index_entry) * entries[i],
+                        sizeof(msdfgl_index_entry), &atlas_index[i]);
+    }
+    if (nnew) {
+        glBufferSubData(GL_ARRAY_BUFFER, sizeof(msdfgl_index_entry) * atlas->nglyphs,
+                        nnew * sizeof(msdfgl_index_entry), &atlas_index[nglyphs - nnew]);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_BUFFER, atlas->index_texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, atlas->index_buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    glActiveTexture(GL_TEXTURE0);
+
+    /* Extend the atlas texture. The compute path writes it as an image and
+       the CPU path uploads to it, neither needs a framebuffer or viewport. */
+    if ((atlas->texture_height != new_texture_height || atlas->npages != new_npages) &&
+        _msdfgl_resize_atlas_texture(atlas, new_texture_height, new_npages))
+        goto error;
+    if (ctx->generator == MSDFGL_GENERATOR_GPU && !ctx->compute_shader)
+        glViewport(0, 0, atlas->texture_width, atlas->texture_height);
+
+    GLfloat framebuffer_projection[4][4];
+    _msdfgl_ortho(0, (GLfloat)atlas->texture_width, 0, (GLfloat)atlas->texture_height,
+                  -1.0, 1.0, framebuffer_projection);
+    _msdfgl_ortho(-(GLfloat)atlas->texture_width, (GLfloat)atlas->texture_width,
+                  -(GLfloat)atlas->texture_height, (GLfloat)atlas->texture_height, -1.0,
+                  1.0, atlas->projection);
+
+    if (ctx->generator == MSDFGL_GENERATOR_CPU) {
+        if (_msdfgl_generate_cpu(font, instances, ninstances))
+            goto error;
+    } else {
+        /* The whole batch is generated at once, with an instance per glyph. */
+        glBindBuffer(GL_ARRAY_BUFFER, ctx->_instance_buffer);
+        glBufferData(GL_ARRAY_BUFFER, ninstances * sizeof(msdfgl_gen_instance), instances,
+                     GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        if (ctx->compute_shader) {
+            if (_msdfgl_generate_compute(font, instances, ninstances))
+                goto error;
+        } else {
+            _msdfgl_generate_fragment(font, framebuffer_projection, instances, ninstances);
+        }
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    atlas->nglyphs += nnew;
+    for (int i = 0; i < nglyphs; ++i)
+        atlas->entries[entries[i]].state = MSDFGL_ENTRY_USED;
+
+commit:
+    for (int i = 0; i < nrender; ++i) {
+        items[i]->index = slots[i]->index;
+        items[i]->advance[0] = slots[i]->advance[0];
+        items[i]->advance[1] = slots[i]->advance[1];
+    }
+    retval = nrender;
+
+error:
+    /* Forget the glyphs of a failed batch so that they can be generated again. */
+    for (int i = 0; retval < 0 && slots && entries && i < nrender; ++i) {
+        if (slots[i] && slots[i]->index != -1 &&
+            atlas->entries[slots[i]->index].state == MSDFGL_ENTRY_PENDING)
+            slots[i]->index = -1;
+    }
+    for (int i = 0; retval < 0 && entries && i < nglyphs; ++i) {
+        atlas->entries[entries[i]].state = MSDFGL_ENTRY_FREE;
+        atlas->entries[entries[i]].font = NULL;
+        if (entries[i] < (int)atlas->nglyphs)
+            atlas->free_entries[atlas->nfree++] = entries[i];
+    }
+    if (has_packer && retval < 0) {
+        msdfgl_packer_destroy(&atlas->packer);
+        atlas->packer = packer;
+        /* The copy still holds the space of glyphs the batch evicted. */
+        for (int page = 0; atlas->budget && page < atlas->packer.npages; ++page)
+            _msdfgl_rebuild_page(atlas, page, atlas->nglyphs);
+    } else if (has_packer) {
+        msdfgl_packer_destroy(&packer);
+    }
+    if (codes)
+        free(codes);
+    if (glyphs)
+        free(glyphs);
+    if (items)
+        free(items);
+    if (slots)
+        free(slots);
+    if (serialized)
+        free(serialized);
+    if (atlas_index)
+        free(atlas_index);
+    if (instances)
+        free(instances);
+    if (order)
+        free(order);
+    if (entries)
+        free(entries);
+
+    glViewport(original_viewport[0], original_viewport[1], original_viewport[2], original_viewport[3]);
+
+    return retval;
+}
+
+int msdfgl_generate_glyphs(msdfgl_font_t font, int32_t start, int32_t end) {
+    return _msdfgl_generate_glyphs_internal(font, start, end + 1, 1, NULL, 0);
+}
+
+int msdfgl_generate_glyph(msdfgl_font_t font, int32_t character, void *_user) {
+    return _msdfgl_generate_glyphs_internal(font, character, character + 1, 1, NULL, 0);
+}
+
+int msdfgl_generate_glyph_list(msdfgl_font_t font, int32_t *list, size_t n) {
+    return _msdfgl_generate_glyphs_internal(font, 0, 0, 0, list, n);
+}
+
+int msdfgl_atlas_reserve(msdfgl_atlas_t atlas, int texture_height, int npages,
+                         size_t nglyphs) {
+    if (texture_height > atlas->packer.page_height || npages > atlas->max_pages)
+        return -1;
+
+    _msdfgl_cancel_compaction(atlas);
 
-    return _msdfgl_init_font_internal(ctx, &face, range, scale, atlas);
+    texture_height = texture_height > atlas->texture_height ? texture_height
+                                                            : atlas->texture_height;
+    npages = npages > atlas->npages ? npages : atlas->npages;
+    npages = npages > 1 ? npages : 1;
+    if (texture_height && (texture_height != atlas->texture_height || npages != atlas->npages) &&
+        _msdfgl_resize_atlas_texture(atlas, texture_height, npages))
+        return -1;
+    if (nglyphs > atlas->nallocated && _msdfgl_resize_atlas_index(atlas, (int)nglyphs))
+        return -1;
+    return 0;
 }
 
 /**
- * Load font from memory and generate textures and buffers for it.
+ * Lay out the glyphs in use anew, tallest first, and create the texture they
+ * are to be copied to.
  */
-MSDFGL_EXPORT msdfgl_font_t msdfgl_load_font_mem(msdfgl_context_t ctx, void *font_buffer,
-                                                 size_t font_buffer_size, float range,
-                                                 float scale, msdfgl_atlas_t atlas)
-{
-    FT_Face face;
-    if (FT_New_Memory_Face(ctx->ft_library, font_buffer, font_buffer_size, 0, &face)) {
-        return NULL;
-    }
-
-    return _msdfgl_init_font_internal(ctx, &face, range, scale, atlas);
-}
+static int _msdfgl_start_compaction(msdfgl_atlas_t atlas) {
+    msdfgl_placement *order = NULL;
+    int retval = -1;
 
-void msdfgl_destroy_font(msdfgl_font_t font) {
+    if (msdfgl_packer_init(&atlas->compact_packer, atlas->packer.kind, atlas->texture_width,
+                           atlas->packer.page_height, atlas->padding))
+        return -1;
+    atlas->compact_packer.max_pages = atlas->packer.max_pages;
 
-    FT_Done_Face(font->face);
+    /* Glyphs of destroyed fonts are left behind. */
+    if (!(order = (msdfgl_placement *)calloc(atlas->nglyphs, sizeof(msdfgl_placement))))
+        goto error;
+    if (!(atlas->moves = (msdfgl_compaction_move *)calloc(atlas->nglyphs,
+                                                          sizeof(msdfgl_compaction_move))))
+        goto error;
+    for (size_t i = 0; i < atlas->nglyphs; ++i) {
+        if (atlas->entries[i].state != MSDFGL_ENTRY_USED || !atlas->entries[i].font)
+            continue;
+        order[atlas->nmoves].height = (GLfloat)atlas->entries[i].rect.height;
+        order[atlas->nmoves].index = (int)i;
+        ++atlas->nmoves;
+    }
+    qsort(order, atlas->nmoves, sizeof(msdfgl_placement), _msdfgl_compare_placement);
+
+    for (size_t j = 0; j < atlas->nmoves; ++j) {
+        msdfgl_compaction_move *move = &atlas->moves[j];
+        move->entry = order[j].index;
+        move->rect = atlas->entries[move->entry].rect;
+        if (msdfgl_packer_insert(&atlas->compact_packer, move->rect.width, move->rect.height,
+                                 &move->rect.x, &move->rect.y, &move->page))
+            goto error;
+    }
 
-    glDeleteBuffers(1, &font->_meta_input_buffer);
-    glDeleteBuffers(1, &font->_point_input_buffer);
-    glDeleteTextures(1, &font->_meta_input_texture);
-    glDeleteTextures(1, &font->_point_input_texture);
+    /* The smallest height the texture would have grown to for this layout. */
+    int height = 1;
+    while (msdfgl_packer_height(&atlas->compact_packer) > height)
+        height *= 2;
+    height = height < atlas->packer.page_height ? height : atlas->packer.page_height;
 
-    if (font->atlas->_implicit && !--font->atlas->_refcount)
-        msdfgl_destroy_atlas(font->atlas);
+    int npages = atlas->compact_packer.npages;
+    if (_msdfgl_create_atlas_texture(atlas, height, npages, &atlas->compact_texture,
+                                     &atlas->compact_framebuffer))
+        goto error;
+    atlas->compact_height = height;
 
-    msdfgl_map_destroy(&font->character_index);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, atlas->compact_framebuffer);
+    glClearColor(0.0, 0.0, 0.0, 1.0);
+    for (int i = 0; i < npages; ++i) {
+        glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                  atlas->compact_texture, 0, i);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-    free(font);
+    retval = 0;
+error:
+    if (order)
+        free(order);
+    if (retval < 0) {
+        msdfgl_packer_destroy(&atlas->compact_packer);
+        if (atlas->moves)
+            free(atlas->moves);
+        atlas->moves = NULL;
+        atlas->nmoves = 0;
+    }
+    return retval;
 }
 
-int _msdfgl_generate_glyphs_internal(msdfgl_font_t font, int32_t start, int32_t end,
-                                     unsigned int range, int32_t *keys, int nkeys) {
-    GLint original_viewport[4];
-    glGetIntegerv(GL_VIEWPORT, original_viewport);
-
-    msdfgl_context_t ctx = font->context;
-    int retval = -2;
+/**
+ * Switch the atlas over to the compacted texture and layout.
+ */
+static void _msdfgl_finish_compaction(msdfgl_atlas_t atlas) {
+    glBindBuffer(GL_ARRAY_BUFFER, atlas->index_buffer);
+    for (size_t j = 0; j < atlas->nmoves; ++j) {
+        const msdfgl_compaction_move *move = &atlas->moves[j];
+        msdfgl_atlas_entry *entry = &atlas->entries[move->entry];
+        GLfloat offset[2] = {(GLfloat)move->rect.x, (GLfloat)move->rect.y};
+        GLfloat page = (GLfloat)move->page;
+        size_t base = sizeof(msdfgl_index_entry) * move->entry;
+        glBufferSubData(GL_ARRAY_BUFFER, base + offsetof(msdfgl_index_entry, offset_x),
+                        sizeof(offset), offset);
+        glBufferSubData(GL_ARRAY_BUFFER, base + offsetof(msdfgl_index_entry, page),
+                        sizeof(page), &page);
+        entry->rect = move->rect;
+        entry->page = move->page;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-    int nrender = range ? (end - start) : nkeys;
+    glDeleteTextures(1, &atlas->atlas_texture);
+    glDeleteFramebuffers(1, &atlas->atlas_framebuffer);
+    atlas->atlas_texture = atlas->compact_texture;
+    atlas->atlas_framebuffer = atlas->compact_framebuffer;
+    atlas->texture_height = atlas->compact_height;
+    atlas->npages = atlas->compact_packer.npages;
+    _msdfgl_ortho(-(GLfloat)atlas->texture_width, (GLfloat)atlas->texture_width,
+                  -(GLfloat)atlas->texture_height, (GLfloat)atlas->texture_height, -1.0,
+                  1.0, atlas->projection);
+    msdfgl_packer_destroy(&atlas->packer);
+    atlas->packer = atlas->compact_packer;
+
+    /* Entries of destroyed fonts can be reused now. Those of fonts destroyed
+       during the compaction were placed as well, MaxRects can take their
+       space back. */
+    int removed = 0;
+    for (size_t i = 0; i < atlas->nglyphs; ++i) {
+        if (atlas->entries[i].state != MSDFGL_ENTRY_USED || atlas->entries[i].font)
+            continue;
+        /* Not on the new layout, nor on the texture. */
+        atlas->entries[i].state = MSDFGL_ENTRY_FREE;
+        atlas->entries[i].page = -1;
+        atlas->entries[i].rect = (msdfgl_packer_rect_t){0, 0, 0, 0};
+        atlas->free_entries[atlas->nfree++] = (int)i;
+        removed = 1;
+    }
+    for (int page = 0; removed && atlas->packer.kind == MSDFGL_PACKER_MAXRECTS &&
+                       page < atlas->packer.npages; ++page)
+        _msdfgl_rebuild_page(atlas, page, atlas->nglyphs);
+
+    atlas->compact_texture = 0;
+    atlas->compact_framebuffer = 0;
+    free(atlas->moves);
+    atlas->moves = NULL;
+    atlas->nmoves = 0;
+    atlas->nmoved = 0;
+}
 
-    if (nrender <= 0)
+int msdfgl_compact_atlas(msdfgl_atlas_t atlas, int max_glyphs) {
+    if (!atlas->nglyphs)
+        return 0;
+    if (!atlas->compact_texture && _msdfgl_start_compaction(atlas))
         return -1;
 
-    msdfgl_atlas_t atlas = font->atlas;
-
-    if (!atlas->nglyphs && range && !start) {
-        /* We can generate an optimized lookup for the atlas index. */
-        font->_direct_lookup_upper_limit = end;
+    size_t end = atlas->nmoves;
+    if (max_glyphs > 0 && atlas->nmoved + max_glyphs < end)
+        end = atlas->nmoved + max_glyphs;
+
+    /* The old texture is still the one rendered from, so the glyphs can be
+       copied a few at a time. */
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, atlas->atlas_framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, atlas->compact_framebuffer);
+    for (; atlas->nmoved < end; ++atlas->nmoved) {
+        const msdfgl_compaction_move *move = &atlas->moves[atlas->nmoved];
+        const msdfgl_atlas_entry *entry = &atlas->entries[move->entry];
+        msdfgl_packer_rect_t from = entry->rect, to = move->rect;
+
+        glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                  atlas->atlas_texture, 0, entry->page);
+        glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                  atlas->compact_texture, 0, move->page);
+        glBlitFramebuffer(from.x, from.y, from.x + from.width, from.y + from.height, to.x, to.y,
+                          to.x + to.width, to.y + to.height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
     }
-    size_t *meta_sizes = NULL, *point_sizes = NULL;
-    msdfgl_index_entry *atlas_index = NULL;
-    void *point_data = NULL, *metadata = NULL;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-    /* We will start with a square texture. */
-    int new_texture_height = atlas->texture_height ? atlas->texture_height : 1;
-    int new_index_size = atlas->nallocated ? atlas->nallocated : 1;
+    if (atlas->nmoved < atlas->nmoves)
+        return 1;
+
+    _msdfgl_finish_compaction(atlas);
+    return 0;
+}
+
+int msdfgl_reserve_glyph_list(msdfgl_font_t font, const int32_t *list, size_t n) {
+    msdfgl_atlas_t atlas = font->atlas;
+    msdfgl_packer_t packer;
+    int32_t *glyphs = NULL;
+    msdfgl_map_item_t **slots = NULL;
+    msdfgl_placement *order = NULL;
+    int *widths = NULL;
+    int nglyphs = 0;
+    int retval = -1;
+
+    if (msdfgl_packer_copy(&packer, &atlas->packer))
+        return -1;
 
-    /* Calculate the amount of memory needed on the GPU.*/
-    if (!(meta_sizes = (size_t *)calloc(nrender, sizeof(size_t))))
+    if (!(glyphs = (int32_t *)calloc(n + 1, sizeof(int32_t))))
         goto error;
-    if (!(point_sizes = (size_t *)calloc(nrender, sizeof(size_t))))
+    if (!(slots = (msdfgl_map_item_t **)calloc(n + 1, sizeof(msdfgl_map_item_t *))))
         goto error;
-
-    /* Amount of new memory needed for the index. */
-    size_t index_size = nrender * sizeof(msdfgl_index_entry);
-    atlas_index = (msdfgl_index_entry *)calloc(1, index_size);
-    if (!atlas_index)
+    if (!(order = (msdfgl_placement *)calloc(n + 1, sizeof(msdfgl_placement))))
         goto error;
-
-    size_t meta_size_sum = 0, point_size_sum = 0;
-    for (size_t i = 0; (int)i < (int)nrender; ++i) {
-        int index = range ? start + (int)i : keys[i];
-        msdfgl_glyph_buffer_size(font->face, index, &meta_sizes[i], &point_sizes[i]);
-
-        meta_size_sum += meta_sizes[i];
-        point_size_sum += point_sizes[i];
-    }
-
-    /* Allocate the calculated amount. */
-    if (!(point_data = calloc(point_size_sum, 1)))
+    if (!(widths = (int *)calloc(n + 1, sizeof(int))))
         goto error;
-    if (!(metadata = calloc(meta_size_sum, 1)))
+
+    for (size_t i = 0; i < n; ++i)
+        glyphs[i] = FT_Get_Char_Index(font->face, list[i]);
+    if (msdfgl_map_insert_list(&font->glyph_index, glyphs, n, slots))
         goto error;
 
-    /* Serialize the glyphs into RAM. */
-    char *meta_ptr = metadata;
-    char *point_ptr = point_data;
-    for (size_t i = 0; (int)i < (int)nrender; ++i) {
-        float buffer_width, buffer_height;
-
-        int index = range ? start + (int)i : keys[i];
-        msdfgl_serialize_glyph(font->face, index, meta_ptr, (GLfloat *)point_ptr);
-
-        msdfgl_map_item_t *m = msdfgl_map_insert(&font->character_index, index);
-        m->index = atlas->nglyphs + i;
-        m->advance[0] = (float)font->face->glyph->metrics.horiAdvance;
-        m->advance[1] = (float)font->face->glyph->metrics.vertAdvance;
-
-        /* If we are generating a range starting from 0, we reuse the NULL
-           character bitmap for all control characters.*/
-        if (range && start == 0 && index != 0 && _msdfgl_is_control(index)) {
-            atlas_index[i] = atlas_index[0];
-            while ((int)(atlas->nglyphs + i) > new_index_size)
-                new_index_size *= 2;
+    /* Measure the glyphs not on the atlas yet, in the order generation would
+       find them. Their slots are marked with -2 meanwhile. */
+    for (size_t i = 0; i < n; ++i) {
+        if (slots[i]->index != -1)
             continue;
-        }
-
-        buffer_width = font->face->glyph->metrics.width / SERIALIZER_SCALE + font->range;
-        buffer_height =
-            font->face->glyph->metrics.height / SERIALIZER_SCALE + font->range;
-        buffer_width *= font->scale;
-        buffer_height *= font->scale;
+        slots[i]->index = -2;
+        if (FT_Load_Glyph(font->face, glyphs[i], FT_LOAD_NO_SCALE))
+            goto error;
 
-        meta_ptr += meta_sizes[i];
-        point_ptr += point_sizes[i];
+        /* Adaptive glyphs are measured at their largest scale. */
+        float scale = font->max_scale > 0 ? font->max_scale : font->scale;
+        FT_Glyph_Metrics *metrics = &font->face->glyph->metrics;
+        widths[nglyphs] = (int)ceilf((metrics->width / SERIALIZER_SCALE + font->range) * scale);
+        order[nglyphs].height = (metrics->height / SERIALIZER_SCALE + font->range) * scale;
+        order[nglyphs].index = nglyphs;
+        ++nglyphs;
+    }
 
-        if (atlas->offset_x + buffer_width > atlas->texture_width) {
-            atlas->offset_y += (atlas->y_increment + atlas->padding);
-            atlas->offset_x = 1;
-            atlas->y_increment = 0;
-        }
-        atlas->y_increment = (size_t)buffer_height > atlas->y_increment
-                                 ? (size_t)buffer_height
-                                 : atlas->y_increment;
-
-        atlas_index[i].offset_x = (GLfloat)atlas->offset_x;
-        atlas_index[i].offset_y = (GLfloat)atlas->offset_y;
-        atlas_index[i].size_x = buffer_width;
-        atlas_index[i].size_y = buffer_height;
-        atlas_index[i].bearing_x = (GLfloat)font->face->glyph->metrics.horiBearingX;
-        atlas_index[i].bearing_y = (GLfloat)font->face->glyph->metrics.horiBearingY;
-        atlas_index[i].glyph_width = (GLfloat)font->face->glyph->metrics.width;
-        atlas_index[i].glyph_height = (GLfloat)font->face->glyph->metrics.height;
-
-        atlas->offset_x += (size_t)buffer_width + atlas->padding;
-
-        while ((atlas->offset_y + buffer_height) > new_texture_height) {
-            new_texture_height *= 2;
-        }
-        if (new_texture_height > font->context->_max_texture_size) {
+    /* Pack them on a copy of the atlas packer to learn the height they need. */
+    qsort(order, nglyphs, sizeof(msdfgl_placement), _msdfgl_compare_placement);
+    for (int j = 0; j < nglyphs; ++j) {
+        int x, y, page;
+        int status = msdfgl_packer_insert(&packer, widths[order[j].index],
+                                          (int)ceilf(order[j].height), &x, &y, &page);
+        if (status < 0)
             goto error;
-        }
-        while ((int)(atlas->nglyphs + i) >= new_index_size) {
-            new_index_size *= 2;
-        }
+        /* A full atlas with a budget: reserve all of it. */
+        if (status > 0)
+            break;
     }
 
-    /* Allocate and fill the buffers on GPU. */
-    glBindBuffer(GL_ARRAY_BUFFER, font->_meta_input_buffer);
-    glBufferData(GL_ARRAY_BUFFER, meta_size_sum, metadata, GL_DYNAMIC_READ);
+    /* Rounding up the way growth does also leaves some slack for glyphs
+       generated one at a time instead of as one batch. */
+    retval = msdfgl_atlas_reserve(atlas, _msdfgl_texture_height(atlas, &packer), packer.npages,
+                                  atlas->nglyphs + nglyphs);
 
-    glBindBuffer(GL_ARRAY_BUFFER, font->_point_input_buffer);
-    glBufferData(GL_ARRAY_BUFFER, point_size_sum, point_data, GL_DYNAMIC_READ);
+error:
+    for (size_t i = 0; slots && i < n; ++i) {
+        if (slots[i] && slots[i]->index == -2)
+            slots[i]->index = -1;
+    }
+    msdfgl_packer_destroy(&packer);
+    if (glyphs)
+        free(glyphs);
+    if (slots)
+        free(slots);
+    if (order)
+        free(order);
+    if (widths)
+        free(widths);
+    return retval;
+}
 
-    if ((int)atlas->nallocated == new_index_size) {
-        glBindBuffer(GL_ARRAY_BUFFER, atlas->index_buffer);
-    } else {
-        GLuint new_buffer;
-        glGenBuffers(1, &new_buffer);
-        glBindBuffer(GL_ARRAY_BUFFER, new_buffer);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(msdfgl_index_entry) * new_index_size, 0,
-                     GL_DYNAMIC_READ);
-        if (glGetError() == GL_OUT_OF_MEMORY) {
-            glDeleteBuffers(1, &new_buffer);
-            glBindBuffer(GL_ARRAY_BUFFER, 0);
-            goto error;
-        }
-        if (atlas->nglyphs) {
-            glBindBuffer(GL_COPY_READ_BUFFER, atlas->index_buffer);
-            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_ARRAY_BUFFER, 0, 0,
-                                atlas->nglyphs * sizeof(msdfgl_index_entry));
-            glBindBuffer(GL_COPY_READ_BUFFER, 0);
-        }
-        atlas->nallocated = new_index_size;
-        glDeleteBuffers(1, &atlas->index_buffer);
-        atlas->index_buffer = new_buffer;
+/**
+ * Hash of the font file, computed on first use.
+ */
+static int _msdfgl_font_hash(msdfgl_font_t font, uint64_t *hash) {
+    if (!font->hashed) {
+        if (font->font_data)
+            font->font_hash = msdfgl_cache_hash(font->font_data, font->font_data_size, 0);
+        else if (!font->font_name || msdfgl_cache_hash_file(font->font_name, &font->font_hash))
+            return -1;
+        font->hashed = 1;
     }
-    glBufferSubData(GL_ARRAY_BUFFER, sizeof(msdfgl_index_entry) * atlas->nglyphs,
-                    index_size, atlas_index);
+    *hash = font->font_hash;
+    return 0;
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+/**
+ * Append `size` bytes to a cache file at the next aligned offset, which is
+ * stored to `offset`. `pos` tracks the end of the file.
+ */
+static int _msdfgl_cache_write(FILE *file, uint64_t *pos, const void *data, size_t size,
+                               uint64_t *offset) {
+    static const uint8_t zeros[CACHE_ALIGN];
+    size_t pad = (size_t)((CACHE_ALIGN - *pos % CACHE_ALIGN) % CACHE_ALIGN);
+    if (fwrite(zeros, 1, pad, file) != pad)
+        return -1;
+    *offset = *pos + pad;
+    if (size && fwrite(data, 1, size, file) != size)
+        return -1;
+    *pos = *offset + size;
+    return 0;
+}
 
-    /* Link sampler textures to the buffers. */
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_BUFFER, font->_meta_input_texture);
-    glTexBuffer(GL_TEXTURE_BUFFER, GL_R8UI, font->_meta_input_buffer);
-    glBindTexture(GL_TEXTURE_BUFFER, 0);
+/**
+ * Write the items of a map to a cache file.
+ */
+static int _msdfgl_cache_write_map(FILE *file, uint64_t *pos, msdfgl_map_t *map,
+                                   uint64_t *offset, uint64_t *n) {
+    *n = 0;
+    for (msdfgl_map_item_t *item = msdfgl_map_next(map, NULL); item;
+         item = msdfgl_map_next(map, item))
+        ++*n;
+
+    msdfgl_cache_item *items = calloc(*n + 1, sizeof(msdfgl_cache_item));
+    if (!items)
+        return -1;
 
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_BUFFER, font->_point_input_texture);
-    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, font->_point_input_buffer);
-    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    size_t i = 0;
+    for (msdfgl_map_item_t *item = msdfgl_map_next(map, NULL); item;
+         item = msdfgl_map_next(map, item), ++i) {
+        items[i].code = (uint32_t)item->code;
+        items[i].index = item->index;
+        items[i].advance[0] = item->advance[0];
+        items[i].advance[1] = item->advance[1];
+    }
+    int status = _msdfgl_cache_write(file, pos, items, *n * sizeof(msdfgl_cache_item), offset);
+    free(items);
+    return status;
+}
 
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_BUFFER, atlas->index_texture);
-    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, atlas->index_buffer);
-    glBindTexture(GL_TEXTURE_BUFFER, 0);
+int msdfgl_save_atlas(msdfgl_atlas_t atlas, msdfgl_font_t *fonts, size_t nfonts,
+                      const char *path) {
+    int retval = -1;
+    FILE *file = NULL;
+    char *tmp_path = NULL;
+    msdfgl_cache_font *records = NULL;
+    msdfgl_cache_entry *entries = NULL;
+    msdfgl_cache_page *pages = NULL;
+    void *index = NULL, *pixels = NULL;
+    uint64_t pos = 0, offset;
+
+    msdfgl_cache_header header;
+    memset(&header, 0, sizeof(msdfgl_cache_header));
+
+    for (size_t i = 0; i < nfonts; ++i) {
+        if (fonts[i]->atlas != atlas)
+            return -1;
+    }
 
-    glActiveTexture(GL_TEXTURE0);
+    size_t texture_size = (size_t)atlas->texture_width * atlas->texture_height *
+                          atlas->npages * _msdfgl_texel_size(atlas->format);
+    if (!(records = (msdfgl_cache_font *)calloc(nfonts + 1, sizeof(msdfgl_cache_font))))
+        goto error;
+    if (!(entries = (msdfgl_cache_entry *)calloc(atlas->nglyphs + 1,
+                                                 sizeof(msdfgl_cache_entry))))
+        goto error;
+    if (!(pages = (msdfgl_cache_page *)calloc(atlas->packer.npages, sizeof(msdfgl_cache_page))))
+        goto error;
+    if (!(index = malloc(atlas->nglyphs * sizeof(msdfgl_index_entry) + 1)))
+        goto error;
+    if (!(pixels = malloc(texture_size + 1)))
+        goto error;
 
-    /* Generate the atlas texture and bind it as the framebuffer. */
-    if (atlas->texture_height == new_texture_height) {
-        /* No need to extend the texture. */
-        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, atlas->atlas_framebuffer);
-        glBindTexture(GL_TEXTURE_2D, atlas->atlas_texture);
-        glViewport(0, 0, atlas->texture_width, atlas->texture_height);
-    } else {
-        GLuint new_texture;
-        GLuint new_framebuffer;
-        glGenTextures(1, &new_texture);
-        glGenFramebuffers(1, &new_framebuffer);
-        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, new_framebuffer);
-
-        glBindTexture(GL_TEXTURE_2D, new_texture);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, atlas->texture_width,
-                     new_texture_height, 0, GL_RGBA, GL_FLOAT, NULL);
-
-        if (glGetError() == GL_OUT_OF_MEMORY) {
-            /* Buffer size too big, are you trying to type Klingon? */
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
-            glDeleteFramebuffers(1, &new_framebuffer);
-            glDeleteTextures(1, &new_texture);
-            goto error;
-        }
+    /* Written aside and renamed into place, so that processes which have the
+       old file mapped keep reading it whole, and a failed save keeps it. The
+       header is written last, a file cut short keeps the blank one. */
+    if (!(file = msdfgl_cache_create(path, &tmp_path)))
+        goto error;
+    if (_msdfgl_cache_write(file, &pos, &header, sizeof(msdfgl_cache_header), &offset))
+        goto error;
 
-        glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
-                               new_texture, 0);
-        glViewport(0, 0, atlas->texture_width, new_texture_height);
-        glClearColor(0.0, 0.0, 0.0, 1.0);
-        glClear(GL_COLOR_BUFFER_BIT);
+    for (size_t i = 0; i < nfonts; ++i) {
+        if (_msdfgl_font_hash(fonts[i], &records[i].hash))
+            goto error;
+        records[i].range = fonts[i]->range;
+        records[i].scale = fonts[i]->scale;
+        records[i].outline_tolerance = fonts[i]->outline_tolerance;
+        records[i].min_scale = fonts[i]->min_scale;
+        records[i].max_scale = fonts[i]->max_scale;
+        if (_msdfgl_cache_write_map(file, &pos, &fonts[i]->character_index,
+                                    &records[i].items_offset[0], &records[i].nitems[0]) ||
+            _msdfgl_cache_write_map(file, &pos, &fonts[i]->glyph_index,
+                                    &records[i].items_offset[1], &records[i].nitems[1]))
+            goto error;
+    }
+    if (_msdfgl_cache_write(file, &pos, records, nfonts * sizeof(msdfgl_cache_font),
+                            &header.fonts_offset))
+        goto error;
 
-        if (atlas->texture_height) {
-            /* Old texture had data -> copy. */
-            glBindFramebuffer(GL_READ_FRAMEBUFFER, atlas->atlas_framebuffer);
-            glBlitFramebuffer(0, 0, atlas->texture_width, atlas->texture_height, 0, 0,
-                              atlas->texture_width, atlas->texture_height,
-                              GL_COLOR_BUFFER_BIT, GL_NEAREST);
-            glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    for (size_t i = 0; i < atlas->nglyphs; ++i) {
+        const msdfgl_atlas_entry *entry = &atlas->entries[i];
+        entries[i].font = -1;
+        for (size_t j = 0; entry->font && j < nfonts; ++j) {
+            if (fonts[j] == entry->font)
+                entries[i].font = (int32_t)j;
+        }
+        entries[i].state = entry->state;
+        entries[i].page = -1;
+        /* Free entries are on no page, whatever place they had before. */
+        if (entry->state != MSDFGL_ENTRY_FREE) {
+            entries[i].page = entry->page;
+            entries[i].rect[0] = entry->rect.x;
+            entries[i].rect[1] = entry->rect.y;
+            entries[i].rect[2] = entry->rect.width;
+            entries[i].rect[3] = entry->rect.height;
         }
-
-        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
-        atlas->texture_height = new_texture_height;
-        glDeleteTextures(1, &atlas->atlas_texture);
-        atlas->atlas_texture = new_texture;
-        glDeleteFramebuffers(1, &atlas->atlas_framebuffer);
-        atlas->atlas_framebuffer = new_framebuffer;
     }
-    glBindTexture(GL_TEXTURE_2D, 0);
-
-    GLfloat framebuffer_projection[4][4];
-    _msdfgl_ortho(0, (GLfloat)atlas->texture_width, 0, (GLfloat)atlas->texture_height,
-                  -1.0, 1.0, framebuffer_projection);
-    _msdfgl_ortho(-(GLfloat)atlas->texture_width, (GLfloat)atlas->texture_width,
-                  -(GLfloat)atlas->texture_height, (GLfloat)atlas->texture_height, -1.0,
-                  1.0, atlas->projection);
-
-    glUseProgram(ctx->gen_shader);
-    glUniform1i(ctx->metadata_uniform, 0);
-    glUniform1i(ctx->point_data_uniform, 1);
-
-    glUniformMatrix4fv(ctx->_atlas_projection_uniform, 1, GL_FALSE,
-                       (GLfloat *)framebuffer_projection);
+    if (_msdfgl_cache_write(file, &pos, entries, atlas->nglyphs * sizeof(msdfgl_cache_entry),
+                            &header.entries_offset) ||
+        _msdfgl_cache_write(file, &pos, atlas->free_entries, atlas->nfree * sizeof(int),
+                            &header.free_offset))
+        goto error;
 
-    glUniform2f(ctx->_scale_uniform, font->scale, font->scale);
-    glUniform1f(ctx->_range_uniform, font->range);
-    glUniform1i(ctx->_meta_offset_uniform, 0);
-    glUniform1i(ctx->_point_offset_uniform, 0);
+    for (int i = 0; i < atlas->packer.npages; ++i) {
+        const msdfgl_packer_page_t *page = &atlas->packer.pages[i];
+        pages[i].shelf_x = page->shelf_x;
+        pages[i].shelf_y = page->shelf_y;
+        pages[i].shelf_height = page->shelf_height;
+        pages[i].height = page->height;
+        pages[i].area = page->area;
+        pages[i].nrects = page->nrects;
+        if (_msdfgl_cache_write(file, &pos, page->rects,
+                                page->nrects * sizeof(msdfgl_packer_rect_t),
+                                &pages[i].rects_offset))
+            goto error;
+    }
+    if (_msdfgl_cache_write(file, &pos, pages, atlas->packer.npages * sizeof(msdfgl_cache_page),
+                            &header.pages_offset))
+        goto error;
 
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        fprintf(stderr, "msdfgl: framebuffer incomplete: %x\n",
-                glCheckFramebufferStatus(GL_FRAMEBUFFER));
+    /* Read the index and the texture back from the GPU. */
+    if (atlas->nglyphs) {
+        glBindBuffer(GL_COPY_READ_BUFFER, atlas->index_buffer);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, atlas->nglyphs * sizeof(msdfgl_index_entry),
+                           index);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+    if (texture_size) {
+        GLenum client_format, type;
+        GLint alignment;
+        _msdfgl_texel_type(atlas->format, &client_format, &type);
+        glGetIntegerv(GL_PACK_ALIGNMENT, &alignment);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, atlas->atlas_texture);
+        glGetTexImage(GL_TEXTURE_2D_ARRAY, 0, client_format, type, pixels);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        glPixelStorei(GL_PACK_ALIGNMENT, alignment);
+    }
+    if (_msdfgl_cache_write(file, &pos, index, atlas->nglyphs * sizeof(msdfgl_index_entry),
+                            &header.index_offset) ||
+        _msdfgl_cache_write(file, &pos, pixels, texture_size, &header.texture_offset))
+        goto error;
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_BUFFER, font->_meta_input_texture);
+    memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    header.version = CACHE_VERSION;
+    header.byte_order = 1;
+    header.format = atlas->format;
+    header.texture_width = atlas->texture_width;
+    header.padding = atlas->padding;
+    header.packer = atlas->packer.kind;
+    header.page_height = atlas->packer.page_height;
+    header.max_pages = atlas->packer.max_pages;
+    header.texture_height = atlas->texture_height;
+    header.npages = atlas->npages;
+    header.npacker_pages = atlas->packer.npages;
+    header.nfonts = (uint32_t)nfonts;
+    header.nglyphs = atlas->nglyphs;
+    header.nfree = atlas->nfree;
+    header.size = pos;
+    if (fseek(file, 0, SEEK_SET) ||
+        fwrite(&header, sizeof(msdfgl_cache_header), 1, file) != 1)
+        goto error;
 
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_BUFFER, font->_point_input_texture);
+    retval = fclose(file) || msdfgl_cache_replace(tmp_path, path) ? -1 : 0;
+    file = NULL;
 
-    glBindVertexArray(ctx->bbox_vao);
-    glBindBuffer(GL_ARRAY_BUFFER, ctx->bbox_vbo);
+error:
+    if (file)
+        fclose(file);
+    if (retval && tmp_path)
+        remove(tmp_path);
+    if (tmp_path)
+        free(tmp_path);
+    if (records)
+        free(records);
+    if (entries)
+        free(entries);
+    if (pages)
+        free(pages);
+    if (index)
+        free(index);
+    if (pixels)
+        free(pixels);
+    return retval;
+}
 
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), 0);
-    glEnableVertexAttribArray(0);
+/**
+ * The `n` items of `size` bytes at `offset` of a cache file, NULL if they
+ * are not all within it.
+ */
+static const void *_msdfgl_cache_section(const msdfgl_cache_file_t *file, uint64_t offset,
+                                         uint64_t n, size_t size) {
+    if (offset > file->size || offset % CACHE_ALIGN || n > (file->size - offset) / size)
+        return NULL;
+    return file->data + offset;
+}
 
-    int meta_offset = 0;
-    int point_offset = 0;
-    for (int i = 0; i < nrender; ++i) {
-        if (range && start == 0 && i != 0 && _msdfgl_is_control(i))
-            continue;
+/**
+ * Forget the state restored by a failed msdfgl_load_atlas.
+ */
+static void _msdfgl_unload_atlas(msdfgl_atlas_t atlas, msdfgl_font_t *fonts, size_t nfonts) {
+    for (size_t i = 0; i < nfonts; ++i) {
+        msdfgl_map_destroy(&fonts[i]->character_index);
+        msdfgl_map_destroy(&fonts[i]->glyph_index);
+    }
+    msdfgl_packer_reset(&atlas->packer);
+    atlas->nfree = 0;
+}
 
-        msdfgl_index_entry g = atlas_index[i];
-        float w = g.size_x;
-        float h = g.size_y;
-        GLfloat bounding_box[] = {0, 0, w, 0, 0, h, 0, h, w, 0, w, h};
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(bounding_box), bounding_box);
+int msdfgl_load_atlas(msdfgl_atlas_t atlas, msdfgl_font_t *fonts, size_t nfonts,
+                      const char *path) {
+    if (atlas->nglyphs)
+        return -1;
+    for (size_t i = 0; i < nfonts; ++i) {
+        if (fonts[i]->atlas != atlas)
+            return -1;
+    }
 
-        glUniform2f(
-            ctx->_translate_uniform, -g.bearing_x / SERIALIZER_SCALE + font->range / 2.0f,
-            (g.glyph_height - g.bearing_y) / SERIALIZER_SCALE + font->range / 2.0f);
+    msdfgl_cache_file_t file;
+    int retval = msdfgl_cache_open(&file, path);
+    if (retval)
+        return retval;
+    /* Anything not matching makes the file stale. */
+    retval = 1;
+
+    const msdfgl_cache_header *header =
+        (const msdfgl_cache_header *)_msdfgl_cache_section(&file, 0, 1,
+                                                           sizeof(msdfgl_cache_header));
+    if (!header || memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) ||
+        header->version != CACHE_VERSION || header->byte_order != 1 ||
+        header->size != file.size)
+        goto error;
+    if (header->format != atlas->format || header->texture_width != atlas->texture_width ||
+        header->padding != atlas->padding || header->packer != (int32_t)atlas->packer.kind ||
+        header->page_height != atlas->packer.page_height ||
+        header->max_pages != atlas->packer.max_pages || header->nfonts != nfonts)
+        goto error;
+    if (header->texture_height < 0 || header->texture_height > atlas->max_texture_height ||
+        header->npages < 0 || header->npages > atlas->max_pages ||
+        header->npacker_pages < 1 || header->npacker_pages > header->npages + 1 ||
+        header->nglyphs > INT32_MAX || header->nfree > header->nglyphs)
+        goto error;
 
-        glUniform2f(ctx->_texture_offset_uniform, g.offset_x, g.offset_y);
-        glUniform1i(ctx->_meta_offset_uniform, meta_offset);
-        glUniform1i(ctx->_point_offset_uniform, point_offset / (2 * sizeof(GLfloat)));
-        glUniform1f(ctx->_glyph_height_uniform, g.size_y);
+    size_t texture_size = (size_t)header->texture_width * header->texture_height *
+                          header->npages * _msdfgl_texel_size(atlas->format);
+    const msdfgl_cache_font *records = _msdfgl_cache_section(
+        &file, header->fonts_offset, nfonts, sizeof(msdfgl_cache_font));
+    const msdfgl_cache_entry *entries = _msdfgl_cache_section(
+        &file, header->entries_offset, header->nglyphs, sizeof(msdfgl_cache_entry));
+    const int32_t *free_entries = _msdfgl_cache_section(
+        &file, header->free_offset, header->nfree, sizeof(int32_t));
+    const msdfgl_cache_page *pages = _msdfgl_cache_section(
+        &file, header->pages_offset, header->npacker_pages, sizeof(msdfgl_cache_page));
+    const void *index = _msdfgl_cache_section(&file, header->index_offset, header->nglyphs,
+                                              sizeof(msdfgl_index_entry));
+    const void *pixels = _msdfgl_cache_section(&file, header->texture_offset, texture_size, 1);
+    if (!records || !entries || !free_entries || !pages || !index || !pixels)
+        goto error;
 
-        /* No need for draw call if there are no contours */
-        if (((unsigned char *)metadata)[meta_offset])
-            glDrawArrays(GL_TRIANGLES, 0, 6);
+    for (size_t i = 0; i < nfonts; ++i) {
+        uint64_t hash;
+        if (_msdfgl_font_hash(fonts[i], &hash)) {
+            retval = -1;
+            goto error;
+        }
+        if (records[i].hash != hash || records[i].range != fonts[i]->range ||
+            records[i].scale != fonts[i]->scale ||
+            records[i].outline_tolerance != fonts[i]->outline_tolerance ||
+            records[i].min_scale != fonts[i]->min_scale ||
+            records[i].max_scale != fonts[i]->max_scale)
+            goto error;
+    }
 
-        meta_offset += meta_sizes[i];
-        point_offset += point_sizes[i];
+    /* Restore the CPU side first, it is the easier one to roll back. */
+    size_t nglyphs = (size_t)header->nglyphs;
+    if (_msdfgl_reserve_entries(atlas, nglyphs)) {
+        retval = -1;
+        goto error;
+    }
+    for (size_t i = 0; i < nglyphs; ++i) {
+        const msdfgl_cache_entry *e = &entries[i];
+        msdfgl_atlas_entry *entry = &atlas->entries[i];
+        if (e->font < -1 || e->font >= (int32_t)nfonts)
+            goto rollback;
+        entry->font = e->font >= 0 ? fonts[e->font] : NULL;
+        entry->last_use = 0;
+        entry->state = e->state;
+        if (e->state == MSDFGL_ENTRY_FREE) {
+            entry->rect = (msdfgl_packer_rect_t){0, 0, 0, 0};
+            entry->page = -1;
+            continue;
+        }
+        /* Glyphs in use must lie on the texture. */
+        if (e->state != MSDFGL_ENTRY_USED || e->page < 0 || e->page >= header->npages ||
+            e->rect[0] < 0 || e->rect[1] < 0 || e->rect[2] < 0 || e->rect[3] < 0 ||
+            (int64_t)e->rect[0] + e->rect[2] > header->texture_width ||
+            (int64_t)e->rect[1] + e->rect[3] > header->texture_height)
+            goto rollback;
+        entry->rect = (msdfgl_packer_rect_t){e->rect[0], e->rect[1], e->rect[2], e->rect[3]};
+        entry->page = e->page;
+    }
+    for (size_t i = 0; i < header->nfree; ++i) {
+        if (free_entries[i] < 0 || (size_t)free_entries[i] >= nglyphs)
+            goto rollback;
+        atlas->free_entries[atlas->nfree++] = free_entries[i];
     }
 
-    glDisableVertexAttribArray(0);
+    for (int i = 0; i < header->npacker_pages; ++i) {
+        msdfgl_packer_page_t page;
+        memset(&page, 0, sizeof(msdfgl_packer_page_t));
+        page.rects = (msdfgl_packer_rect_t *)_msdfgl_cache_section(
+            &file, pages[i].rects_offset, pages[i].nrects, sizeof(msdfgl_packer_rect_t));
+        if (!page.rects)
+            goto rollback;
+        page.nrects = (size_t)pages[i].nrects;
+        page.shelf_x = pages[i].shelf_x;
+        page.shelf_y = pages[i].shelf_y;
+        page.shelf_height = pages[i].shelf_height;
+        page.height = pages[i].height;
+        page.area = (size_t)pages[i].area;
+        if (msdfgl_packer_set_page(&atlas->packer, i, &page)) {
+            retval = -1;
+            goto rollback;
+        }
+    }
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    for (size_t i = 0; i < nfonts; ++i) {
+        for (int k = 0; k < 2; ++k) {
+            msdfgl_map_t *map = k ? &fonts[i]->glyph_index : &fonts[i]->character_index;
+            const msdfgl_cache_item *items = _msdfgl_cache_section(
+                &file, records[i].items_offset[k], records[i].nitems[k],
+                sizeof(msdfgl_cache_item));
+            if (!items)
+                goto rollback;
+            for (uint64_t j = 0; j < records[i].nitems[k]; ++j) {
+                if (items[j].index < 0 || (size_t)items[j].index >= nglyphs)
+                    goto rollback;
+                msdfgl_map_item_t *item = msdfgl_map_insert(map, items[j].code);
+                if (!item)
+                    goto rollback;
+                item->index = items[j].index;
+                item->advance[0] = items[j].advance[0];
+                item->advance[1] = items[j].advance[1];
+            }
+        }
+    }
 
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    /* Upload the index and the texture straight from the file. */
+    if (nglyphs) {
+        size_t index_size = 1;
+        while (index_size < nglyphs)
+            index_size *= 2;
+        if (_msdfgl_resize_atlas_index(atlas, (int)index_size)) {
+            retval = -1;
+            goto rollback;
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, atlas->index_buffer);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, nglyphs * sizeof(msdfgl_index_entry), index);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
 
-    glUseProgram(0);
+    if (texture_size) {
+        GLuint texture, framebuffer;
+        if (_msdfgl_create_atlas_texture(atlas, header->texture_height, header->npages,
+                                         &texture, &framebuffer)) {
+            retval = -1;
+            goto rollback;
+        }
+        GLenum client_format, type;
+        GLint alignment;
+        _msdfgl_texel_type(atlas->format, &client_format, &type);
+        glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, atlas->texture_width,
+                        header->texture_height, header->npages, client_format, type, pixels);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteTextures(1, &atlas->atlas_texture);
+        atlas->atlas_texture = texture;
+        glDeleteFramebuffers(1, &atlas->atlas_framebuffer);
+        atlas->atlas_framebuffer = framebuffer;
+        atlas->texture_height = header->texture_height;
+        atlas->npages = header->npages;
+        _msdfgl_ortho(-(GLfloat)atlas->texture_width, (GLfloat)atlas->texture_width,
+                      -(GLfloat)atlas->texture_height, (GLfloat)atlas->texture_height, -1.0,
+                      1.0, atlas->projection);
+    }
 
-    atlas->nglyphs += nrender;
-    retval = nrender;
+    atlas->nglyphs = nglyphs;
+    retval = 0;
 
+rollback:
+    if (retval)
+        _msdfgl_unload_atlas(atlas, fonts, nfonts);
 error:
-    if (meta_sizes)
-        free(meta_sizes);
-    if (point_sizes)
-        free(point_sizes);
-    if (atlas_index)
-        free(atlas_index);
-    if (point_data)
-        free(point_data);
-    if (metadata)
-        free(metadata);
-
-    glViewport(original_viewport[0], original_viewport[1], original_viewport[2], original_viewport[3]);
-
+    msdfgl_cache_close(&file);
     return retval;
 }
 
-int msdfgl_generate_glyphs(msdfgl_font_t font, int32_t start, int32_t end) {
-    return _msdfgl_generate_glyphs_internal(font, start, end + 1, 1, NULL, 0);
-}
-
-int msdfgl_generate_glyph(msdfgl_font_t font, int32_t character, void *_user) {
-    return _msdfgl_generate_glyphs_internal(font, character, character + 1, 1, NULL, 0);
-}
-
-int msdfgl_generate_glyph_list(msdfgl_font_t font, int32_t *list, size_t n) {
-    return _msdfgl_generate_glyphs_internal(font, 0, 0, 0, list, n);
-}
-
 void msdfgl_render(msdfgl_font_t font, msdfgl_glyph_t *glyphs, int n,
                    GLfloat *projection) {
 
+    if (_msdfgl_ensure_render(font->context))
+        return;
+
+    msdfgl_atlas_t atlas = font->atlas;
     for (int i = 0; i < n; ++i) {
-        /* If glyphs 0 - N were generated first, we can optimize by having their
-           indices be equal to their keys. */
-        if (glyphs[i].key >= font->_direct_lookup_upper_limit) {
-            msdfgl_map_item_t *e = msdfgl_map_get(&font->character_index, glyphs[i].key);
-            glyphs[i].key = e ? e->index : 0;
-        }
+        msdfgl_map_item_t *e = msdfgl_map_get(&font->character_index, glyphs[i].key);
+        glyphs[i].key = e ? e->index : 0;
+        if (e)
+            atlas->entries[e->index].last_use = atlas->frame;
     }
+    if (!atlas->explicit_frames)
+        atlas->frame++;
 
     GLuint glyph_buffer;
     GLuint vao;
@@ -848,7 +3045,7 @@ void msdfgl_render(msdfgl_font_t font, msdfgl_glyph_t *glyphs, int n,
 
     /* Bind atlas texture and index buffer. */
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, font->atlas->atlas_texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, font->atlas->atlas_texture);
     glUniform1i(font->context->_atlas_uniform, 0);
 
     glActiveTexture(GL_TEXTURE1);
@@ -872,7 +3069,7 @@ void msdfgl_render(msdfgl_font_t font, msdfgl_glyph_t *glyphs, int n,
     glBindTexture(GL_TEXTURE_BUFFER, 0);
 
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
 
     glUseProgram(0);
 
@@ -930,6 +3127,9 @@ msdfgl_map_item_t *msdfgl_map_get_or_add(msdfgl_font_t font, int32_t key) {
             return NULL;
         }
     }
+    /* About to be rendered, so not to be evicted by the generation of a later
+       glyph of the same text. */
+    font->atlas->entries[e->index].last_use = font->atlas->frame;
     return e;
 }
 
@@ -970,7 +3170,11 @@ void msdfgl_geometry(float *x, float *y, msdfgl_font_t font, float size,
         else
             key = (int32_t)((char *)s)[buf_idx++];
 
+        /* Glyphs which could not be generated, e.g. when a budgeted atlas is
+           full, take no space. */
         msdfgl_map_item_t *e = msdfgl_map_get_or_add(font, key);
+        if (!e)
+            continue;
 
         FT_Vector kerning = {0, 0};
 
@@ -1022,8 +3226,8 @@ float msdfgl_printf(float x, float y, msdfgl_font_t font, float size, int32_t co
         return x;
     }
 
-    size_t buf_idx = 0;
-    for (size_t i = 0; buf_idx < bufsize; ++i) {
+    size_t buf_idx = 0, i = 0;
+    while (buf_idx < bufsize) {
         glyphs[i].x = x;
         glyphs[i].y = y;
         glyphs[i].color = color;
@@ -1040,7 +3244,11 @@ float msdfgl_printf(float x, float y, msdfgl_font_t font, float size, int32_t co
         glyphs[i].skew = 0;
         glyphs[i].strength = 0.5;
 
+        /* Glyphs which could not be generated, e.g. when a budgeted atlas is
+           full, are left out. */
         msdfgl_map_item_t *e = msdfgl_map_get_or_add(font, glyphs[i].key);
+        if (!e)
+            continue;
 
         FT_Vector kerning = {0, 0};
         if (flags & MSDFGL_KERNING && i && FT_HAS_KERNING(font->face)) {
@@ -1059,8 +3267,9 @@ float msdfgl_printf(float x, float y, msdfgl_font_t font, float size, int32_t co
         else
             x += (e->advance[0] + kerning.x) * (size * font->context->dpi[0] / 72.0f) /
                  font->face->units_per_EM;
+        ++i;
     }
-    msdfgl_render(font, glyphs, bufsize, projection);
+    msdfgl_render(font, glyphs, (int)i, projection);
     free(glyphs);
     free(s);
 
@@ -1082,6 +3291,25 @@ float msdfgl_vertical_advance(msdfgl_font_t font, float size) {
 GLuint _msdfgl_atlas_texture(msdfgl_font_t font) { return font->atlas->atlas_texture; }
 GLuint _msdfgl_index_texture(msdfgl_font_t font) { return font->atlas->index_texture; }
 
+void msdfgl_set_worker_threads(msdfgl_context_t context, int nthreads) {
+    context->nthreads = nthreads > 0 ? nthreads : msdfgl_workers_default_count();
+}
+
+void msdfgl_set_generator(msdfgl_context_t context, enum msdfgl_generator generator) {
+    context->generator = generator;
+}
+
+void msdfgl_set_outline_tolerance(msdfgl_font_t font, float pixels) {
+    font->outline_tolerance = pixels > 0 ? pixels : 0;
+}
+
+void msdfgl_set_adaptive_scale(msdfgl_font_t font, float min_scale, float max_scale) {
+    if (min_scale <= 0 || max_scale < min_scale)
+        min_scale = max_scale = 0;
+    font->min_scale = min_scale;
+    font->max_scale = max_scale;
+}
+
 void msdfgl_set_dpi(msdfgl_context_t context, float horizontal, float vertical) {
     context->dpi[0] = horizontal;
     context->dpi[1] = vertical;
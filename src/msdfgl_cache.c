@@ -0,0 +1,153 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <process.h>
+#include <windows.h>
+#define MSDFGL_CACHE_READ
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "msdfgl_cache.h"
+
+#define HASH_PRIME 0x100000001b3ULL
+
+#ifdef MSDFGL_CACHE_READ
+int msdfgl_cache_open(msdfgl_cache_file_t *f, const char *path) {
+    memset(f, 0, sizeof(msdfgl_cache_file_t));
+
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return 1;
+
+    int retval = -1;
+    long size;
+    if (fseek(file, 0, SEEK_END) || (size = ftell(file)) < 0 || fseek(file, 0, SEEK_SET))
+        goto error;
+
+    uint8_t *data = malloc(size ? (size_t)size : 1);
+    if (!data)
+        goto error;
+    if (fread(data, 1, (size_t)size, file) != (size_t)size) {
+        free(data);
+        goto error;
+    }
+    f->data = data;
+    f->size = (size_t)size;
+    f->_allocated = 1;
+    retval = 0;
+
+error:
+    fclose(file);
+    return retval;
+}
+
+void msdfgl_cache_close(msdfgl_cache_file_t *f) {
+    if (f->data)
+        free((void *)f->data);
+    memset(f, 0, sizeof(msdfgl_cache_file_t));
+}
+#else
+int msdfgl_cache_open(msdfgl_cache_file_t *f, const char *path) {
+    memset(f, 0, sizeof(msdfgl_cache_file_t));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return 1;
+
+    struct stat st;
+    int retval = -1;
+    if (fstat(fd, &st))
+        goto error;
+
+    /* Empty files cannot be mapped, nor are they valid caches. */
+    if (st.st_size > 0) {
+        void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+            goto error;
+        f->data = data;
+        f->size = (size_t)st.st_size;
+    }
+    retval = 0;
+
+error:
+    close(fd);
+    return retval;
+}
+
+void msdfgl_cache_close(msdfgl_cache_file_t *f) {
+    if (f->_allocated)
+        free((void *)f->data);
+    else if (f->data)
+        munmap((void *)f->data, f->size);
+    memset(f, 0, sizeof(msdfgl_cache_file_t));
+}
+#endif
+
+FILE *msdfgl_cache_create(const char *path, char **tmp_path) {
+    if (!(*tmp_path = malloc(strlen(path) + 32)))
+        return NULL;
+
+    FILE *file = NULL;
+#if defined(_WIN32)
+    /* The process id tells processes apart, and the counter the threads. */
+    static volatile long counter;
+    sprintf(*tmp_path, "%s.%d.%ld.tmp", path, _getpid(), InterlockedIncrement(&counter));
+    file = fopen(*tmp_path, "wb");
+#else
+    sprintf(*tmp_path, "%s.XXXXXX", path);
+    int fd = mkstemp(*tmp_path);
+    if (fd >= 0 && !(file = fdopen(fd, "wb"))) {
+        close(fd);
+        remove(*tmp_path);
+    }
+#endif
+    if (!file) {
+        free(*tmp_path);
+        *tmp_path = NULL;
+    }
+    return file;
+}
+
+int msdfgl_cache_replace(const char *tmp_path, const char *path) {
+#if defined(_WIN32)
+    /* rename() does not replace existing files on Windows. */
+    return MoveFileExA(tmp_path, path, MOVEFILE_REPLACE_EXISTING) ? 0 : -1;
+#else
+    return rename(tmp_path, path) ? -1 : 0;
+#endif
+}
+
+uint64_t msdfgl_cache_hash(const void *data, size_t size, uint64_t seed) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint64_t h = seed ^ 0xcbf29ce484222325ULL;
+
+    /* FNV-1a on eight bytes at a time, with a shift to carry the high bits of
+       each step down to the low ones. */
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, &bytes[i], 8);
+        h = (h ^ word) * HASH_PRIME;
+        h ^= h >> 29;
+    }
+    for (; i < size; ++i)
+        h = (h ^ bytes[i]) * HASH_PRIME;
+    h ^= (uint64_t)size;
+    h *= HASH_PRIME;
+    return h ^ (h >> 32);
+}
+
+int msdfgl_cache_hash_file(const char *path, uint64_t *hash) {
+    msdfgl_cache_file_t f;
+    if (msdfgl_cache_open(&f, path))
+        return -1;
+    *hash = msdfgl_cache_hash(f.data, f.size, 0);
+    msdfgl_cache_close(&f);
+    return 0;
+}
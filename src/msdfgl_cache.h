@@ -0,0 +1,56 @@
+#ifndef MSDFGL_CACHE_H
+#define MSDFGL_CACHE_H
+
+/**
+ * Read-only access to atlas cache files and the hashes keying them.
+ *
+ * Files are memory mapped where the platform supports it, so that their
+ * contents can be handed to OpenGL without copying them first, and read into
+ * memory elsewhere.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef struct _msdfgl_cache_file {
+    const uint8_t *data;
+    size_t size;
+
+    /* Set if `data` was read into memory instead of mapped. */
+    int _allocated;
+} msdfgl_cache_file_t;
+
+/**
+ * Map the file at `path`. Returns 0 on success, 1 if it cannot be opened and
+ * -1 if it could not be read.
+ */
+int msdfgl_cache_open(msdfgl_cache_file_t *f, const char *path);
+
+void msdfgl_cache_close(msdfgl_cache_file_t *f);
+
+/**
+ * Create a file of a unique name next to `path`, to be written and renamed
+ * over it, so that processes writing the same file at once do not write into
+ * each other's. Returns the file opened for writing, and its name in
+ * `*tmp_path` to be freed, or NULL.
+ */
+FILE *msdfgl_cache_create(const char *path, char **tmp_path);
+
+/**
+ * Move the file written at `tmp_path` over `path`, replacing the file there
+ * at once for processes which open it. Returns 0 on success.
+ */
+int msdfgl_cache_replace(const char *tmp_path, const char *path);
+
+/**
+ * 64-bit hash of `size` bytes, continuing from `seed`.
+ */
+uint64_t msdfgl_cache_hash(const void *data, size_t size, uint64_t seed);
+
+/**
+ * Hash of the contents of the file at `path`. Returns 0 on success.
+ */
+int msdfgl_cache_hash_file(const char *path, uint64_t *hash);
+
+#endif /* MSDFGL_CACHE_H */
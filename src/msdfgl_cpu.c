@@ -0,0 +1,833 @@
+#include <float.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef MSDFGL_THREADS
+#include <pthread.h>
+#endif
+
+#include "msdfgl_cpu.h"
+#include "msdfgl_serializer.h"
+
+/* The vector kernels are built for x86 with GCC and Clang, which can target
+   single functions at instruction sets, and chosen at run time. */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MSDFGL_CPU_X86
+#include <immintrin.h>
+#endif
+
+/*
+ * The functions below follow msdf_generator.glsl line by line, in the same
+ * order of operations, so that the generators differ only as much as the
+ * float arithmetic of the CPU and the GPU do. Changes to one belong in the
+ * other, and changes to the distance functions in msdfgl_cpu_kernel.h too.
+ */
+
+#define IDX_CURR 0
+#define IDX_SHAPE 1
+#define IDX_INNER 2
+#define IDX_OUTER 3
+#define IDX_NEGATIVE 0
+#define IDX_POSITIVE 1
+#define IDX_MAX_INNER 0
+#define IDX_MIN_OUTER 1
+
+#define PI 3.1415926535897932384626433832795f
+/* The shader has no infinities, its INFINITY is the largest float. */
+#define FAR FLT_MAX
+#define CUBIC_SEARCH_STARTS 4
+#define CUBIC_SEARCH_STEPS 4
+
+typedef struct vec2 {
+    float x;
+    float y;
+} vec2;
+
+typedef struct vec3 {
+    float x;
+    float y;
+    float z;
+} vec3;
+
+static inline vec2 add(vec2 a, vec2 b) {return (vec2){a.x + b.x, a.y + b.y};}
+static inline vec2 subt(vec2 a, vec2 b) {return (vec2){a.x - b.x, a.y - b.y};}
+static inline vec2 scale(vec2 v, float f) {return (vec2){v.x * f, v.y * f};}
+static inline vec2 neg(vec2 v) {return (vec2){-v.x, -v.y};}
+static inline float dot(vec2 a, vec2 b) {return a.x * b.x + a.y * b.y;}
+static inline float cross(vec2 a, vec2 b) {return a.x * b.y - a.y * b.x;}
+static inline float length(vec2 v) {return sqrtf(v.x * v.x + v.y * v.y);}
+static inline vec2 normalize(vec2 v) {float len = length(v); return (vec2){v.x / len, v.y / len};}
+static inline vec2 orthonormal(vec2 v) {float len = length(v); return (vec2){v.y / len, -v.x / len};}
+/* Points on the line of a segment take a side, as in msdfgen. */
+static inline float non_zero_sign(float f) {return f > 0.0f ? 1.0f : -1.0f;}
+static inline vec2 xy(vec3 v) {return (vec2){v.x, v.y};}
+
+static inline vec2 mix(vec2 a, vec2 b, float t) {
+    return (vec2){a.x * (1.0f - t) + b.x * t, a.y * (1.0f - t) + b.y * t};
+}
+
+static inline float median(vec3 d) {
+    return fmaxf(fminf(d.x, d.y), fminf(fmaxf(d.x, d.y), d.z));
+}
+
+static inline bool less(vec2 a, vec2 b) {
+    return fabsf(a.x) < fabsf(b.x) || (fabsf(a.x) == fabsf(b.x) && a.y < b.y);
+}
+
+typedef struct __segment {
+    vec3 min_true;
+    vec2 mins[2];
+    int nearest;
+} __segment;
+
+/**
+ * The glyph being generated and the workspace of the pixel, `ws` of the
+ * shader.
+ */
+typedef struct __generator {
+    const uint32_t *meta;
+    const int16_t *points;
+    const float *segments;
+    bool single_channel;
+
+    /* Distances of the pixel from the segments listed in its cell, in list
+       order and `lanes` apart, if a vector kernel evaluated them. */
+    const vec3 *distances;
+    int lanes;
+
+    __segment segments_ws[4 * 3];
+    vec3 extremes[2];
+    vec3 nearest_contours[4];
+} __generator;
+
+static inline float __meta_float(const __generator *g, int i) {
+    float f;
+    memcpy(&f, &g->meta[i], sizeof(float));
+    return f;
+}
+
+static inline const float *__segment_at(const __generator *g, int e, int i) {
+    return &g->segments[SERIALIZER_SEGMENT_SIZE * e + 4 * i];
+}
+
+static inline vec2 __point_at(const __generator *g, int i) {
+    return (vec2){g->points[2 * i] / SERIALIZER_SCALE, g->points[2 * i + 1] / SERIALIZER_SCALE};
+}
+
+static vec3 __signed_distance_linear(vec2 p0, vec2 p1, vec2 origin) {
+    vec2 aq = subt(origin, p0);
+    vec2 ab = subt(p1, p0);
+    float param = dot(aq, ab) / dot(ab, ab);
+    vec2 eq = subt(param > 0.5f ? p1 : p0, origin);
+    float endpoint_distance = length(eq);
+    if (param > 0.0f && param < 1.0f) {
+        float ortho_distance = dot(orthonormal(ab), aq);
+        if (fabsf(ortho_distance) < endpoint_distance)
+            return (vec3){ortho_distance, 0.0f, param};
+    }
+    return (vec3){non_zero_sign(cross(aq, ab)) * endpoint_distance,
+                  fabsf(dot(normalize(ab), normalize(eq))), param};
+}
+
+static vec3 __signed_distance_quad(vec2 p0, vec2 p1, vec2 p2, vec2 origin) {
+    vec2 qa = subt(p0, origin);
+    vec2 ab = subt(p1, p0);
+    vec2 br = subt(subt(p2, p1), ab);
+    float a = dot(br, br);
+    float b = 3.0f * dot(ab, br);
+    float c = 2.0f * dot(ab, ab) + dot(qa, br);
+    float d = dot(qa, ab);
+    float coeffs[3];
+    float _a = b / a;
+    int solutions;
+
+    float a2 = _a * _a;
+    float q = (a2 - 3.0f * (c / a)) / 9.0f;
+    float r = (_a * (2.0f * a2 - 9.0f * (c / a)) + 27.0f * (d / a)) / 54.0f;
+    float r2 = r * r;
+    float q3 = q * q * q;
+    float A, B;
+    _a /= 3.0f;
+    float t = r / sqrtf(q3);
+    t = t < -1.0f ? -1.0f : t;
+    t = t > 1.0f ? 1.0f : t;
+    t = acosf(t);
+    A = -powf(fabsf(r) + sqrtf(r2 - q3), 1.0f / 3.0f);
+    A = r < 0.0f ? -A : A;
+    B = A == 0.0f ? 0.0f : q / A;
+    if (r2 < q3) {
+        q = -2.0f * sqrtf(q);
+        coeffs[0] = q * cosf(t / 3.0f) - _a;
+        coeffs[1] = q * cosf((t + 2.0f * PI) / 3.0f) - _a;
+        coeffs[2] = q * cosf((t - 2.0f * PI) / 3.0f) - _a;
+        solutions = 3;
+    } else {
+        coeffs[0] = (A + B) - _a;
+        coeffs[1] = -0.5f * (A + B) - _a;
+        coeffs[2] = 0.5f * sqrtf(3.0f) * (A - B);
+        solutions = fabsf(coeffs[2]) < 1.0e-14f ? 2 : 1;
+    }
+
+    float min_distance = non_zero_sign(cross(ab, qa)) * length(qa); /* distance from A */
+    float param = -dot(qa, ab) / dot(ab, ab);
+    vec2 p2_origin = subt(p2, origin);
+    /* distance from B */
+    float distance = non_zero_sign(cross(subt(p2, p1), p2_origin)) * length(p2_origin);
+    if (fabsf(distance) < fabsf(min_distance)) {
+        min_distance = distance;
+        param = dot(subt(origin, p1), subt(p2, p1)) / dot(subt(p2, p1), subt(p2, p1));
+    }
+    for (int i = 0; i < solutions; ++i) {
+        if (coeffs[i] > 0.0f && coeffs[i] < 1.0f) {
+            vec2 endpoint = add(add(p0, scale(scale(ab, 2.0f), coeffs[i])),
+                                scale(scale(br, coeffs[i]), coeffs[i]));
+            vec2 endpoint_origin = subt(endpoint, origin);
+            distance =
+                non_zero_sign(cross(subt(p2, p0), endpoint_origin)) * length(endpoint_origin);
+            if (fabsf(distance) <= fabsf(min_distance)) {
+                min_distance = distance;
+                param = coeffs[i];
+            }
+        }
+    }
+    vec3 v = {min_distance, 0.0f, param};
+    v.y = param > 1.0f ? fabsf(dot(normalize(subt(p2, p1)), normalize(p2_origin))) : v.y;
+    v.y = param < 0.0f ? fabsf(dot(normalize(ab), normalize(qa))) : v.y;
+
+    return v;
+}
+
+static inline vec2 __cubic_direction(vec2 p0, vec2 p1, vec2 p2, vec2 p3, float t) {
+    return mix(mix(subt(p1, p0), subt(p2, p1), t), mix(subt(p2, p1), subt(p3, p2), t), t);
+}
+
+static vec3 __signed_distance_cubic(vec2 p0, vec2 p1, vec2 p2, vec2 p3, vec2 origin) {
+    vec2 qa = subt(p0, origin);
+    vec2 ab = subt(p1, p0);
+    vec2 br = subt(subt(p2, p1), ab);
+    vec2 as = subt(subt(subt(p3, p2), subt(p2, p1)), br);
+
+    /* End point directions, skipping a control point on top of its end point. */
+    vec2 start_dir = p1.x != p0.x || p1.y != p0.y ? subt(p1, p0) : subt(p2, p0);
+    vec2 end_dir = p3.x != p2.x || p3.y != p2.y ? subt(p3, p2) : subt(p3, p1);
+
+    float min_distance = non_zero_sign(cross(start_dir, qa)) * length(qa); /* distance from A */
+    float param = -dot(qa, start_dir) / dot(start_dir, start_dir);
+
+    vec2 p3_origin = subt(p3, origin);
+    /* distance from B */
+    float distance = non_zero_sign(cross(end_dir, p3_origin)) * length(p3_origin);
+    if (fabsf(distance) < fabsf(min_distance)) {
+        min_distance = distance;
+        param = dot(subt(add(origin, end_dir), p3), end_dir) / dot(end_dir, end_dir);
+    }
+
+    /* Iterative minimum distance search, Newton's method from a few starting points. */
+    for (int i = 0; i <= CUBIC_SEARCH_STARTS; ++i) {
+        float t = (float)i / (float)CUBIC_SEARCH_STARTS;
+        vec2 qe = add(add(add(qa, scale(ab, 3.0f * t)), scale(br, 3.0f * t * t)),
+                      scale(as, t * t * t));
+        for (int step = 0; step < CUBIC_SEARCH_STEPS; ++step) {
+            vec2 d1 = add(add(scale(ab, 3.0f), scale(br, 6.0f * t)), scale(as, 3.0f * t * t));
+            vec2 d2 = add(scale(br, 6.0f), scale(as, 6.0f * t));
+            t -= dot(qe, d1) / (dot(d1, d1) + dot(qe, d2));
+            if (t <= 0.0f || t >= 1.0f)
+                break;
+            qe = add(add(add(qa, scale(ab, 3.0f * t)), scale(br, 3.0f * t * t)),
+                     scale(as, t * t * t));
+            distance = non_zero_sign(cross(__cubic_direction(p0, p1, p2, p3, t), qe)) * length(qe);
+            if (fabsf(distance) < fabsf(min_distance)) {
+                min_distance = distance;
+                param = t;
+            }
+        }
+    }
+
+    vec3 v = {min_distance, 0.0f, param};
+    v.y = param > 1.0f ? fabsf(dot(normalize(end_dir), normalize(p3_origin))) : v.y;
+    v.y = param < 0.0f ? fabsf(dot(normalize(start_dir), normalize(qa))) : v.y;
+
+    return v;
+}
+
+static vec2 __distance_to_pseudo_distance(const __generator *g, int e, vec3 d, vec2 p) {
+    if (d.z >= 0.0f && d.z <= 1.0f)
+        return xy(d);
+
+    const float *info = __segment_at(g, e, 0);
+    const float *dirs = __segment_at(g, e, 1);
+    int points = (int)info[0];
+    int npoints = (int)info[1];
+
+    vec2 dir = d.z < 0.0f ? (vec2){dirs[0], dirs[1]} : (vec2){dirs[2], dirs[3]};
+    vec2 aq = subt(p, __point_at(g, d.z < 0.0f ? points : points + npoints - 1));
+    float ts = dot(aq, dir);
+    if (d.z < 0.0f ? ts < 0.0f : ts > 0.0f) {
+        float pseudo_distance = cross(aq, dir);
+        if (fabsf(pseudo_distance) <= fabsf(d.x)) {
+            d.x = pseudo_distance;
+            d.y = 0.0f;
+        }
+    }
+    return xy(d);
+}
+
+static bool __point_facing_edge(const __generator *g, int e, int points, int npoints, vec2 p,
+                                float param) {
+    if (param >= 0.0f && param <= 1.0f)
+        return true;
+
+    /* Directions at the segment's ends, and those of its neighbours at the
+       shared end points. */
+    const float *dirs = __segment_at(g, e, 1);
+    const float *neighbour_dirs = __segment_at(g, e, 2);
+
+    vec2 prev_edge_dir = {-neighbour_dirs[0], -neighbour_dirs[1]};
+    vec2 edge_dir = param < 0.0f ? (vec2){dirs[0], dirs[1]} : neg((vec2){dirs[2], dirs[3]});
+    vec2 next_edge_dir = {neighbour_dirs[2], neighbour_dirs[3]};
+    vec2 point_dir = subt(p, __point_at(g, param < 0.0f ? points : points + npoints - 1));
+    return dot(point_dir, edge_dir) >=
+           dot(point_dir, param < 0.0f ? prev_edge_dir : next_edge_dir);
+}
+
+static void __add_segment_true_distance(__generator *g, int segment_index, int e, vec3 d) {
+    __segment *s = &g->segments_ws[segment_index];
+    if (less(xy(d), xy(s->min_true))) {
+        s->min_true = d;
+        s->nearest = e;
+    }
+}
+
+static void __add_segment_pseudo_distance(__generator *g, int segment_index, vec2 d) {
+    vec2 *min = &g->segments_ws[segment_index].mins[d.x < 0.0f ? IDX_NEGATIVE : IDX_POSITIVE];
+    *min = less(d, *min) ? d : *min;
+}
+
+static vec3 __segment_distance(const __generator *g, int e, vec2 point) {
+    const float *info = __segment_at(g, e, 0);
+    int cur_points = (int)info[0];
+    int cur_npoints = (int)info[1];
+
+    if (cur_npoints == 2)
+        return __signed_distance_linear(__point_at(g, cur_points),
+                                        __point_at(g, cur_points + 1), point);
+    if (cur_npoints == 3)
+        return __signed_distance_quad(__point_at(g, cur_points), __point_at(g, cur_points + 1),
+                                      __point_at(g, cur_points + 2), point);
+    return __signed_distance_cubic(__point_at(g, cur_points), __point_at(g, cur_points + 1),
+                                   __point_at(g, cur_points + 2), __point_at(g, cur_points + 3),
+                                   point);
+}
+
+/* Add the distance d of the point from the segment, and return its magnitude. */
+static float __add_segment(__generator *g, int e, vec3 d, vec2 point) {
+    const float *info = __segment_at(g, e, 0);
+    int cur_points = (int)info[0];
+    int cur_npoints = (int)info[1];
+    unsigned int s_color = (unsigned int)info[2];
+
+    for (int c = 0; c < 3; ++c) {
+        if (s_color & (1u << c))
+            __add_segment_true_distance(g, IDX_CURR * 3 + c, e, d);
+    }
+
+    if (!g->single_channel &&
+        __point_facing_edge(g, e, cur_points, cur_npoints, point, d.z)) {
+        vec2 pd = __distance_to_pseudo_distance(g, e, d, point);
+        for (int c = 0; c < 3; ++c) {
+            if (s_color & (1u << c))
+                __add_segment_pseudo_distance(g, IDX_CURR * 3 + c, pd);
+        }
+    }
+    return fabsf(d.x);
+}
+
+static float __compute_distance(const __generator *g, int segment_index, vec2 point) {
+    const __segment *s = &g->segments_ws[segment_index];
+    if (g->single_channel)
+        return s->min_true.x;
+
+    float min_distance = s->mins[s->min_true.x < 0.0f ? IDX_NEGATIVE : IDX_POSITIVE].x;
+
+    if (s->nearest == -1)
+        return min_distance;
+    vec2 d = __distance_to_pseudo_distance(g, s->nearest, s->min_true, point);
+    return fabsf(d.x) < fabsf(min_distance) ? d.x : min_distance;
+}
+
+static vec3 __get_distance(const __generator *g, int segment_index, vec2 point) {
+    return (vec3){__compute_distance(g, segment_index * 3 + 0, point),
+                  __compute_distance(g, segment_index * 3 + 1, point),
+                  __compute_distance(g, segment_index * 3 + 2, point)};
+}
+
+static void __merge_segment(__generator *g, int s, int other) {
+    __segment *a = &g->segments_ws[s];
+    const __segment *b = &g->segments_ws[other];
+    if (less(xy(b->min_true), xy(a->min_true))) {
+        a->min_true = b->min_true;
+        a->nearest = b->nearest;
+    }
+    if (less(b->mins[IDX_NEGATIVE], a->mins[IDX_NEGATIVE]))
+        a->mins[IDX_NEGATIVE] = b->mins[IDX_NEGATIVE];
+    if (less(b->mins[IDX_POSITIVE], a->mins[IDX_POSITIVE]))
+        a->mins[IDX_POSITIVE] = b->mins[IDX_POSITIVE];
+}
+
+static void __merge_multi_segment(__generator *g, int e, int other) {
+    for (int c = 0; c < 3; ++c)
+        __merge_segment(g, e * 3 + c, other * 3 + c);
+}
+
+static void __reset_segment(__generator *g, int s) {
+    memset(&g->segments_ws[s], 0, sizeof(__segment));
+    g->segments_ws[s].mins[IDX_NEGATIVE].x = -FAR;
+    g->segments_ws[s].mins[IDX_POSITIVE].x = -FAR;
+    g->segments_ws[s].min_true.x = -FAR;
+    g->segments_ws[s].nearest = -1;
+}
+
+static void __set_contour_edge(__generator *g, int winding, vec2 point) {
+    vec3 d = __get_distance(g, IDX_CURR, point);
+
+    __merge_multi_segment(g, IDX_SHAPE, IDX_CURR);
+    if (winding > 0 && median(d) >= 0.0f)
+        __merge_multi_segment(g, IDX_INNER, IDX_CURR);
+    if (winding < 0 && median(d) <= 0.0f)
+        __merge_multi_segment(g, IDX_OUTER, IDX_CURR);
+
+    if (winding > 0 && median(d) > median(g->extremes[IDX_MAX_INNER]))
+        g->extremes[IDX_MAX_INNER] = d;
+    if (winding < 0 && median(d) < median(g->extremes[IDX_MIN_OUTER]))
+        g->extremes[IDX_MIN_OUTER] = d;
+
+    int i = (median(d) < 0.0f ? IDX_NEGATIVE : IDX_POSITIVE) + (winding > 0 ? 2 : 0);
+    if (fabsf(median(d)) < fabsf(median(g->nearest_contours[i])))
+        g->nearest_contours[i] = d;
+
+    for (int c = 0; c < 3; ++c)
+        __reset_segment(g, IDX_CURR * 3 + c);
+}
+
+static void __set_far_contour(__generator *g, int winding, float far, vec2 point) {
+    float d = winding > 0 ? far : -far;
+    for (int i = IDX_CURR * 3; i < IDX_CURR * 3 + 3; ++i) {
+        g->segments_ws[i].min_true = (vec3){d, 0.0f, 0.5f};
+        g->segments_ws[i].mins[winding > 0 ? IDX_POSITIVE : IDX_NEGATIVE] = (vec2){d, 0.0f};
+    }
+    __set_contour_edge(g, winding, point);
+}
+
+static vec3 __get_pixel_distance(const __generator *g, vec2 point) {
+    vec3 shape_distance = __get_distance(g, IDX_SHAPE, point);
+    vec3 inner_distance = __get_distance(g, IDX_INNER, point);
+    vec3 outer_distance = __get_distance(g, IDX_OUTER, point);
+    float inner_d = median(inner_distance);
+    float outer_d = median(outer_distance);
+
+    bool inner = inner_d >= 0.0f && fabsf(inner_d) <= fabsf(outer_d);
+    bool outer = outer_d <= 0.0f && fabsf(outer_d) < fabsf(inner_d);
+    if (!inner && !outer)
+        return shape_distance;
+
+    vec3 d = inner ? inner_distance : outer_distance;
+    vec3 contour_distance = g->extremes[inner ? IDX_MAX_INNER : IDX_MIN_OUTER];
+    float contour_d = median(contour_distance);
+    if (inner && fabsf(contour_d) < fabsf(outer_d) && contour_d > median(d))
+        d = contour_distance;
+    if (outer && fabsf(contour_d) < fabsf(inner_d) && contour_d < median(d))
+        d = contour_distance;
+
+    contour_distance =
+        g->nearest_contours[(median(d) < 0.0f ? IDX_NEGATIVE : IDX_POSITIVE) + (inner ? 0 : 2)];
+    d = fabsf(median(contour_distance)) < fabsf(median(d)) ? contour_distance : d;
+    d = median(d) == median(shape_distance) ? shape_distance : d;
+
+    return d;
+}
+
+/* Column (axis 1) or row (axis 2) of the grid cell of a pixel at coordinate
+   v, see msdfgl_serializer.h. Pixels on the border may fall just outside of
+   the grid. */
+static int __cell(const __generator *g, float v, int axis) {
+    int n = (int)g->meta[0];
+    float f = floorf((v - __meta_float(g, axis)) / __meta_float(g, axis + 2));
+    return f > 0.0f ? (f < (float)(n - 1) ? (int)f : n - 1) : 0;
+}
+
+/* Multi-channel signed distance of the point p from the glyph. */
+static vec3 __msdf_distance(__generator *g, vec2 p) {
+    g->extremes[IDX_MAX_INNER] = (vec3){-FAR, -FAR, -FAR};
+    g->extremes[IDX_MIN_OUTER] = (vec3){FAR, FAR, FAR};
+    for (int i = 0; i < 4; ++i)
+        g->nearest_contours[i] = (vec3){-FAR, -FAR, -FAR};
+
+    for (int i = 0; i < 4 * 3; ++i)
+        __reset_segment(g, i);
+
+    int n = (int)g->meta[0];
+    vec2 origin = {__meta_float(g, 1), __meta_float(g, 2)};
+    vec2 cell_size = {__meta_float(g, 3), __meta_float(g, 4)};
+    float reach = __meta_float(g, 5);
+
+    int cx = __cell(g, p.x, 1);
+    int cy = __cell(g, p.y, 2);
+    vec2 cell_min = add(origin, (vec2){(float)cx * cell_size.x, (float)cy * cell_size.y});
+    vec2 outside = {fmaxf(fmaxf(cell_min.x - p.x, p.x - cell_min.x - cell_size.x), 0.0f),
+                    fmaxf(fmaxf(cell_min.y - p.y, p.y - cell_min.y - cell_size.y), 0.0f)};
+
+    int cell_index = SERIALIZER_GRID_HEADER + 2 * (cy * n + cx);
+    int list = (int)g->meta[cell_index];
+    uint32_t cell_info = g->meta[cell_index + 1];
+    int nsegments = (int)(cell_info >> 3);
+
+    /* The listed segments are in table order, so contours follow each other. */
+    int contour = -1;
+    int winding = 0;
+    float nearest = FAR;
+    for (int i = 0; i < nsegments; ++i) {
+        int e = (int)g->meta[list + i];
+        int header = (int)__segment_at(g, e, 0)[3];
+
+        if (header >> 1 != contour) {
+            if (contour >= 0)
+                __set_contour_edge(g, winding, p);
+            contour = header >> 1;
+            winding = (header & 1) != 0 ? 1 : -1;
+        }
+        vec3 d = g->distances ? g->distances[i * g->lanes] : __segment_distance(g, e, p);
+        nearest = fminf(nearest, __add_segment(g, e, d, p));
+    }
+    if (contour >= 0)
+        __set_contour_edge(g, winding, p);
+
+    float far = reach - length(outside);
+    uint32_t around = (cell_info >> 1) & 3u;
+    if (nearest > far) {
+        far = (cell_info & 1u) != 0u ? far : -far;
+        return (vec3){far, far, far};
+    }
+    if (around != 0u)
+        __set_far_contour(g, around == 1u ? 1 : -1, far, p);
+    vec3 d = __get_pixel_distance(g, p);
+    return (vec3){fminf(fmaxf(d.x, -far), far), fminf(fmaxf(d.y, -far), far),
+                  fminf(fmaxf(d.z, -far), far)};
+}
+
+/* Round to the nearest half float, ties to even. */
+static uint16_t __half(float f) {
+    uint32_t x;
+    memcpy(&x, &f, sizeof(float));
+    uint32_t sign = (x >> 16) & 0x8000u;
+    uint32_t abs = x & 0x7fffffffu;
+
+    if (abs >= 0x7f800000u)
+        return (uint16_t)(sign | 0x7c00u | (abs > 0x7f800000u ? 0x200u : 0u));
+    /* Halfway between the largest half and the next power of two and up. */
+    if (abs >= 0x477ff000u)
+        return (uint16_t)(sign | 0x7c00u);
+
+    uint32_t h, rest, halfway;
+    if (abs < 0x38800000u) {
+        /* Subnormal halves, in units of 2^-24. */
+        int shift = 126 - (int)(abs >> 23);
+        if (shift > 24)
+            return (uint16_t)sign;
+        uint32_t mantissa = (abs & 0x7fffffu) | 0x800000u;
+        h = mantissa >> shift;
+        rest = mantissa & ((1u << shift) - 1);
+        halfway = 1u << (shift - 1);
+    } else {
+        h = (abs - 0x38000000u) >> 13;
+        rest = abs & 0x1fffu;
+        halfway = 0x1000u;
+    }
+    if (rest > halfway || (rest == halfway && (h & 1)))
+        ++h;
+    return (uint16_t)(sign | h);
+}
+
+static uint32_t __unorm(float f, float max) {
+    f = fminf(fmaxf(f, 0.0f), 1.0f);
+    return (uint32_t)(f * max + 0.5f);
+}
+
+/* Store the color the shaders write, vec4(d / range + 0.5, 1.0). */
+static void __store(enum msdfgl_cpu_format format, vec3 c, void *texel) {
+    switch (format) {
+    case MSDFGL_CPU_RGBA16F: {
+        uint16_t v[4] = {__half(c.x), __half(c.y), __half(c.z), 0x3c00u};
+        memcpy(texel, v, sizeof(v));
+        break;
+    }
+    case MSDFGL_CPU_RGB10_A2: {
+        uint32_t v = __unorm(c.x, 1023.0f) | __unorm(c.y, 1023.0f) << 10 |
+                     __unorm(c.z, 1023.0f) << 20 | 3u << 30;
+        memcpy(texel, &v, sizeof(v));
+        break;
+    }
+    case MSDFGL_CPU_RGBA8: {
+        uint8_t *v = (uint8_t *)texel;
+        v[0] = (uint8_t)__unorm(c.x, 255.0f);
+        v[1] = (uint8_t)__unorm(c.y, 255.0f);
+        v[2] = (uint8_t)__unorm(c.z, 255.0f);
+        v[3] = 255;
+        break;
+    }
+    case MSDFGL_CPU_R16F: {
+        uint16_t v = __half(c.x);
+        memcpy(texel, &v, sizeof(v));
+        break;
+    }
+    case MSDFGL_CPU_R8:
+        *(uint8_t *)texel = (uint8_t)__unorm(c.x, 255.0f);
+        break;
+    case MSDFGL_CPU_RGBA32F:
+    default: {
+        float v[4] = {c.x, c.y, c.z, 1.0f};
+        memcpy(texel, v, sizeof(v));
+        break;
+    }
+    }
+}
+
+size_t msdfgl_cpu_texel_size(enum msdfgl_cpu_format format) {
+    switch (format) {
+    case MSDFGL_CPU_RGBA32F:
+        return 4 * sizeof(float);
+    case MSDFGL_CPU_RGBA16F:
+        return 4 * sizeof(uint16_t);
+    case MSDFGL_CPU_RGB10_A2:
+        return sizeof(uint32_t);
+    case MSDFGL_CPU_RGBA8:
+        return 4;
+    case MSDFGL_CPU_R16F:
+        return sizeof(uint16_t);
+    case MSDFGL_CPU_R8:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+#ifdef MSDFGL_CPU_X86
+#define KERNEL_LANES 4
+#define KERNEL_TARGET "sse2"
+#define KERNEL_SQRT(v) _mm_sqrt_ps(v)
+#define KERNEL(name) __##name##_sse2
+#include "msdfgl_cpu_kernel.h"
+#undef KERNEL
+#undef KERNEL_SQRT
+#undef KERNEL_TARGET
+#undef KERNEL_LANES
+
+#define KERNEL_LANES 8
+#define KERNEL_TARGET "avx2"
+#define KERNEL_SQRT(v) _mm256_sqrt_ps(v)
+#define KERNEL(name) __##name##_avx2
+#include "msdfgl_cpu_kernel.h"
+#undef KERNEL
+#undef KERNEL_SQRT
+#undef KERNEL_TARGET
+#undef KERNEL_LANES
+#endif
+
+#define MAX_LANES 8
+
+/* Evaluates the distances of the segments of a cell from a run of pixels in
+   a row, see msdfgl_cpu_kernel.h. */
+typedef void (*__kernel_function)(const __generator *g, const uint32_t *list, int nsegments,
+                                  const float *px, float py, vec3 *distances);
+
+typedef struct __kernel {
+    __kernel_function distances;
+    int lanes;
+} __kernel;
+
+static __kernel __kernel_for(enum msdfgl_cpu_kernel kernel) {
+    switch (kernel) {
+#ifdef MSDFGL_CPU_X86
+    case MSDFGL_CPU_SSE2:
+        return (__kernel){__distances_sse2, 4};
+    case MSDFGL_CPU_AVX2:
+        return (__kernel){__distances_avx2, 8};
+#endif
+    default:
+        return (__kernel){NULL, 1};
+    }
+}
+
+/* Distances evaluated by a kernel, kept by a thread from glyph to glyph. */
+typedef struct __scratch {
+    vec3 *distances;
+    size_t alloc;
+} __scratch;
+
+static vec3 *__scratch_distances(__scratch *scratch, size_t n) {
+    if (n > scratch->alloc) {
+        vec3 *distances = (vec3 *)realloc(scratch->distances, n * sizeof(vec3));
+        if (!distances)
+            return NULL;
+        scratch->distances = distances;
+        scratch->alloc = n;
+    }
+    return scratch->distances;
+}
+
+static void __generate_glyph(msdfgl_cpu_glyph_t *glyph, float range,
+                             enum msdfgl_cpu_format format, __kernel kernel,
+                             __scratch *scratch) {
+    __generator g;
+    g.meta = glyph->meta;
+    g.points = glyph->points;
+    g.segments = glyph->segments;
+    g.single_channel = format == MSDFGL_CPU_R8 || format == MSDFGL_CPU_R16F;
+    g.distances = NULL;
+    g.lanes = kernel.lanes;
+
+    size_t texel_size = msdfgl_cpu_texel_size(format);
+    uint8_t *texel = (uint8_t *)glyph->bitmap;
+    int n = (int)g.meta[0];
+
+    /* The pixels are sampled at the same points as in msdf_fragment.glsl,
+       whose fragments have their coordinates at the pixel centers. */
+    for (int y = 0; y < glyph->height; ++y) {
+        float py = (glyph->size[1] / glyph->scale) -
+                   ((((float)y + 0.5f) + 0.49f) / glyph->scale + glyph->translate[1]);
+        int cy = __cell(&g, py, 2);
+        for (int x = 0; x < glyph->width;) {
+            /* A run of pixels in the same cell, as many as the kernel takes,
+               and without a kernel a single pixel. The lanes past the run
+               repeat its last pixel. */
+            float px[MAX_LANES];
+            int count = 0, cx = 0;
+            for (; count < kernel.lanes && x + count < glyph->width; ++count) {
+                px[count] =
+                    (((float)(x + count) + 0.5f) + 0.49f) / glyph->scale - glyph->translate[0];
+                int c = __cell(&g, px[count], 1);
+                if (count > 0 && c != cx)
+                    break;
+                cx = c;
+            }
+            for (int i = count; i < kernel.lanes; ++i)
+                px[i] = px[count - 1];
+
+            vec3 *distances = NULL;
+            if (kernel.distances) {
+                int cell_index = SERIALIZER_GRID_HEADER + 2 * (cy * n + cx);
+                int nsegments = (int)(g.meta[cell_index + 1] >> 3);
+                distances = __scratch_distances(scratch, (size_t)nsegments * kernel.lanes);
+                if (distances)
+                    kernel.distances(&g, &g.meta[g.meta[cell_index]], nsegments, px, py,
+                                     distances);
+            }
+
+            for (int i = 0; i < count; ++i) {
+                g.distances = distances ? &distances[i] : NULL;
+                vec3 d = __msdf_distance(&g, (vec2){px[i], py});
+                __store(format,
+                        (vec3){d.x / range + 0.5f, d.y / range + 0.5f, d.z / range + 0.5f},
+                        texel);
+                texel += texel_size;
+            }
+            x += count;
+        }
+    }
+}
+
+typedef struct __batch {
+    msdfgl_cpu_glyph_t *glyphs;
+    int n;
+    float range;
+    enum msdfgl_cpu_format format;
+    __kernel kernel;
+
+    /* Next glyph to hand out. */
+    int next;
+#ifdef MSDFGL_THREADS
+    pthread_mutex_t lock;
+    int locked;
+#endif
+} __batch;
+
+static void *__run(void *user) {
+    __batch *batch = (__batch *)user;
+    __scratch scratch = {NULL, 0};
+    for (;;) {
+#ifdef MSDFGL_THREADS
+        if (batch->locked)
+            pthread_mutex_lock(&batch->lock);
+#endif
+        int i = batch->next < batch->n ? batch->next++ : -1;
+#ifdef MSDFGL_THREADS
+        if (batch->locked)
+            pthread_mutex_unlock(&batch->lock);
+#endif
+        if (i < 0)
+            break;
+        __generate_glyph(&batch->glyphs[i], batch->range, batch->format, batch->kernel,
+                         &scratch);
+    }
+    free(scratch.distances);
+    return NULL;
+}
+
+enum msdfgl_cpu_kernel msdfgl_cpu_best_kernel(void) {
+#ifdef MSDFGL_CPU_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return MSDFGL_CPU_AVX2;
+    if (__builtin_cpu_supports("sse2"))
+        return MSDFGL_CPU_SSE2;
+#endif
+    return MSDFGL_CPU_SCALAR;
+}
+
+int msdfgl_cpu_generate(msdfgl_cpu_glyph_t *glyphs, int n, float range,
+                        enum msdfgl_cpu_format format, enum msdfgl_cpu_kernel kernel,
+                        int nthreads) {
+    /* Each kernel needs the instruction sets of those before it. */
+    if (kernel > msdfgl_cpu_best_kernel())
+        return -1;
+
+    __batch batch;
+    batch.glyphs = glyphs;
+    batch.n = n;
+    batch.range = range;
+    batch.format = format;
+    batch.kernel = __kernel_for(kernel);
+    batch.next = 0;
+
+#ifdef MSDFGL_THREADS
+    /* The calling thread takes part, and takes over from threads which
+       could not be started. */
+    pthread_t *threads = NULL;
+    int nstarted = 0;
+    nthreads = nthreads < n ? nthreads : n;
+    if (nthreads > 1 && !(threads = (pthread_t *)malloc((nthreads - 1) * sizeof(pthread_t))))
+        nthreads = 1;
+    batch.locked = nthreads > 1 && !pthread_mutex_init(&batch.lock, NULL);
+    for (int i = 1; batch.locked && i < nthreads; ++i) {
+        if (pthread_create(&threads[nstarted], NULL, __run, &batch))
+            break;
+        ++nstarted;
+    }
+#else
+    (void)nthreads;
+#endif
+
+    __run(&batch);
+
+#ifdef MSDFGL_THREADS
+    for (int i = 0; i < nstarted; ++i)
+        pthread_join(threads[i], NULL);
+    if (batch.locked)
+        pthread_mutex_destroy(&batch.lock);
+    if (threads)
+        free(threads);
+#endif
+    return 0;
+}
@@ -0,0 +1,92 @@
+#ifndef MSDFGL_CPU_H
+#define MSDFGL_CPU_H
+
+/**
+ * Generation on the CPU.
+ *
+ * The distances are computed by a port of msdf_generator.glsl, from the same
+ * serialized data the shaders read, see msdfgl_serializer.h. Glyphs are
+ * shared out to threads one at a time, and the bitmaps are written in the
+ * texel layout of an atlas format, ready for glTexSubImage3D. Nothing here
+ * takes or calls into OpenGL, so glyphs can be generated without a context,
+ * from any thread.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Texel layouts of the bitmaps, one per atlas format. Channels are in RGBA
+ * order, and alpha is always 1.
+ */
+enum msdfgl_cpu_format {
+    /* Four floats. */
+    MSDFGL_CPU_RGBA32F,
+    /* Four half floats. */
+    MSDFGL_CPU_RGBA16F,
+    /* A 32-bit word, red in its lowest 10 bits and alpha in its highest 2. */
+    MSDFGL_CPU_RGB10_A2,
+    /* Four bytes. */
+    MSDFGL_CPU_RGBA8,
+    /* The median of a single-channel field, as a half float. */
+    MSDFGL_CPU_R16F,
+    /* The median of a single-channel field, as a byte. */
+    MSDFGL_CPU_R8,
+};
+
+/**
+ * Ways of evaluating the distances. The vector kernels evaluate the distance
+ * of each segment from the 4 or 8 pixels of a row which share a cell of the
+ * grid at once, with the same operations in the same order as the scalar
+ * path, so that all of them write the same bits.
+ */
+enum msdfgl_cpu_kernel {
+    MSDFGL_CPU_SCALAR,
+    MSDFGL_CPU_SSE2,
+    MSDFGL_CPU_AVX2,
+};
+
+typedef struct _msdfgl_cpu_glyph {
+    /**
+     * Serialized data of the glyph, from the start of its metadata, points
+     * and segment table entries.
+     */
+    const uint32_t *meta;
+    const int16_t *points;
+    const float *segments;
+
+    /**
+     * Area and translation of the outline, as in msdfgl_gen_instance.
+     */
+    float size[2];
+    float translate[2];
+    float scale;
+
+    /**
+     * Bitmap of `width` by `height` texels, the bottom row first.
+     */
+    int width;
+    int height;
+    void *bitmap;
+} msdfgl_cpu_glyph_t;
+
+/**
+ * Bytes per texel of the bitmaps in `format`.
+ */
+size_t msdfgl_cpu_texel_size(enum msdfgl_cpu_format format);
+
+/**
+ * The widest kernel this processor runs.
+ */
+enum msdfgl_cpu_kernel msdfgl_cpu_best_kernel(void);
+
+/**
+ * Generate the bitmaps of `n` glyphs in `format` with `kernel`, using up to
+ * `nthreads` threads. Returns 0 on success and -1 if the processor cannot run
+ * the kernel.
+ */
+int msdfgl_cpu_generate(msdfgl_cpu_glyph_t *glyphs, int n, float range,
+                        enum msdfgl_cpu_format format, enum msdfgl_cpu_kernel kernel,
+                        int nthreads);
+
+#endif /* MSDFGL_CPU_H */
@@ -0,0 +1,316 @@
+/*
+ * Vector kernels of the CPU generator, which evaluate the distance of a
+ * segment from KERNEL_LANES pixels at once. msdfgl_cpu.c includes this once
+ * per instruction set, after the scalar functions, with
+ *
+ *     KERNEL_LANES     pixels per vector, 4 or 8
+ *     KERNEL_TARGET    the target attribute of the functions
+ *     KERNEL_SQRT(v)   the square root of a vector
+ *     KERNEL(name)     a name for this instruction set
+ *
+ * defined. Each function is the vector form of its scalar counterpart, with
+ * the same operations in the same order, which IEEE 754 rounds the same in
+ * every lane. Branches become selects, which leave lanes whose pixels take
+ * the other side as they are. The C library has no vector form of the
+ * transcendental functions, so they are called lane by lane, and only for
+ * the lanes that use them.
+ */
+
+#define vfloat KERNEL(vfloat)
+#define vmask KERNEL(vmask)
+#define vvec2 KERNEL(vvec2)
+#define vvec3 KERNEL(vvec3)
+#define KERNEL_FUNCTION static inline __attribute__((target(KERNEL_TARGET)))
+
+typedef float vfloat __attribute__((vector_size(4 * KERNEL_LANES)));
+typedef int32_t vmask __attribute__((vector_size(4 * KERNEL_LANES)));
+
+typedef struct vvec2 {
+    vfloat x;
+    vfloat y;
+} vvec2;
+
+typedef struct vvec3 {
+    vfloat x;
+    vfloat y;
+    vfloat z;
+} vvec3;
+
+KERNEL_FUNCTION vfloat KERNEL(splat)(float f) {
+    vfloat v = {0};
+    for (int i = 0; i < KERNEL_LANES; ++i)
+        v[i] = f;
+    return v;
+}
+
+KERNEL_FUNCTION vvec2 KERNEL(splat2)(vec2 v) {
+    return (vvec2){KERNEL(splat)(v.x), KERNEL(splat)(v.y)};
+}
+
+KERNEL_FUNCTION vfloat KERNEL(select)(vmask m, vfloat a, vfloat b) {
+    return (vfloat)((m & (vmask)a) | (~m & (vmask)b));
+}
+
+KERNEL_FUNCTION vvec2 KERNEL(select2)(vmask m, vvec2 a, vvec2 b) {
+    return (vvec2){KERNEL(select)(m, a.x, b.x), KERNEL(select)(m, a.y, b.y)};
+}
+
+KERNEL_FUNCTION int KERNEL(any)(vmask m) {
+    for (int i = 0; i < KERNEL_LANES; ++i) {
+        if (m[i])
+            return 1;
+    }
+    return 0;
+}
+
+KERNEL_FUNCTION vfloat KERNEL(abs)(vfloat v) {return (vfloat)((vmask)v & 0x7fffffff);}
+KERNEL_FUNCTION vvec2 KERNEL(add)(vvec2 a, vvec2 b) {return (vvec2){a.x + b.x, a.y + b.y};}
+KERNEL_FUNCTION vvec2 KERNEL(subt)(vvec2 a, vvec2 b) {return (vvec2){a.x - b.x, a.y - b.y};}
+KERNEL_FUNCTION vvec2 KERNEL(scale)(vvec2 v, vfloat f) {return (vvec2){v.x * f, v.y * f};}
+KERNEL_FUNCTION vfloat KERNEL(dot)(vvec2 a, vvec2 b) {return a.x * b.x + a.y * b.y;}
+KERNEL_FUNCTION vfloat KERNEL(cross)(vvec2 a, vvec2 b) {return a.x * b.y - a.y * b.x;}
+KERNEL_FUNCTION vfloat KERNEL(length)(vvec2 v) {return KERNEL_SQRT(v.x * v.x + v.y * v.y);}
+
+KERNEL_FUNCTION vvec2 KERNEL(normalize)(vvec2 v) {
+    vfloat len = KERNEL(length)(v);
+    return (vvec2){v.x / len, v.y / len};
+}
+
+KERNEL_FUNCTION vvec2 KERNEL(orthonormal)(vvec2 v) {
+    vfloat len = KERNEL(length)(v);
+    return (vvec2){v.y / len, -v.x / len};
+}
+
+KERNEL_FUNCTION vfloat KERNEL(non_zero_sign)(vfloat f) {
+    return KERNEL(select)(f > 0.0f, KERNEL(splat)(1.0f), KERNEL(splat)(-1.0f));
+}
+
+KERNEL_FUNCTION vvec2 KERNEL(mix)(vvec2 a, vvec2 b, vfloat t) {
+    return (vvec2){a.x * (1.0f - t) + b.x * t, a.y * (1.0f - t) + b.y * t};
+}
+
+KERNEL_FUNCTION vvec3 KERNEL(signed_distance_linear)(vec2 _p0, vec2 _p1, vvec2 origin) {
+    vvec2 p0 = KERNEL(splat2)(_p0), p1 = KERNEL(splat2)(_p1);
+    vvec2 aq = KERNEL(subt)(origin, p0);
+    vvec2 ab = KERNEL(subt)(p1, p0);
+    vfloat param = KERNEL(dot)(aq, ab) / KERNEL(dot)(ab, ab);
+    vvec2 eq = KERNEL(subt)(KERNEL(select2)(param > 0.5f, p1, p0), origin);
+    vfloat endpoint_distance = KERNEL(length)(eq);
+    vfloat ortho_distance = KERNEL(dot)(KERNEL(orthonormal)(ab), aq);
+    vmask ortho = (param > 0.0f) & (param < 1.0f) &
+                  (KERNEL(abs)(ortho_distance) < endpoint_distance);
+
+    vvec3 v;
+    v.x = KERNEL(select)(ortho, ortho_distance,
+                         KERNEL(non_zero_sign)(KERNEL(cross)(aq, ab)) * endpoint_distance);
+    v.y = KERNEL(select)(
+        ortho, KERNEL(splat)(0.0f),
+        KERNEL(abs)(KERNEL(dot)(KERNEL(normalize)(ab), KERNEL(normalize)(eq))));
+    v.z = param;
+    return v;
+}
+
+KERNEL_FUNCTION vvec3 KERNEL(signed_distance_quad)(vec2 _p0, vec2 _p1, vec2 _p2,
+                                                   vvec2 origin) {
+    vvec2 p0 = KERNEL(splat2)(_p0), p1 = KERNEL(splat2)(_p1), p2 = KERNEL(splat2)(_p2);
+    vvec2 qa = KERNEL(subt)(p0, origin);
+    vvec2 ab = KERNEL(subt)(p1, p0);
+    vvec2 br = KERNEL(subt)(KERNEL(subt)(p2, p1), ab);
+    vfloat a = KERNEL(dot)(br, br);
+    vfloat b = 3.0f * KERNEL(dot)(ab, br);
+    vfloat c = 2.0f * KERNEL(dot)(ab, ab) + KERNEL(dot)(qa, br);
+    vfloat d = KERNEL(dot)(qa, ab);
+    vfloat coeffs[3];
+    vfloat _a = b / a;
+
+    vfloat a2 = _a * _a;
+    vfloat q = (a2 - 3.0f * (c / a)) / 9.0f;
+    vfloat r = (_a * (2.0f * a2 - 9.0f * (c / a)) + 27.0f * (d / a)) / 54.0f;
+    vfloat r2 = r * r;
+    vfloat q3 = q * q * q;
+    _a /= 3.0f;
+    vfloat t = r / KERNEL_SQRT(q3);
+    t = KERNEL(select)(t < -1.0f, KERNEL(splat)(-1.0f), t);
+    t = KERNEL(select)(t > 1.0f, KERNEL(splat)(1.0f), t);
+
+    /* Three roots, from the cosines of the angle, or one or two, from A. */
+    vmask three = r2 < q3;
+    vfloat A = KERNEL(abs)(r) + KERNEL_SQRT(r2 - q3);
+    vfloat cos0 = {0}, cos1 = {0}, cos2 = {0};
+    for (int i = 0; i < KERNEL_LANES; ++i) {
+        if (three[i]) {
+            float angle = acosf(t[i]);
+            cos0[i] = cosf(angle / 3.0f);
+            cos1[i] = cosf((angle + 2.0f * PI) / 3.0f);
+            cos2[i] = cosf((angle - 2.0f * PI) / 3.0f);
+            A[i] = 0.0f;
+        } else {
+            A[i] = -powf(A[i], 1.0f / 3.0f);
+        }
+    }
+    A = KERNEL(select)(r < 0.0f, -A, A);
+    vfloat B = KERNEL(select)(A == 0.0f, KERNEL(splat)(0.0f), q / A);
+    q = -2.0f * KERNEL_SQRT(q);
+    coeffs[0] = KERNEL(select)(three, q * cos0 - _a, (A + B) - _a);
+    coeffs[1] = KERNEL(select)(three, q * cos1 - _a, -0.5f * (A + B) - _a);
+    coeffs[2] = KERNEL(select)(three, q * cos2 - _a, 0.5f * sqrtf(3.0f) * (A - B));
+    vmask solutions[3];
+    solutions[0] = three | ~three;
+    solutions[1] = three | (KERNEL(abs)(coeffs[2]) < 1.0e-14f);
+    solutions[2] = three;
+
+    vfloat min_distance =
+        KERNEL(non_zero_sign)(KERNEL(cross)(ab, qa)) * KERNEL(length)(qa); /* distance from A */
+    vfloat param = -KERNEL(dot)(qa, ab) / KERNEL(dot)(ab, ab);
+    vvec2 p2_origin = KERNEL(subt)(p2, origin);
+    /* distance from B */
+    vfloat distance = KERNEL(non_zero_sign)(KERNEL(cross)(KERNEL(subt)(p2, p1), p2_origin)) *
+                      KERNEL(length)(p2_origin);
+    vmask nearer = KERNEL(abs)(distance) < KERNEL(abs)(min_distance);
+    min_distance = KERNEL(select)(nearer, distance, min_distance);
+    param = KERNEL(select)(nearer,
+                           KERNEL(dot)(KERNEL(subt)(origin, p1), KERNEL(subt)(p2, p1)) /
+                               KERNEL(dot)(KERNEL(subt)(p2, p1), KERNEL(subt)(p2, p1)),
+                           param);
+    for (int i = 0; i < 3; ++i) {
+        vvec2 endpoint = KERNEL(add)(
+            KERNEL(add)(p0, KERNEL(scale)(KERNEL(scale)(ab, KERNEL(splat)(2.0f)), coeffs[i])),
+            KERNEL(scale)(KERNEL(scale)(br, coeffs[i]), coeffs[i]));
+        vvec2 endpoint_origin = KERNEL(subt)(endpoint, origin);
+        distance = KERNEL(non_zero_sign)(KERNEL(cross)(KERNEL(subt)(p2, p0), endpoint_origin)) *
+                   KERNEL(length)(endpoint_origin);
+        nearer = solutions[i] & (coeffs[i] > 0.0f) & (coeffs[i] < 1.0f) &
+                 (KERNEL(abs)(distance) <= KERNEL(abs)(min_distance));
+        min_distance = KERNEL(select)(nearer, distance, min_distance);
+        param = KERNEL(select)(nearer, coeffs[i], param);
+    }
+    vvec3 v = {min_distance, KERNEL(splat)(0.0f), param};
+    v.y = KERNEL(select)(param > 1.0f,
+                         KERNEL(abs)(KERNEL(dot)(KERNEL(normalize)(KERNEL(subt)(p2, p1)),
+                                                 KERNEL(normalize)(p2_origin))),
+                         v.y);
+    v.y = KERNEL(select)(
+        param < 0.0f,
+        KERNEL(abs)(KERNEL(dot)(KERNEL(normalize)(ab), KERNEL(normalize)(qa))), v.y);
+
+    return v;
+}
+
+KERNEL_FUNCTION vvec2 KERNEL(cubic_direction)(vvec2 p0, vvec2 p1, vvec2 p2, vvec2 p3,
+                                              vfloat t) {
+    return KERNEL(mix)(KERNEL(mix)(KERNEL(subt)(p1, p0), KERNEL(subt)(p2, p1), t),
+                       KERNEL(mix)(KERNEL(subt)(p2, p1), KERNEL(subt)(p3, p2), t), t);
+}
+
+KERNEL_FUNCTION vvec3 KERNEL(signed_distance_cubic)(vec2 _p0, vec2 _p1, vec2 _p2, vec2 _p3,
+                                                    vvec2 origin) {
+    vvec2 p0 = KERNEL(splat2)(_p0), p1 = KERNEL(splat2)(_p1);
+    vvec2 p2 = KERNEL(splat2)(_p2), p3 = KERNEL(splat2)(_p3);
+    vvec2 qa = KERNEL(subt)(p0, origin);
+    vvec2 ab = KERNEL(subt)(p1, p0);
+    vvec2 br = KERNEL(subt)(KERNEL(subt)(p2, p1), ab);
+    vvec2 as = KERNEL(subt)(KERNEL(subt)(KERNEL(subt)(p3, p2), KERNEL(subt)(p2, p1)), br);
+
+    /* End point directions, skipping a control point on top of its end point. */
+    vvec2 start_dir = KERNEL(splat2)(_p1.x != _p0.x || _p1.y != _p0.y ? subt(_p1, _p0)
+                                                                      : subt(_p2, _p0));
+    vvec2 end_dir = KERNEL(splat2)(_p3.x != _p2.x || _p3.y != _p2.y ? subt(_p3, _p2)
+                                                                    : subt(_p3, _p1));
+
+    vfloat min_distance = KERNEL(non_zero_sign)(KERNEL(cross)(start_dir, qa)) *
+                          KERNEL(length)(qa); /* distance from A */
+    vfloat param = -KERNEL(dot)(qa, start_dir) / KERNEL(dot)(start_dir, start_dir);
+
+    vvec2 p3_origin = KERNEL(subt)(p3, origin);
+    /* distance from B */
+    vfloat distance =
+        KERNEL(non_zero_sign)(KERNEL(cross)(end_dir, p3_origin)) * KERNEL(length)(p3_origin);
+    vmask nearer = KERNEL(abs)(distance) < KERNEL(abs)(min_distance);
+    min_distance = KERNEL(select)(nearer, distance, min_distance);
+    param = KERNEL(select)(
+        nearer,
+        KERNEL(dot)(KERNEL(subt)(KERNEL(add)(origin, end_dir), p3), end_dir) /
+            KERNEL(dot)(end_dir, end_dir),
+        param);
+
+    /* Iterative minimum distance search, Newton's method from a few starting
+       points. A lane stops where the scalar search breaks out. */
+    for (int i = 0; i <= CUBIC_SEARCH_STARTS; ++i) {
+        vfloat t = KERNEL(splat)((float)i / (float)CUBIC_SEARCH_STARTS);
+        vvec2 qe = KERNEL(add)(
+            KERNEL(add)(KERNEL(add)(qa, KERNEL(scale)(ab, 3.0f * t)),
+                        KERNEL(scale)(br, 3.0f * t * t)),
+            KERNEL(scale)(as, t * t * t));
+        vmask searching = (vmask){0} == 0;
+        for (int step = 0; step < CUBIC_SEARCH_STEPS; ++step) {
+            vvec2 d1 = KERNEL(add)(KERNEL(add)(KERNEL(scale)(ab, KERNEL(splat)(3.0f)),
+                                               KERNEL(scale)(br, 6.0f * t)),
+                                   KERNEL(scale)(as, 3.0f * t * t));
+            vvec2 d2 = KERNEL(add)(KERNEL(scale)(br, KERNEL(splat)(6.0f)),
+                                   KERNEL(scale)(as, 6.0f * t));
+            t -= KERNEL(dot)(qe, d1) / (KERNEL(dot)(d1, d1) + KERNEL(dot)(qe, d2));
+            searching &= ~((t <= 0.0f) | (t >= 1.0f));
+            if (!KERNEL(any)(searching))
+                break;
+            qe = KERNEL(add)(KERNEL(add)(KERNEL(add)(qa, KERNEL(scale)(ab, 3.0f * t)),
+                                         KERNEL(scale)(br, 3.0f * t * t)),
+                             KERNEL(scale)(as, t * t * t));
+            distance = KERNEL(non_zero_sign)(
+                           KERNEL(cross)(KERNEL(cubic_direction)(p0, p1, p2, p3, t), qe)) *
+                       KERNEL(length)(qe);
+            nearer = searching & (KERNEL(abs)(distance) < KERNEL(abs)(min_distance));
+            min_distance = KERNEL(select)(nearer, distance, min_distance);
+            param = KERNEL(select)(nearer, t, param);
+        }
+    }
+
+    vvec3 v = {min_distance, KERNEL(splat)(0.0f), param};
+    v.y = KERNEL(select)(param > 1.0f,
+                         KERNEL(abs)(KERNEL(dot)(KERNEL(normalize)(end_dir),
+                                                 KERNEL(normalize)(p3_origin))),
+                         v.y);
+    v.y = KERNEL(select)(param < 0.0f,
+                         KERNEL(abs)(KERNEL(dot)(KERNEL(normalize)(start_dir),
+                                                 KERNEL(normalize)(qa))),
+                         v.y);
+
+    return v;
+}
+
+/* Distances of the `nsegments` segments of `list` from the pixels at
+   (px[i], py), into distances[KERNEL_LANES * segment + i]. */
+static __attribute__((target(KERNEL_TARGET))) void
+KERNEL(distances)(const __generator *g, const uint32_t *list, int nsegments, const float *px,
+                  float py, vec3 *distances) {
+    vvec2 origin = {KERNEL(splat)(0.0f), KERNEL(splat)(py)};
+    for (int i = 0; i < KERNEL_LANES; ++i)
+        origin.x[i] = px[i];
+
+    for (int i = 0; i < nsegments; ++i) {
+        const float *info = __segment_at(g, (int)list[i], 0);
+        int points = (int)info[0];
+        int npoints = (int)info[1];
+
+        vvec3 d;
+        if (npoints == 2)
+            d = KERNEL(signed_distance_linear)(__point_at(g, points),
+                                               __point_at(g, points + 1), origin);
+        else if (npoints == 3)
+            d = KERNEL(signed_distance_quad)(__point_at(g, points), __point_at(g, points + 1),
+                                             __point_at(g, points + 2), origin);
+        else
+            d = KERNEL(signed_distance_cubic)(__point_at(g, points), __point_at(g, points + 1),
+                                              __point_at(g, points + 2),
+                                              __point_at(g, points + 3), origin);
+
+        vec3 *out = &distances[KERNEL_LANES * i];
+        for (int j = 0; j < KERNEL_LANES; ++j)
+            out[j] = (vec3){d.x[j], d.y[j], d.z[j]};
+    }
+}
+
+#undef KERNEL_FUNCTION
+#undef vvec3
+#undef vvec2
+#undef vmask
+#undef vfloat
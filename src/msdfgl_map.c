@@ -2,30 +2,33 @@
 
 
 void msdfgl_map_init(msdfgl_map_t *map) {
-    map->dynamic_map = NULL;
-    map->dynamic_size = 0;
-    map->dynamic_alloc = 0;
-
-    for (int i = 0; i < MSDFGL_MAP_LINEAR_SIZE; ++i)
-        map->linear_map[i].index = -1;
+    for (int i = 0; i < MSDFGL_MAP_NPAGES; ++i)
+        map->pages[i] = NULL;
 }
 
-int __cmp(const void *a, const void *b) {
-    return ((msdfgl_map_item_t *)a)->code - ((msdfgl_map_item_t *)b)->code;
+static msdfgl_map_item_t *__page_alloc(msdfgl_map_t *map, FT_ULong code) {
+    msdfgl_map_item_t **page = &map->pages[code >> MSDFGL_MAP_PAGE_BITS];
+    if (*page)
+        return *page;
+
+    if (!(*page = malloc(MSDFGL_MAP_PAGE_SIZE * sizeof(msdfgl_map_item_t))))
+        return NULL;
+
+    for (int i = 0; i < MSDFGL_MAP_PAGE_SIZE; ++i)
+        (*page)[i].index = -1;
+    return *page;
 }
 
 msdfgl_map_item_t *msdfgl_map_get(msdfgl_map_t *map, FT_ULong code) {
-    if (code < MSDFGL_MAP_LINEAR_SIZE)
-        return map->linear_map[code].index != -1 ? &map->linear_map[code] : NULL;
+    if (code >= MSDFGL_MAP_CODE_LIMIT)
+        return NULL;
 
-    if (!map->dynamic_map)
+    msdfgl_map_item_t *page = map->pages[code >> MSDFGL_MAP_PAGE_BITS];
+    if (!page)
         return NULL;
 
-    msdfgl_map_item_t i;
-    i.code = code;
-    
-    return bsearch(&i, map->dynamic_map, map->dynamic_size, sizeof(msdfgl_map_item_t),
-                   __cmp);
+    msdfgl_map_item_t *item = &page[code & (MSDFGL_MAP_PAGE_SIZE - 1)];
+    return item->index != -1 ? item : NULL;
 }
 
 int msdfgl_map_in(msdfgl_map_t *map, FT_ULong code) {
@@ -33,44 +36,60 @@ int msdfgl_map_in(msdfgl_map_t *map, FT_ULong code) {
 }
 
 msdfgl_map_item_t *msdfgl_map_insert(msdfgl_map_t *map, FT_ULong code) {
-    if (code < MSDFGL_MAP_LINEAR_SIZE) {
-        map->linear_map[code].code = code;
-        return &map->linear_map[code];
-    }
+    if (code >= MSDFGL_MAP_CODE_LIMIT)
+        return NULL;
 
-    /* Reallocate a new array if there is no space left */
-    if (map->dynamic_size + 1 > map->dynamic_alloc) {
-        int new_size = map->dynamic_alloc ? (map->dynamic_alloc * 2)
-                                          : MSDFGL_MAP_DYNAMIC_INITIAL_SIZE;
+    msdfgl_map_item_t *page = __page_alloc(map, code);
+    if (!page)
+        return NULL;
 
-        msdfgl_map_item_t *new = calloc(new_size, sizeof(msdfgl_map_item_t));
-        if (!new)
-            return NULL;
+    msdfgl_map_item_t *item = &page[code & (MSDFGL_MAP_PAGE_SIZE - 1)];
+    item->code = code;
+    return item;
+}
 
-        if (map->dynamic_map) {
-            memcpy(new, map->dynamic_map, map->dynamic_size);
-            free(map->dynamic_map);
-        }
-        map->dynamic_map = new;
-        map->dynamic_alloc = new_size;
+int msdfgl_map_insert_list(msdfgl_map_t *map, const int32_t *codes, size_t n,
+                           msdfgl_map_item_t **items) {
+    for (size_t i = 0; i < n; ++i) {
+        if (codes[i] < 0 || !(items[i] = msdfgl_map_insert(map, (FT_ULong)codes[i])))
+            return -1;
     }
-    int i = 0;
-    while (i < map->dynamic_size && map->dynamic_map[i].code < code) ++i;
-    
-    /* Shift the end of the array */
-    if (i != map->dynamic_size)
-        memmove(&map->dynamic_map[i + 1], &map->dynamic_map[i],
-                (map->dynamic_size - i) * sizeof(msdfgl_map_item_t));
-    
-    /* Place in the new item. */
-    map->dynamic_map[i].code = code;
-    ++map->dynamic_size;
-    return &map->dynamic_map[i];
+    return 0;
 }
 
-void msdfgl_map_destroy(msdfgl_map_t *map) {
-    if (map->dynamic_map)
-        free(map->dynamic_map);
+msdfgl_map_item_t *msdfgl_map_next(msdfgl_map_t *map, const msdfgl_map_item_t *item) {
+    FT_ULong code = item ? item->code + 1 : 0;
+    while (code < MSDFGL_MAP_CODE_LIMIT) {
+        msdfgl_map_item_t *page = map->pages[code >> MSDFGL_MAP_PAGE_BITS];
+        if (!page) {
+            code = ((code >> MSDFGL_MAP_PAGE_BITS) + 1) << MSDFGL_MAP_PAGE_BITS;
+            continue;
+        }
+        msdfgl_map_item_t *next = &page[code & (MSDFGL_MAP_PAGE_SIZE - 1)];
+        if (next->index != -1)
+            return next;
+        ++code;
+    }
+    return NULL;
 }
 
+void msdfgl_map_remove_indices(msdfgl_map_t *map, const uint8_t *removed, size_t n) {
+    for (int i = 0; i < MSDFGL_MAP_NPAGES; ++i) {
+        msdfgl_map_item_t *page = map->pages[i];
+        if (!page)
+            continue;
+        for (int j = 0; j < MSDFGL_MAP_PAGE_SIZE; ++j) {
+            int index = page[j].index;
+            if (index >= 0 && (size_t)index < n && removed[index])
+                page[j].index = -1;
+        }
+    }
+}
 
+void msdfgl_map_destroy(msdfgl_map_t *map) {
+    for (int i = 0; i < MSDFGL_MAP_NPAGES; ++i) {
+        if (map->pages[i])
+            free(map->pages[i]);
+        map->pages[i] = NULL;
+    }
+}
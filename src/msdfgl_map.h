@@ -2,18 +2,23 @@
 #define MSDFGL_MAP_H
 
 /**
- * A simple mapping container for glyph metadata.
+ * A two-level lookup table for glyph metadata.
  *
- * Items from 0 to 255 are stored statically, others are allocated dynamically.
+ * The Unicode code space is split into pages of MSDFGL_MAP_PAGE_SIZE items.
+ * Pages are allocated when the first item on them is inserted, so both lookups
+ * and inserts are constant-time regardless of how many glyphs are stored.
  */
 
+#include <stdint.h>
 #include <stdlib.h>
 
 #include <ft2build.h>
 #include FT_FREETYPE_H
 
-#define MSDFGL_MAP_LINEAR_SIZE 256
-#define MSDFGL_MAP_DYNAMIC_INITIAL_SIZE 256
+#define MSDFGL_MAP_PAGE_BITS 8
+#define MSDFGL_MAP_PAGE_SIZE (1 << MSDFGL_MAP_PAGE_BITS)
+#define MSDFGL_MAP_CODE_LIMIT 0x110000
+#define MSDFGL_MAP_NPAGES (MSDFGL_MAP_CODE_LIMIT >> MSDFGL_MAP_PAGE_BITS)
 
 typedef struct _msdfgl_map_item {
     FT_ULong code;
@@ -22,11 +27,7 @@ typedef struct _msdfgl_map_item {
 } msdfgl_map_item_t;
 
 typedef struct _msdfgl_map {
-    msdfgl_map_item_t linear_map[MSDFGL_MAP_LINEAR_SIZE];
-    msdfgl_map_item_t *dynamic_map;
-
-    int dynamic_size;
-    int dynamic_alloc;
+    msdfgl_map_item_t *pages[MSDFGL_MAP_NPAGES];
 } msdfgl_map_t;
 
 void msdfgl_map_init(msdfgl_map_t *map);
@@ -35,8 +36,30 @@ msdfgl_map_item_t *msdfgl_map_get(msdfgl_map_t *map, FT_ULong code);
 
 int msdfgl_map_in(msdfgl_map_t *map, FT_ULong code);
 
+/**
+ * Returns the slot for `code`. The item is not visible to `msdfgl_map_get`
+ * until the caller sets its index.
+ */
 msdfgl_map_item_t *msdfgl_map_insert(msdfgl_map_t *map, FT_ULong code);
 
+/**
+ * Insert a batch of codes at once, storing the slot of codes[i] to items[i].
+ * Returns 0 on success and -1 if a code is out of range or allocation failed.
+ */
+int msdfgl_map_insert_list(msdfgl_map_t *map, const int32_t *codes, size_t n,
+                           msdfgl_map_item_t **items);
+
+/**
+ * The item after `item` in code order, or the first one if `item` is NULL.
+ * Returns NULL past the last item.
+ */
+msdfgl_map_item_t *msdfgl_map_next(msdfgl_map_t *map, const msdfgl_map_item_t *item);
+
+/**
+ * Remove every item whose index `i` is below `n` and has `removed[i]` set.
+ */
+void msdfgl_map_remove_indices(msdfgl_map_t *map, const uint8_t *removed, size_t n);
+
 void msdfgl_map_destroy(msdfgl_map_t *map);
 
 #endif /* MSDFGL_MAP_H */
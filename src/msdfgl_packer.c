@@ -0,0 +1,439 @@
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "msdfgl_packer.h"
+
+/**
+ * Height of the pages of a packer without a height limit.
+ */
+#define PACKER_OPEN (INT_MAX / 2)
+
+/**
+ * Extents of the area padded bitmaps may cover. The padding of the last
+ * bitmap may hang over the right and bottom edges.
+ */
+static int __right(const msdfgl_packer_t *p) {
+    return p->width + p->padding;
+}
+
+static int __bottom(const msdfgl_packer_t *p) {
+    return p->page_height ? p->page_height + p->padding : PACKER_OPEN;
+}
+
+static int __reserve(msdfgl_packer_page_t *p, size_t n) {
+    if (n <= p->nallocated)
+        return 0;
+
+    size_t nallocated = p->nallocated ? p->nallocated * 2 : 16;
+    while (nallocated < n)
+        nallocated *= 2;
+
+    msdfgl_packer_rect_t *rects = realloc(p->rects, nallocated * sizeof(msdfgl_packer_rect_t));
+    if (!rects)
+        return -1;
+    p->rects = rects;
+    p->nallocated = nallocated;
+    return 0;
+}
+
+static int __insert_rect(msdfgl_packer_page_t *p, size_t i, msdfgl_packer_rect_t r) {
+    if (__reserve(p, p->nrects + 1))
+        return -1;
+    memmove(&p->rects[i + 1], &p->rects[i], (p->nrects - i) * sizeof(msdfgl_packer_rect_t));
+    p->rects[i] = r;
+    p->nrects++;
+    return 0;
+}
+
+static void __remove_rect(msdfgl_packer_page_t *p, size_t i) {
+    memmove(&p->rects[i], &p->rects[i + 1], (p->nrects - i - 1) * sizeof(msdfgl_packer_rect_t));
+    p->nrects--;
+}
+
+static int __shelf_insert(const msdfgl_packer_t *p, msdfgl_packer_page_t *page, int width,
+                          int height, int *x, int *y) {
+    int shelf_x = page->shelf_x, shelf_y = page->shelf_y, shelf_height = page->shelf_height;
+    if (shelf_x + width > __right(p)) {
+        shelf_x = 1;
+        shelf_y += shelf_height;
+        shelf_height = 0;
+    }
+    if (shelf_y + height > __bottom(p))
+        return 1;
+
+    *x = shelf_x;
+    *y = shelf_y;
+    page->shelf_x = shelf_x + width;
+    page->shelf_y = shelf_y;
+    page->shelf_height = height > shelf_height ? height : shelf_height;
+    return 0;
+}
+
+/**
+ * The skyline is a list of segments ordered by x, covering the whole strip.
+ * The y of a segment is the first free row above it.
+ */
+static int __skyline_fit(const msdfgl_packer_t *p, const msdfgl_packer_page_t *page, size_t i,
+                         int width) {
+    int x = page->rects[i].x;
+    if (x + width > __right(p))
+        return -1;
+
+    int y = 0;
+    for (int left = width; left > 0; ++i) {
+        if (page->rects[i].y > y)
+            y = page->rects[i].y;
+        left -= page->rects[i].width;
+    }
+    return y;
+}
+
+static int __skyline_insert(const msdfgl_packer_t *p, msdfgl_packer_page_t *page, int width,
+                            int height, int *x, int *y) {
+    size_t best = page->nrects;
+    int best_y = 0, best_waste = 0;
+
+    for (size_t i = 0; i < page->nrects; ++i) {
+        int fit_y = __skyline_fit(p, page, i, width);
+        if (fit_y < 0 || fit_y + height > __bottom(p))
+            continue;
+
+        /* Lowest top edge first, then the least area lost under the bitmap. */
+        int waste = 0;
+        for (size_t j = i, left = width; left > 0; ++j) {
+            int w = page->rects[j].width < (int)left ? page->rects[j].width : (int)left;
+            waste += (fit_y - page->rects[j].y) * w;
+            left -= w;
+        }
+        if (best == page->nrects || fit_y < best_y ||
+            (fit_y == best_y && waste < best_waste)) {
+            best = i;
+            best_y = fit_y;
+            best_waste = waste;
+        }
+    }
+    if (best == page->nrects)
+        return 1;
+
+    msdfgl_packer_rect_t top = {page->rects[best].x, best_y + height, width, 0};
+    if (__insert_rect(page, best, top))
+        return -1;
+
+    /* Cut the segments now hidden under the bitmap. */
+    size_t i = best + 1;
+    while (i < page->nrects) {
+        int end = top.x + top.width;
+        if (page->rects[i].x >= end)
+            break;
+
+        int overlap = end - page->rects[i].x;
+        if (overlap < page->rects[i].width) {
+            page->rects[i].x += overlap;
+            page->rects[i].width -= overlap;
+            break;
+        }
+        __remove_rect(page, i);
+    }
+
+    /* Merge neighbours at the same height. */
+    for (i = 0; i + 1 < page->nrects;) {
+        if (page->rects[i].y == page->rects[i + 1].y) {
+            page->rects[i].width += page->rects[i + 1].width;
+            __remove_rect(page, i + 1);
+        } else {
+            ++i;
+        }
+    }
+
+    *x = top.x;
+    *y = best_y;
+    return 0;
+}
+
+static int __contains(const msdfgl_packer_rect_t *a, const msdfgl_packer_rect_t *b) {
+    return b->x >= a->x && b->y >= a->y && b->x + b->width <= a->x + a->width &&
+           b->y + b->height <= a->y + a->height;
+}
+
+/**
+ * Take `used` out of the free rectangles of a MaxRects page.
+ */
+static int __maxrects_occupy(msdfgl_packer_page_t *p, msdfgl_packer_rect_t used) {
+    /* Split every free rectangle overlapping the new bitmap into the maximal
+       rectangles around it. The split ones are marked with a zero width. */
+    size_t n = p->nrects;
+    for (size_t i = 0; i < n; ++i) {
+        msdfgl_packer_rect_t r = p->rects[i];
+        if (used.x >= r.x + r.width || used.x + used.width <= r.x ||
+            used.y >= r.y + r.height || used.y + used.height <= r.y)
+            continue;
+
+        msdfgl_packer_rect_t parts[4];
+        int nparts = 0;
+        if (used.x > r.x)
+            parts[nparts++] = (msdfgl_packer_rect_t){r.x, r.y, used.x - r.x, r.height};
+        if (used.x + used.width < r.x + r.width)
+            parts[nparts++] = (msdfgl_packer_rect_t){used.x + used.width, r.y,
+                                                     r.x + r.width - used.x - used.width,
+                                                     r.height};
+        if (used.y > r.y)
+            parts[nparts++] = (msdfgl_packer_rect_t){r.x, r.y, r.width, used.y - r.y};
+        if (used.y + used.height < r.y + r.height)
+            parts[nparts++] = (msdfgl_packer_rect_t){r.x, used.y + used.height, r.width,
+                                                     r.y + r.height - used.y - used.height};
+
+        if (__reserve(p, p->nrects + nparts))
+            return -1;
+        for (int j = 0; j < nparts; ++j)
+            p->rects[p->nrects++] = parts[j];
+        p->rects[i].width = 0;
+    }
+
+    /* Drop the split rectangles, and the ones contained in others. */
+    for (size_t i = 0; i < p->nrects;) {
+        if (!p->rects[i].width)
+            p->rects[i] = p->rects[--p->nrects];
+        else
+            ++i;
+    }
+    for (size_t i = 0; i < p->nrects; ++i) {
+        for (size_t j = i + 1; j < p->nrects;) {
+            if (__contains(&p->rects[i], &p->rects[j])) {
+                p->rects[j] = p->rects[--p->nrects];
+            } else if (__contains(&p->rects[j], &p->rects[i])) {
+                p->rects[i] = p->rects[--p->nrects];
+                j = i + 1;
+            } else {
+                ++j;
+            }
+        }
+    }
+    return 0;
+}
+
+static int __maxrects_insert(msdfgl_packer_page_t *p, int width, int height, int *x, int *y) {
+    size_t best = p->nrects;
+    for (size_t i = 0; i < p->nrects; ++i) {
+        msdfgl_packer_rect_t *r = &p->rects[i];
+        if (r->width < width || r->height < height)
+            continue;
+
+        /* Bottom-left: lowest bottom edge, then leftmost. */
+        if (best == p->nrects || r->y < p->rects[best].y ||
+            (r->y == p->rects[best].y && r->x < p->rects[best].x))
+            best = i;
+    }
+    if (best == p->nrects)
+        return 1;
+
+    msdfgl_packer_rect_t used = {p->rects[best].x, p->rects[best].y, width, height};
+    if (__maxrects_occupy(p, used))
+        return -1;
+
+    *x = used.x;
+    *y = used.y;
+    return 0;
+}
+
+
+static int __page_init(const msdfgl_packer_t *p, msdfgl_packer_page_t *page) {
+    page->nrects = 0;
+    page->shelf_x = 1;
+    page->shelf_y = 1;
+    page->shelf_height = 0;
+    page->height = 1;
+    page->area = 0;
+
+    if (p->kind == MSDFGL_PACKER_SHELF)
+        return 0;
+    if (__reserve(page, 1))
+        return -1;
+
+    page->rects[0] = (msdfgl_packer_rect_t){1, 1, __right(p) - 1, __bottom(p) - 1};
+    page->nrects = 1;
+    return 0;
+}
+
+static int __add_page(msdfgl_packer_t *p) {
+    if (p->npages == p->nallocated) {
+        int nallocated = p->nallocated ? p->nallocated * 2 : 1;
+        msdfgl_packer_page_t *pages =
+            realloc(p->pages, nallocated * sizeof(msdfgl_packer_page_t));
+        if (!pages)
+            return -1;
+        memset(&pages[p->nallocated], 0,
+               (nallocated - p->nallocated) * sizeof(msdfgl_packer_page_t));
+        p->pages = pages;
+        p->nallocated = nallocated;
+    }
+    if (__page_init(p, &p->pages[p->npages]))
+        return -1;
+    p->npages++;
+    return 0;
+}
+
+static int __page_insert(const msdfgl_packer_t *p, msdfgl_packer_page_t *page, int width,
+                         int height, int *x, int *y) {
+    int padded_width = width + p->padding;
+    int padded_height = height + p->padding;
+
+    int status;
+    switch (p->kind) {
+    case MSDFGL_PACKER_SHELF:
+        status = __shelf_insert(p, page, padded_width, padded_height, x, y);
+        break;
+    case MSDFGL_PACKER_MAXRECTS:
+        status = __maxrects_insert(page, padded_width, padded_height, x, y);
+        break;
+    case MSDFGL_PACKER_SKYLINE:
+    default:
+        status = __skyline_insert(p, page, padded_width, padded_height, x, y);
+        break;
+    }
+    if (status)
+        return status;
+
+    if (*y + height > page->height)
+        page->height = *y + height;
+    page->area += (size_t)width * (size_t)height;
+    return 0;
+}
+
+int msdfgl_packer_init(msdfgl_packer_t *p, enum msdfgl_atlas_packer kind, int width,
+                       int page_height, int padding) {
+    memset(p, 0, sizeof(msdfgl_packer_t));
+    p->kind = kind;
+    p->width = width;
+    p->page_height = page_height;
+    p->padding = padding;
+    return __add_page(p);
+}
+
+int msdfgl_packer_reset(msdfgl_packer_t *p) {
+    for (int i = 0; i < p->nallocated; ++i) {
+        if (p->pages[i].rects)
+            free(p->pages[i].rects);
+    }
+    memset(p->pages, 0, p->nallocated * sizeof(msdfgl_packer_page_t));
+    p->npages = 0;
+    return __add_page(p);
+}
+
+int msdfgl_packer_insert(msdfgl_packer_t *p, int width, int height, int *x, int *y,
+                         int *page) {
+    if (width < 0 || height < 0 || 1 + width > p->width ||
+        1 + height > __bottom(p) - p->padding)
+        return -1;
+
+    for (int i = 0; i < p->npages; ++i) {
+        int status = __page_insert(p, &p->pages[i], width, height, x, y);
+        if (status < 0)
+            return -1;
+        if (!status) {
+            *page = i;
+            return 0;
+        }
+    }
+
+    if (p->max_pages && p->npages == p->max_pages)
+        return 1;
+
+    /* Fits on an empty page, checked above. */
+    if (__add_page(p) || __page_insert(p, &p->pages[p->npages - 1], width, height, x, y))
+        return -1;
+    *page = p->npages - 1;
+    return 0;
+}
+
+int msdfgl_packer_rebuild(msdfgl_packer_t *p, int page, const msdfgl_packer_rect_t *used,
+                          size_t n) {
+    if (p->kind != MSDFGL_PACKER_MAXRECTS || page >= p->npages)
+        return -1;
+
+    msdfgl_packer_page_t *pg = &p->pages[page];
+    if (__page_init(p, pg))
+        return -1;
+    for (size_t i = 0; i < n; ++i) {
+        msdfgl_packer_rect_t r = {used[i].x, used[i].y, used[i].width + p->padding,
+                                  used[i].height + p->padding};
+        if (__maxrects_occupy(pg, r))
+            return -1;
+        if (used[i].y + used[i].height > pg->height)
+            pg->height = used[i].y + used[i].height;
+        pg->area += (size_t)used[i].width * (size_t)used[i].height;
+    }
+    return 0;
+}
+
+int msdfgl_packer_height(const msdfgl_packer_t *p) {
+    int height = 0;
+    for (int i = 0; i < p->npages; ++i)
+        height = p->pages[i].height > height ? p->pages[i].height : height;
+    return height;
+}
+
+size_t msdfgl_packer_area(const msdfgl_packer_t *p) {
+    size_t area = 0;
+    for (int i = 0; i < p->npages; ++i)
+        area += p->pages[i].area;
+    return area;
+}
+
+int msdfgl_packer_set_page(msdfgl_packer_t *p, int i, const msdfgl_packer_page_t *page) {
+    while (p->npages <= i) {
+        if (__add_page(p))
+            return -1;
+    }
+
+    msdfgl_packer_page_t *dst = &p->pages[i];
+    if (__reserve(dst, page->nrects))
+        return -1;
+    if (page->nrects)
+        memcpy(dst->rects, page->rects, page->nrects * sizeof(msdfgl_packer_rect_t));
+    dst->nrects = page->nrects;
+    dst->shelf_x = page->shelf_x;
+    dst->shelf_y = page->shelf_y;
+    dst->shelf_height = page->shelf_height;
+    dst->height = page->height;
+    dst->area = page->area;
+    return 0;
+}
+
+int msdfgl_packer_copy(msdfgl_packer_t *dst, const msdfgl_packer_t *src) {
+    *dst = *src;
+    dst->pages = NULL;
+    dst->npages = 0;
+    dst->nallocated = 0;
+    if (!(dst->pages = calloc(src->npages, sizeof(msdfgl_packer_page_t))))
+        return -1;
+    dst->nallocated = src->npages;
+
+    for (int i = 0; i < src->npages; ++i) {
+        const msdfgl_packer_page_t *page = &src->pages[i];
+        dst->pages[i] = *page;
+        dst->pages[i].rects = NULL;
+        dst->pages[i].nallocated = 0;
+        dst->npages++;
+        if (__reserve(&dst->pages[i], page->nrects)) {
+            msdfgl_packer_destroy(dst);
+            return -1;
+        }
+        if (page->nrects)
+            memcpy(dst->pages[i].rects, page->rects,
+                   page->nrects * sizeof(msdfgl_packer_rect_t));
+    }
+    return 0;
+}
+
+void msdfgl_packer_destroy(msdfgl_packer_t *p) {
+    for (int i = 0; i < p->nallocated; ++i) {
+        if (p->pages[i].rects)
+            free(p->pages[i].rects);
+    }
+    if (p->pages)
+        free(p->pages);
+    p->pages = NULL;
+    p->npages = 0;
+    p->nallocated = 0;
+}
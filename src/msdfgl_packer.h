@@ -0,0 +1,120 @@
+#ifndef MSDFGL_PACKER_H
+#define MSDFGL_PACKER_H
+
+/**
+ * Placement of glyph bitmaps on an atlas.
+ *
+ * The atlas has a fixed width and grows in height up to a page height, after
+ * which further pages are added. A one pixel border is left on the top and
+ * left edges of each page, and `padding` pixels on the right and bottom of
+ * every bitmap keep them apart.
+ *
+ * Shelf packing fills rows left to right, each as tall as its tallest bitmap.
+ * Skyline packing keeps the top edge of the packed bitmaps as a list of
+ * horizontal segments and rests every bitmap as low as possible on it.
+ * MaxRects keeps all maximal free rectangles, including the holes the other
+ * two leave behind, and places bitmaps bottom-left first. It packs tightest,
+ * but its cost grows with the amount of free rectangles.
+ */
+
+#include <stddef.h>
+
+#include "msdfgl.h"
+
+typedef struct _msdfgl_packer_rect {
+    int x;
+    int y;
+    int width;
+    int height;
+} msdfgl_packer_rect_t;
+
+typedef struct _msdfgl_packer_page {
+    /**
+     * Skyline segments (with y as the top edge) or free rectangles,
+     * depending on the kind.
+     */
+    msdfgl_packer_rect_t *rects;
+    size_t nrects;
+    size_t nallocated;
+
+    /* The open row of the shelf packer. */
+    int shelf_x;
+    int shelf_y;
+    int shelf_height;
+
+    /**
+     * Rows in use, the bottom edge of the lowest bitmap.
+     */
+    int height;
+
+    /**
+     * Area of the placed bitmaps, without padding.
+     */
+    size_t area;
+} msdfgl_packer_page_t;
+
+typedef struct _msdfgl_packer {
+    enum msdfgl_atlas_packer kind;
+    int width;
+    /* Height limit of the pages, 0 for a single page without one. */
+    int page_height;
+    int padding;
+    /* Most pages to add, 0 for no limit. */
+    int max_pages;
+
+    msdfgl_packer_page_t *pages;
+    int npages;
+    int nallocated;
+} msdfgl_packer_t;
+
+/**
+ * Set up a packer with one empty page of `width` pixels.
+ */
+int msdfgl_packer_init(msdfgl_packer_t *p, enum msdfgl_atlas_packer kind, int width,
+                       int page_height, int padding);
+
+/**
+ * Forget all placed bitmaps and pages.
+ */
+int msdfgl_packer_reset(msdfgl_packer_t *p);
+
+/**
+ * Find a place for a `width` x `height` bitmap and reserve it, adding a page
+ * if none of the existing ones has room. Returns 0 on success, 1 if all of
+ * `max_pages` are full, and -1 if the bitmap does not fit a page or
+ * allocation failed.
+ */
+int msdfgl_packer_insert(msdfgl_packer_t *p, int width, int height, int *x, int *y,
+                         int *page);
+
+/**
+ * Recompute the free space of a page from the bitmaps still on it, after some
+ * were removed. Only supported by MaxRects packers.
+ */
+int msdfgl_packer_rebuild(msdfgl_packer_t *p, int page, const msdfgl_packer_rect_t *used,
+                          size_t n);
+
+/**
+ * Rows in use on the fullest page.
+ */
+int msdfgl_packer_height(const msdfgl_packer_t *p);
+
+/**
+ * Area of all placed bitmaps, without padding.
+ */
+size_t msdfgl_packer_area(const msdfgl_packer_t *p);
+
+/**
+ * Replace page `i` with a copy of `page`, e.g. one saved earlier, adding empty
+ * pages up to it if needed.
+ */
+int msdfgl_packer_set_page(msdfgl_packer_t *p, int i, const msdfgl_packer_page_t *page);
+
+/**
+ * Make `dst` an independent copy of `src`, e.g. for trying out placements.
+ */
+int msdfgl_packer_copy(msdfgl_packer_t *dst, const msdfgl_packer_t *src);
+
+void msdfgl_packer_destroy(msdfgl_packer_t *p);
+
+#endif /* MSDFGL_PACKER_H */
@@ -1,5 +1,6 @@
 #include <math.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include "msdfgl.h"
 #include "msdfgl_serializer.h"
@@ -38,12 +39,28 @@ static bool is_corner(const vec2 a, const vec2 b, float cross_threshold) {
 
 static inline vec2 normalize(vec2 v) {return divide(v, length(v));}
 
+static inline bool __equal(vec2 a, vec2 b) {return a.x == b.x && a.y == b.y;}
+
 static inline vec2 segment_direction(const vec2 *points, int npoints, float param) {
-    return mix(subt(points[1], points[0]), subt(points[npoints - 1], points[npoints - 2]),
-               param);
+    vec2 start = subt(points[1], points[0]);
+    vec2 end = subt(points[npoints - 1], points[npoints - 2]);
+
+    /* A cubic control point on top of its end point, the curve leaves towards
+       the other control point. */
+    if (npoints == 4 && __equal(points[0], points[1]))
+        start = subt(points[2], points[0]);
+    if (npoints == 4 && __equal(points[2], points[3]))
+        end = subt(points[3], points[1]);
+
+    return mix(start, end, param);
 }
 
 static inline vec2 segment_point(const vec2 *points, int npoints, float param) {
+    if (npoints == 4) {
+        vec2 m = mix(points[1], points[2], param);
+        return mix(mix(mix(points[0], points[1], param), m, param),
+                   mix(m, mix(points[2], points[3], param), param), param);
+    }
     return mix(mix(points[0], points[1], param),
                mix(points[npoints - 2], points[npoints - 1], param), param);
 }
@@ -52,120 +69,153 @@ static inline GLfloat shoelace(const vec2 a, const vec2 b) {
     return (b.x - a.x) * (a.y + b.y);
 }
 
-struct __glyph_len_ctx {
-    int meta_size;
-    int data_size;
-};
+static int __reserve(void **buffer, size_t *alloc, size_t needed, size_t item_size) {
+    if (needed <= *alloc)
+        return 0;
 
-static int __add_contour_size(const FT_Vector *to, void *user) {
-    struct __glyph_len_ctx *ctx = (struct __glyph_len_ctx *)user;
-    ctx->data_size += 1;
-    ctx->meta_size += 2; /* winding + nsegments */
-    return 0;
-}
-static int __add_linear_size(const FT_Vector *to, void *user) {
-    struct __glyph_len_ctx *ctx = (struct __glyph_len_ctx *)user;
-    ctx->data_size += 1;
-    ctx->meta_size += 2; /* color + npoints */
-    return 0;
-}
-static int __add_quad_size(const FT_Vector *control, const FT_Vector *to, void *user) {
-    struct __glyph_len_ctx *ctx = (struct __glyph_len_ctx *)user;
-    ctx->data_size += 2;
-    ctx->meta_size += 2; /* color + npoints */
+    size_t new_alloc = *alloc ? *alloc : SERIALIZER_INITIAL_SIZE;
+    while (new_alloc < needed)
+        new_alloc *= 2;
+
+    void *new = realloc(*buffer, new_alloc * item_size);
+    if (!new)
+        return -1;
+
+    *buffer = new;
+    *alloc = new_alloc;
     return 0;
 }
-static int __add_cubic_size(const FT_Vector *control1, const FT_Vector *control2,
-                            const FT_Vector *to, void *s) {
-    fprintf(stderr, "Cubic segments not supported\n");
-    return -1;
+
+static int __reserve_meta(msdfgl_serializer_t *s, size_t n) {
+    return __reserve((void **)&s->meta, &s->meta_alloc, s->meta_size + n, sizeof(GLuint));
 }
 
-/* We need two rounds of decomposing, the first one will just figure out
-   how much space we need to serialize the glyph, and the second one
-   serializes it and generates colour mapping for the segments. */
-int msdfgl_glyph_buffer_size(FT_Face face, int code, size_t *meta_size,
-                             size_t *point_size) {
+static int __reserve_glyph_meta(msdfgl_serializer_t *s, size_t n) {
+    return __reserve((void **)&s->_meta, &s->_meta_alloc, s->_meta_size + n, sizeof(int));
+}
 
-    if (FT_Load_Char(face, code, FT_LOAD_NO_SCALE))
-        return -1;
+static int __reserve_segments(msdfgl_serializer_t *s, size_t n) {
+    return __reserve((void **)&s->segments, &s->segment_alloc, s->segment_size + n,
+                     SERIALIZER_SEGMENT_SIZE * sizeof(GLfloat));
+}
 
-    FT_Outline_Funcs fns;
-    fns.shift = 0;
-    fns.delta = 0;
-    fns.move_to = __add_contour_size;
-    fns.line_to = __add_linear_size;
-    fns.conic_to = __add_quad_size;
-    fns.cubic_to = __add_cubic_size;
-    struct __glyph_len_ctx ctx = {1, 0};
-    if (FT_Outline_Decompose(&face->glyph->outline, &fns, &ctx))
-        return -1;
+static int __reserve_outline(msdfgl_serializer_t *s, size_t n) {
+    return __reserve((void **)&s->_outline, &s->_outline_alloc, n, sizeof(vec2));
+}
 
-    *meta_size = ctx.meta_size;
-    *point_size = ctx.data_size * 2 * sizeof(GLfloat);
+static int __reserve_points(msdfgl_serializer_t *s, size_t n) {
+    return __reserve((void **)&s->points, &s->point_alloc, s->point_size + n,
+                     2 * sizeof(GLshort));
+}
 
-    return 0;
+static GLshort __pack(GLfloat v) {
+    float units = roundf(v * SERIALIZER_SCALE);
+    return (GLshort)(units < -32768 ? -32768 : units > 32767 ? 32767 : units);
 }
 
 struct __glyph_data_ctx {
-    int meta_index;
-    char *meta_buffer;
+    msdfgl_serializer_t *s;
+
+    size_t nsegments_index;
 
-    vec2 *segment;
-    int nsegments_index;
+    /* Index of the first point of the current segment. */
+    size_t segment;
 };
 
+#define __POINT(ctx, i) (((vec2 *)(ctx)->s->_outline)[(ctx)->segment + (i)])
+#define __META(ctx, i) ((ctx)->s->_meta[(i)])
+
 static int __add_contour(const FT_Vector *to, void *user) {
     struct __glyph_data_ctx *ctx = (struct __glyph_data_ctx *)user;
 
+    if (__reserve_glyph_meta(ctx->s, 2) || __reserve_outline(ctx->s, ctx->segment + 2))
+        return -1;
+
     ctx->segment += 1;  /* Start contour on a fresh glyph. */
 
-    ctx->segment[0].x = to->x / SERIALIZER_SCALE;
-    ctx->segment[0].y = to->y / SERIALIZER_SCALE;
+    __POINT(ctx, 0).x = to->x / SERIALIZER_SCALE;
+    __POINT(ctx, 0).y = to->y / SERIALIZER_SCALE;
 
-    ctx->meta_buffer[0] += 1;                /* Increase the number of contours. */
-    ctx->meta_buffer[ctx->meta_index++] = 0; /* Set winding to zero */
+    __META(ctx, 0) += 1;                          /* Increase the number of contours. */
+    __META(ctx, ctx->s->_meta_size++) = 0;         /* Set winding to zero */
 
-    ctx->nsegments_index = ctx->meta_index++;
-    ctx->meta_buffer[ctx->nsegments_index] = 0;
+    ctx->nsegments_index = ctx->s->_meta_size++;
+    __META(ctx, ctx->nsegments_index) = 0;
 
     return 0;
 }
 static int __add_linear(const FT_Vector *to, void *user) {
     struct __glyph_data_ctx *ctx = (struct __glyph_data_ctx *)user;
-    ctx->segment[1].x = to->x / SERIALIZER_SCALE;
-    ctx->segment[1].y = to->y / SERIALIZER_SCALE;
+
+    if (__reserve_glyph_meta(ctx->s, 2) || __reserve_outline(ctx->s, ctx->segment + 2))
+        return -1;
+
+    __POINT(ctx, 1).x = to->x / SERIALIZER_SCALE;
+    __POINT(ctx, 1).y = to->y / SERIALIZER_SCALE;
 
     /* Some glyphs contain zero-dimensional segments, ignore those. */
-    if (ctx->segment[1].x == ctx->segment[0].x && ctx->segment[1].y == ctx->segment[0].y)
+    if (__POINT(ctx, 1).x == __POINT(ctx, 0).x && __POINT(ctx, 1).y == __POINT(ctx, 0).y)
         return 0;
 
     ctx->segment += 1;
 
-    ctx->meta_buffer[ctx->meta_index++] = 0; /* Set color to 0 */
-    ctx->meta_buffer[ctx->meta_index++] = 2;
-    ctx->meta_buffer[ctx->nsegments_index]++;
+    __META(ctx, ctx->s->_meta_size++) = 0; /* Set color to 0 */
+    __META(ctx, ctx->s->_meta_size++) = 2;
+    __META(ctx, ctx->nsegments_index)++;
     return 0;
 }
 static int __add_quad(const FT_Vector *control, const FT_Vector *to, void *user) {
     struct __glyph_data_ctx *ctx = (struct __glyph_data_ctx *)user;
 
-    ctx->segment[1].x = control->x / SERIALIZER_SCALE;
-    ctx->segment[1].y = control->y / SERIALIZER_SCALE;
-    ctx->segment[2].x = to->x / SERIALIZER_SCALE;
-    ctx->segment[2].y = to->y / SERIALIZER_SCALE;
+    if (__reserve_glyph_meta(ctx->s, 2) || __reserve_outline(ctx->s, ctx->segment + 3))
+        return -1;
+
+    __POINT(ctx, 1).x = control->x / SERIALIZER_SCALE;
+    __POINT(ctx, 1).y = control->y / SERIALIZER_SCALE;
+    __POINT(ctx, 2).x = to->x / SERIALIZER_SCALE;
+    __POINT(ctx, 2).y = to->y / SERIALIZER_SCALE;
 
     /* Some glyphs contain "bugs", where a quad segment is actually a linear
        segment with a double point. Treat it as a linear segment. */
-    if ((ctx->segment[1].x == ctx->segment[0].x && ctx->segment[1].y == ctx->segment[0].y)
-        || (ctx->segment[2].x == ctx->segment[1].x && ctx->segment[2].y == ctx->segment[1].y))
+    if ((__POINT(ctx, 1).x == __POINT(ctx, 0).x && __POINT(ctx, 1).y == __POINT(ctx, 0).y)
+        || (__POINT(ctx, 2).x == __POINT(ctx, 1).x && __POINT(ctx, 2).y == __POINT(ctx, 1).y))
         return __add_linear(to, user);
 
     ctx->segment += 2;
 
-    ctx->meta_buffer[ctx->meta_index++] = 0; /* Set color to 0 */
-    ctx->meta_buffer[ctx->meta_index++] = 3;
-    ctx->meta_buffer[ctx->nsegments_index]++;
+    __META(ctx, ctx->s->_meta_size++) = 0; /* Set color to 0 */
+    __META(ctx, ctx->s->_meta_size++) = 3;
+    __META(ctx, ctx->nsegments_index)++;
+    return 0;
+}
+static int __add_cubic(const FT_Vector *control1, const FT_Vector *control2,
+                       const FT_Vector *to, void *user) {
+    struct __glyph_data_ctx *ctx = (struct __glyph_data_ctx *)user;
+
+    if (__reserve_glyph_meta(ctx->s, 2) || __reserve_outline(ctx->s, ctx->segment + 4))
+        return -1;
+
+    __POINT(ctx, 1).x = control1->x / SERIALIZER_SCALE;
+    __POINT(ctx, 1).y = control1->y / SERIALIZER_SCALE;
+    __POINT(ctx, 2).x = control2->x / SERIALIZER_SCALE;
+    __POINT(ctx, 2).y = control2->y / SERIALIZER_SCALE;
+    __POINT(ctx, 3).x = to->x / SERIALIZER_SCALE;
+    __POINT(ctx, 3).y = to->y / SERIALIZER_SCALE;
+
+    bool start_collapsed =
+        __POINT(ctx, 1).x == __POINT(ctx, 0).x && __POINT(ctx, 1).y == __POINT(ctx, 0).y;
+    bool end_collapsed =
+        __POINT(ctx, 3).x == __POINT(ctx, 2).x && __POINT(ctx, 3).y == __POINT(ctx, 2).y;
+
+    /* Both control points on the end points, this is a linear segment. */
+    if (start_collapsed && end_collapsed)
+        return __add_linear(to, user);
+
+    ctx->segment += 3;
+
+    __META(ctx, ctx->s->_meta_size++) = 0; /* Set color to 0 */
+    __META(ctx, ctx->s->_meta_size++) = 4;
+    __META(ctx, ctx->nsegments_index)++;
     return 0;
 }
 
@@ -188,11 +238,680 @@ void switch_color(enum Color *color, unsigned long long *seed, enum Color *_bann
     *seed >>= 1;
 }
 
-int msdfgl_serialize_glyph(FT_Face face, int code, char *meta_buffer,
-                           GLfloat *point_buffer) {
+typedef struct __segment {
+    int npoints;
+    vec2 p[4];
+} __segment;
+
+/* Distance of p from the line through a and b, and the parameter of its projection. */
+static float __line_distance(vec2 a, vec2 b, vec2 p, float *param) {
+    vec2 ab = subt(b, a);
+    float len2 = dot(ab, ab);
+    if (len2 == 0) {
+        *param = 0;
+        return length(subt(p, a));
+    }
+    *param = dot(subt(p, a), ab) / len2;
+    return (float)fabs(cross(ab, subt(p, a))) / (float)sqrt(len2);
+}
+
+static bool __is_flat(const __segment *s, float tolerance) {
+    vec2 a = s->p[0];
+    vec2 b = s->p[s->npoints - 1];
+
+    /* The curve stays within half (quadratic) or three quarters (cubic) of the
+       control point distance from its chord. */
+    float factor = s->npoints == 3 ? 0.5f : 0.75f;
+    for (int i = 1; i < s->npoints - 1; ++i) {
+        float t;
+        if (__line_distance(a, b, s->p[i], &t) * factor > tolerance || t < 0 || t > 1)
+            return false;
+    }
+    return true;
+}
+
+static float __polygon_length(const __segment *s) {
+    float len = 0;
+    for (int i = 0; i < s->npoints - 1; ++i)
+        len += length(subt(s->p[i + 1], s->p[i]));
+    return len;
+}
+
+static void __to_linear(__segment *s) {
+    s->p[1] = s->p[s->npoints - 1];
+    s->npoints = 2;
+}
+
+/* Moving an end point onto a control point would give the curve a zero direction. */
+static void __fix_degenerate(__segment *s) {
+    if (s->npoints > 2 && (__equal(s->p[0], s->p[1]) ||
+                           __equal(s->p[s->npoints - 2], s->p[s->npoints - 1])))
+        __to_linear(s);
+}
+
+static void __remove_segment(__segment *segs, int *n, int i) {
+    memmove(&segs[i], &segs[i + 1], (*n - i - 1) * sizeof(__segment));
+    --*n;
+}
+
+/* Simplify a closed contour in place, returns the new amount of segments. */
+static int __simplify_contour(__segment *segs, int n, float tolerance) {
+
+    /* Flat curves become lines. */
+    for (int i = 0; i < n; ++i) {
+        if (segs[i].npoints > 2 && __is_flat(&segs[i], tolerance))
+            __to_linear(&segs[i]);
+    }
+
+    /* Drop segments shorter than the tolerance, the neighbouring segment is
+       stretched to close the gap. */
+    for (int i = 0; i < n && n > 1;) {
+        if (__polygon_length(&segs[i]) >= tolerance) {
+            ++i;
+            continue;
+        }
+        if (i > 0) {
+            __segment *prev = &segs[i - 1];
+            prev->p[prev->npoints - 1] = segs[i].p[segs[i].npoints - 1];
+            __fix_degenerate(prev);
+        } else {
+            segs[1].p[0] = segs[0].p[0];
+            __fix_degenerate(&segs[1]);
+        }
+        __remove_segment(segs, &n, i);
+    }
+
+    /* Merge runs of collinear lines, also across the start of the contour. */
+    for (bool merged = true; merged && n > 2;) {
+        merged = false;
+        for (int i = 0; i < n && n > 2; ++i) {
+            int j = (i + 1) % n;
+            float t;
+            if (segs[i].npoints != 2 || segs[j].npoints != 2)
+                continue;
+            if (__line_distance(segs[i].p[0], segs[j].p[1], segs[i].p[1], &t) > tolerance ||
+                t <= 0 || t >= 1)
+                continue;
+
+            segs[i].p[1] = segs[j].p[1];
+            __remove_segment(segs, &n, j);
+            merged = true;
+        }
+    }
+
+    /* Drop slivers, contours which fit inside the tolerance. */
+    vec2 lo = segs[0].p[0], hi = segs[0].p[0];
+    for (int i = 0; i < n; ++i) {
+        for (int j = 0; j < segs[i].npoints; ++j) {
+            lo.x = fminf(lo.x, segs[i].p[j].x);
+            lo.y = fminf(lo.y, segs[i].p[j].y);
+            hi.x = fmaxf(hi.x, segs[i].p[j].x);
+            hi.y = fmaxf(hi.y, segs[i].p[j].y);
+        }
+    }
+    if (hi.x - lo.x < tolerance && hi.y - lo.y < tolerance)
+        return 0;
+
+    return n;
+}
+
+/* Rewrite the glyph being serialized with simplified contours. The output is
+   never larger than the input, so it is written over the original data.
+   `npoints` is the size of the glyph's outline, and is updated. */
+static int __simplify_glyph(msdfgl_serializer_t *s, size_t *npoints) {
+    int *meta = s->_meta;
+    vec2 *points = (vec2 *)s->_outline;
+
+    int ncontours = meta[0];
+    size_t read_meta = 1, read_point = 0;
+    size_t write_meta = 1, write_point = 0;
+    int written = 0;
+
+    for (int c = 0; c < ncontours; ++c) {
+        int n = meta[read_meta + 1];
+        read_meta += 2;
+
+        if (__reserve((void **)&s->_segments, &s->_segments_alloc, n ? n : 1,
+                      sizeof(__segment)))
+            return -1;
+        __segment *segs = (__segment *)s->_segments;
+
+        /* Copy the contour out before it is overwritten. */
+        for (int i = 0; i < n; ++i) {
+            segs[i].npoints = meta[read_meta + 1];
+            read_meta += 2;
+            for (int j = 0; j < segs[i].npoints; ++j)
+                segs[i].p[j] = points[read_point + j];
+            read_point += segs[i].npoints - 1;
+        }
+        read_point += 1;
+
+        if (!n || !(n = __simplify_contour(segs, n, s->tolerance)))
+            continue;
+
+        meta[write_meta++] = 0; /* Winding */
+        meta[write_meta++] = n;
+        points[write_point++] = segs[0].p[0];
+        for (int i = 0; i < n; ++i) {
+            meta[write_meta++] = 0; /* Color */
+            meta[write_meta++] = segs[i].npoints;
+            for (int j = 1; j < segs[i].npoints; ++j)
+                points[write_point++] = segs[i].p[j];
+        }
+        ++written;
+    }
+
+    meta[0] = written;
+    s->_meta_size = write_meta;
+    *npoints = write_point;
+    return 0;
+}
+
+void msdfgl_serializer_init(msdfgl_serializer_t *s) {
+    s->meta = NULL;
+    s->meta_size = 0;
+    s->meta_alloc = 0;
+    s->points = NULL;
+    s->point_size = 0;
+    s->point_alloc = 0;
+    s->segments = NULL;
+    s->segment_size = 0;
+    s->segment_alloc = 0;
+    s->tolerance = 0;
+    s->range = 0;
+    s->_outline = NULL;
+    s->_outline_alloc = 0;
+    s->_segments = NULL;
+    s->_segments_alloc = 0;
+    s->_meta = NULL;
+    s->_meta_size = 0;
+    s->_meta_alloc = 0;
+    s->_corners = NULL;
+    s->_corners_alloc = 0;
+    s->_pieces = NULL;
+    s->_pieces_alloc = 0;
+    s->_bins = NULL;
+    s->_bins_alloc = 0;
+    s->single_channel = 0;
+    s->measure_detail = 0;
+}
+
+void msdfgl_serializer_reset(msdfgl_serializer_t *s) {
+    s->meta_size = 0;
+    s->point_size = 0;
+    s->segment_size = 0;
+}
+
+void msdfgl_serializer_destroy(msdfgl_serializer_t *s) {
+    if (s->meta)
+        free(s->meta);
+    if (s->points)
+        free(s->points);
+    if (s->segments)
+        free(s->segments);
+    if (s->_outline)
+        free(s->_outline);
+    if (s->_segments)
+        free(s->_segments);
+    if (s->_meta)
+        free(s->_meta);
+    if (s->_corners)
+        free(s->_corners);
+    if (s->_pieces)
+        free(s->_pieces);
+    if (s->_bins)
+        free(s->_bins);
+    msdfgl_serializer_init(s);
+}
+
+static int __finalize_glyph(msdfgl_serializer_t *s);
+
+/* Contours without area, some fonts seem to have them. `contour` points to
+   the winding of the contour in the unpacked metadata. */
+static bool __is_degenerate(const int *contour) {
+    int nsegments = contour[1];
+    return nsegments == 0 || (nsegments == 1 && contour[3] == 2) ||
+           (nsegments == 2 && contour[3] == 2 && contour[5] == 2);
+}
+
+/* Pieces a curve is flattened to when looking for the side of a cell. */
+#define __FLATTEN_PIECES 8
+
+static GLuint __float_bits(float f) {
+    GLuint bits;
+    memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
 
-    if (FT_Load_Char(face, code, FT_LOAD_NO_SCALE))
+static void __segment_bounds(const vec2 *points, int npoints, vec2 *lo, vec2 *hi) {
+    *lo = *hi = points[0];
+    for (int i = 1; i < npoints; ++i) {
+        lo->x = fminf(lo->x, points[i].x);
+        lo->y = fminf(lo->y, points[i].y);
+        hi->x = fmaxf(hi->x, points[i].x);
+        hi->y = fmaxf(hi->y, points[i].y);
+    }
+}
+
+/* The winding number of the segments from `from` to `to` around p, from the
+   crossings of a ray to its right. TrueType and CFF fill where the sum over
+   all contours is nonzero, so overlapping contours fill each other. */
+static int __winding(const vec2 *outline, const GLfloat *table, int from, int to, vec2 p) {
+    int winding = 0;
+
+    for (int i = from; i < to; ++i) {
+        const GLfloat *entry = &table[SERIALIZER_SEGMENT_SIZE * i];
+        const vec2 *points = &outline[(size_t)entry[0]];
+        int npoints = (int)entry[1];
+
+        /* The curve is inside the box of its points. Only segments reaching
+           across the ray can cross it. */
+        vec2 lo, hi;
+        __segment_bounds(points, npoints, &lo, &hi);
+        if (hi.y <= p.y || lo.y > p.y || hi.x < p.x)
+            continue;
+
+        int npieces = npoints == 2 ? 1 : __FLATTEN_PIECES;
+        vec2 a = points[0];
+        for (int j = 1; j <= npieces; ++j) {
+            vec2 b = segment_point(points, npoints, (float)j / npieces);
+            float side = cross(subt(b, a), subt(p, a));
+            if (a.y <= p.y && b.y > p.y && side > 0)
+                ++winding;
+            else if (a.y > p.y && b.y <= p.y && side < 0)
+                --winding;
+            a = b;
+        }
+    }
+    return winding;
+}
+
+/* Append the grid of the glyph being serialized, over the `nsegments` entries
+   of the segment table from `first` on. See msdfgl_serializer.h. */
+static int __encode_grid(msdfgl_serializer_t *s, size_t first, int nsegments) {
+    const vec2 *outline = (const vec2 *)s->_outline;
+    const GLfloat *table = &s->segments[SERIALIZER_SEGMENT_SIZE * first];
+    size_t base = s->meta_size;
+
+    if (!nsegments) {
+        if (__reserve_meta(s, 1))
+            return -1;
+        s->meta[s->meta_size++] = 0;
+        return 0;
+    }
+
+    /* The generated area, the outline with half the range around it. */
+    vec2 lo, hi;
+    __segment_bounds(&outline[(size_t)table[0]], (int)table[1], &lo, &hi);
+    for (int i = 1; i < nsegments; ++i) {
+        const GLfloat *entry = &table[SERIALIZER_SEGMENT_SIZE * i];
+        vec2 seg_lo, seg_hi;
+        __segment_bounds(&outline[(size_t)entry[0]], (int)entry[1], &seg_lo, &seg_hi);
+        lo.x = fminf(lo.x, seg_lo.x);
+        lo.y = fminf(lo.y, seg_lo.y);
+        hi.x = fmaxf(hi.x, seg_hi.x);
+        hi.y = fmaxf(hi.y, seg_hi.y);
+    }
+    lo.x -= s->range / 2;
+    lo.y -= s->range / 2;
+    hi.x += s->range / 2;
+    hi.y += s->range / 2;
+
+    /* About a cell per segment. The reach covers the range from anywhere in
+       the cell, so the side of its center is the side of its far pixels. */
+    int n = (int)ceilf(sqrtf((float)nsegments));
+    n = n < SERIALIZER_GRID_MAX ? n : SERIALIZER_GRID_MAX;
+    vec2 cell = {(hi.x - lo.x) / n, (hi.y - lo.y) / n};
+    float reach = s->range + length(cell) / 2;
+
+    size_t ncells = (size_t)n * n;
+    size_t size = SERIALIZER_GRID_HEADER + 2 * ncells;
+    if (__reserve_meta(s, size))
+        return -1;
+
+    GLuint *grid = &s->meta[base];
+    grid[0] = (GLuint)n;
+    grid[1] = __float_bits(lo.x);
+    grid[2] = __float_bits(lo.y);
+    grid[3] = __float_bits(cell.x);
+    grid[4] = __float_bits(cell.y);
+    grid[5] = __float_bits(reach);
+    memset(&grid[SERIALIZER_GRID_HEADER], 0, 2 * ncells * sizeof(GLuint));
+
+    /* The segments of each cell are counted first, then the lists are placed
+       after the cells and filled. */
+    for (int pass = 0; pass < 2; ++pass) {
+        grid = &s->meta[base];
+        GLuint *cells = &grid[SERIALIZER_GRID_HEADER];
+
+        for (int i = 0; i < nsegments; ++i) {
+            const GLfloat *entry = &table[SERIALIZER_SEGMENT_SIZE * i];
+            vec2 seg_lo, seg_hi;
+            __segment_bounds(&outline[(size_t)entry[0]], (int)entry[1], &seg_lo, &seg_hi);
+
+            int x0 = (int)floorf((seg_lo.x - reach - lo.x) / cell.x);
+            int x1 = (int)floorf((seg_hi.x + reach - lo.x) / cell.x);
+            int y0 = (int)floorf((seg_lo.y - reach - lo.y) / cell.y);
+            int y1 = (int)floorf((seg_hi.y + reach - lo.y) / cell.y);
+            x0 = x0 > 0 ? x0 : 0;
+            y0 = y0 > 0 ? y0 : 0;
+            x1 = x1 < n - 1 ? x1 : n - 1;
+            y1 = y1 < n - 1 ? y1 : n - 1;
+
+            for (int y = y0; y <= y1; ++y) {
+                for (int x = x0; x <= x1; ++x) {
+                    GLuint *c = &cells[2 * (y * n + x)];
+                    if (pass)
+                        grid[c[0] + c[1]] = (GLuint)i;
+                    c[1]++;
+                }
+            }
+        }
+
+        if (pass)
+            break;
+
+        for (size_t i = 0; i < ncells; ++i) {
+            cells[2 * i] = (GLuint)size;
+            size += cells[2 * i + 1];
+            cells[2 * i + 1] = 0;
+        }
+        if (__reserve_meta(s, size))
+            return -1;
+    }
+
+    /* The side of each cell, and the contours around it which have none of
+       their segments listed, by their windings at its center. */
+    grid = &s->meta[base];
+    GLuint *cells = &grid[SERIALIZER_GRID_HEADER];
+    for (int y = 0; y < n; ++y) {
+        for (int x = 0; x < n; ++x) {
+            vec2 center = {lo.x + (x + 0.5f) * cell.x, lo.y + (y + 0.5f) * cell.y};
+            GLuint *c = &cells[2 * (y * n + x)];
+            const GLuint *list = &grid[c[0]];
+            GLuint k = 0;
+            int winding = 0, around = 0;
+
+            for (int i = 0, end; i < nsegments; i = end) {
+                int header = (int)table[SERIALIZER_SEGMENT_SIZE * i + 3];
+                for (end = i + 1; end < nsegments; ++end)
+                    if ((int)table[SERIALIZER_SEGMENT_SIZE * end + 3] >> 1 != header >> 1)
+                        break;
+
+                bool listed = false;
+                for (; k < c[1] && list[k] < (GLuint)end; ++k)
+                    listed = true;
+
+                int contour_winding = __winding(outline, table, i, end, center);
+                winding += contour_winding;
+                if (!listed && contour_winding)
+                    around += header & 1 ? 1 : -1;
+            }
+            c[1] = c[1] << 3 | (GLuint)(around > 0 ? 1 : around < 0 ? 2 : 0) << 1 |
+                   (winding != 0);
+        }
+    }
+    s->meta_size = base + size;
+    return 0;
+}
+
+/* Append the segment table and the grid of the glyph being serialized to the
+   arena. Degenerate contours are left out. */
+static int __encode_glyph(msdfgl_serializer_t *s) {
+    const int *meta = s->_meta;
+    const vec2 *outline = (const vec2 *)s->_outline;
+
+    /* There are less segments than values. */
+    if (__reserve_segments(s, s->_meta_size))
+        return -1;
+
+    size_t first = s->segment_size;
+    size_t point = 0;
+    int ncontours = 0;
+    for (int i = 0, index = 1; i < meta[0]; ++i) {
+        const int *contour = &meta[index];
+        int nsegments = contour[1];
+        index += 2 + 2 * nsegments;
+
+        if (__is_degenerate(contour)) {
+            for (int j = 0; j < nsegments; ++j)
+                point += contour[2 * j + 3] - 1;
+            point += 1;
+            continue;
+        }
+
+        GLfloat *table = &s->segments[SERIALIZER_SEGMENT_SIZE * s->segment_size];
+        for (int j = 0; j < nsegments; ++j) {
+            GLfloat *entry = &table[SERIALIZER_SEGMENT_SIZE * j];
+            int color = contour[2 * j + 2];
+            int npoints = contour[2 * j + 3];
+
+            vec2 start = normalize(segment_direction(&outline[point], npoints, 0));
+            vec2 end = normalize(segment_direction(&outline[point], npoints, 1));
+
+            entry[0] = (GLfloat)point;
+            entry[1] = (GLfloat)npoints;
+            entry[2] = (GLfloat)color;
+            entry[3] = (GLfloat)(ncontours << 1 | (contour[0] > 0));
+            entry[4] = start.x;
+            entry[5] = start.y;
+            entry[6] = end.x;
+            entry[7] = end.y;
+
+            point += npoints - 1;
+        }
+        point += 1;
+        /* Directions of the neighbours at the shared end points. */
+        for (int j = 0; j < nsegments; ++j) {
+            GLfloat *entry = &table[SERIALIZER_SEGMENT_SIZE * j];
+            const GLfloat *prev =
+                &table[SERIALIZER_SEGMENT_SIZE * ((j + nsegments - 1) % nsegments)];
+            const GLfloat *next = &table[SERIALIZER_SEGMENT_SIZE * ((j + 1) % nsegments)];
+
+            entry[8] = prev[6];
+            entry[9] = prev[7];
+            entry[10] = next[4];
+            entry[11] = next[5];
+        }
+        s->segment_size += nsegments;
+        ++ncontours;
+    }
+    return __encode_grid(s, first, (int)(s->segment_size - first));
+}
+
+/* A line of a flattened outline. */
+typedef struct {
+    vec2 a;
+    vec2 b;
+    int contour;
+    int segment;
+    int nsegments;
+} __piece;
+
+static float __point_line_distance(vec2 p, vec2 a, vec2 b) {
+    vec2 ab = subt(b, a), ap = subt(p, a);
+    float t = dot(ab, ab) > 0 ? dot(ap, ab) / dot(ab, ab) : 0;
+    t = t < 0 ? 0 : t > 1 ? 1 : t;
+    return length(subt(ap, (vec2){ab.x * t, ab.y * t}));
+}
+
+/* Whether two pieces are of the same or of neighbouring segments, which meet
+   and do not make the glyph thin. */
+static bool __adjacent(const __piece *a, const __piece *b) {
+    if (a->contour != b->contour)
+        return false;
+    int d = abs(a->segment - b->segment);
+    return d <= 1 || d == a->nsegments - 1;
+}
+
+static int __bin(float v, float lo, float size, int n) {
+    int i = (int)((v - lo) / size);
+    return i < 0 ? 0 : i >= n ? n - 1 : i;
+}
+
+/* The closest approach of pieces which are not adjacent. The pieces are
+   binned into a grid of about one piece per cell, and each start point only
+   searches the rings of cells around it which may still be closer than the
+   closest approach found so far. */
+static int __thinnest(msdfgl_serializer_t *s, const __piece *pieces, size_t npieces,
+                      float *thinnest) {
+    vec2 lo = pieces[0].a, hi = pieces[0].a;
+    for (size_t i = 0; i < npieces; ++i) {
+        vec2 a = pieces[i].a, b = pieces[i].b;
+        lo.x = fminf(lo.x, fminf(a.x, b.x));
+        lo.y = fminf(lo.y, fminf(a.y, b.y));
+        hi.x = fmaxf(hi.x, fmaxf(a.x, b.x));
+        hi.y = fmaxf(hi.y, fmaxf(a.y, b.y));
+    }
+    int n = (int)ceilf(sqrtf((float)npieces));
+    float size = fmaxf(hi.x - lo.x, hi.y - lo.y) / n;
+    if (!(size > 0))
+        size = 1;
+    int nx = (int)((hi.x - lo.x) / size) + 1, ny = (int)((hi.y - lo.y) / size) + 1;
+    nx = nx < n ? nx : n;
+    ny = ny < n ? ny : n;
+    size_t ncells = (size_t)nx * ny;
+
+    /* The start of each cell's list, then the lists. A piece is listed in
+       every cell its box touches. */
+    if (__reserve((void **)&s->_bins, &s->_bins_alloc, ncells + 1, sizeof(int)))
+        return -1;
+    memset(s->_bins, 0, (ncells + 1) * sizeof(int));
+    for (size_t i = 0; i < npieces; ++i) {
+        vec2 a = pieces[i].a, b = pieces[i].b;
+        int x0 = __bin(fminf(a.x, b.x), lo.x, size, nx);
+        int x1 = __bin(fmaxf(a.x, b.x), lo.x, size, nx);
+        int y0 = __bin(fminf(a.y, b.y), lo.y, size, ny);
+        int y1 = __bin(fmaxf(a.y, b.y), lo.y, size, ny);
+        for (int y = y0; y <= y1; ++y)
+            for (int x = x0; x <= x1; ++x)
+                s->_bins[y * nx + x + 1]++;
+    }
+    for (size_t c = 1; c <= ncells; ++c)
+        s->_bins[c] += s->_bins[c - 1];
+    if (__reserve((void **)&s->_bins, &s->_bins_alloc, ncells + 1 + s->_bins[ncells],
+                  sizeof(int)))
+        return -1;
+
+    int *bins = s->_bins, *lists = &s->_bins[ncells + 1];
+    for (size_t i = 0; i < npieces; ++i) {
+        vec2 a = pieces[i].a, b = pieces[i].b;
+        int x0 = __bin(fminf(a.x, b.x), lo.x, size, nx);
+        int x1 = __bin(fmaxf(a.x, b.x), lo.x, size, nx);
+        int y0 = __bin(fminf(a.y, b.y), lo.y, size, ny);
+        int y1 = __bin(fmaxf(a.y, b.y), lo.y, size, ny);
+        for (int y = y0; y <= y1; ++y)
+            for (int x = x0; x <= x1; ++x)
+                lists[bins[y * nx + x]++] = (int)i;
+    }
+    /* Filling moved each start to the start of the next cell. */
+    memmove(&bins[1], bins, ncells * sizeof(int));
+    bins[0] = 0;
+
+    for (size_t i = 0; i < npieces; ++i) {
+        vec2 p = pieces[i].a;
+        int cx = __bin(p.x, lo.x, size, nx), cy = __bin(p.y, lo.y, size, ny);
+        /* Cells r rings away are at least r - 1 cells from p. */
+        for (int r = 0; (r < nx || r < ny) && (r - 1) * size < *thinnest; ++r) {
+            for (int y = cy - r; y <= cy + r; ++y) {
+                if (y < 0 || y >= ny)
+                    continue;
+                /* Only the ends of the rows inside the ring. */
+                int step = y == cy - r || y == cy + r ? 1 : 2 * r;
+                for (int x = cx - r; x <= cx + r; x += step) {
+                    if (x < 0 || x >= nx)
+                        continue;
+                    for (int k = bins[y * nx + x]; k < bins[y * nx + x + 1]; ++k) {
+                        const __piece *q = &pieces[lists[k]];
+                        if (__adjacent(&pieces[i], q))
+                            continue;
+                        float distance = __point_line_distance(p, q->a, q->b);
+                        *thinnest = distance < *thinnest ? distance : *thinnest;
+                    }
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+/* Measure the detail of a decomposed glyph, see SERIALIZER_DETAIL_TEXELS. The
+   thinnest part is the closest approach of segments which are not neighbours,
+   the radius of a curve is estimated from its chord and its sagitta. */
+static int __measure_detail(msdfgl_serializer_t *s, float *detail) {
+    const int *meta = s->_meta;
+    const vec2 *point = (const vec2 *)s->_outline;
+
+    if (__reserve((void **)&s->_pieces, &s->_pieces_alloc,
+                  (s->_meta_size / 2 + 1) * SERIALIZER_DETAIL_STEPS, sizeof(__piece)))
         return -1;
+    __piece *pieces = (__piece *)s->_pieces;
+    size_t npieces = 0;
+
+    float thinnest = INFINITY, tightest = INFINITY;
+    int ncontours = meta[0];
+    size_t m = 1;
+    for (int c = 0; c < ncontours; ++c) {
+        m++; /* Winding */
+        int nsegments = meta[m++];
+        for (int j = 0; j < nsegments; ++j) {
+            m++; /* Color */
+            int npoints = meta[m++];
+            for (int k = 0; k < SERIALIZER_DETAIL_STEPS; ++k) {
+                __piece *piece = &pieces[npieces++];
+                piece->a = segment_point(point, npoints, (float)k / SERIALIZER_DETAIL_STEPS);
+                piece->b = segment_point(point, npoints,
+                                         (float)(k + 1) / SERIALIZER_DETAIL_STEPS);
+                piece->contour = c;
+                piece->segment = j;
+                piece->nsegments = nsegments;
+            }
+
+            if (npoints > 2) {
+                vec2 chord = subt(point[npoints - 1], point[0]);
+                vec2 middle = subt(segment_point(point, npoints, 0.5f), point[0]);
+                float l = length(chord);
+                float h = l > 0 ? fabsf(cross(chord, middle)) / l : length(middle);
+                if (h > 0) {
+                    float radius = l * l / (8 * h) + h / 2;
+                    tightest = radius < tightest ? radius : tightest;
+                }
+            }
+            point += npoints - 1;
+        }
+        point += 1;
+    }
+
+    if (npieces && __thinnest(s, pieces, npieces, &thinnest))
+        return -1;
+
+    float thin = thinnest > 0 ? SERIALIZER_DETAIL_TEXELS / thinnest : INFINITY;
+    float curve = SERIALIZER_CURVE_TEXELS / tightest;
+    *detail = thin > curve ? thin : curve;
+    return 0;
+}
+
+int msdfgl_serialize_glyph(FT_Face face, FT_UInt glyph, msdfgl_serializer_t *s,
+                           size_t *meta_offset, size_t *point_offset,
+                           size_t *segment_offset, float *detail) {
+
+    *meta_offset = s->meta_size;
+    *point_offset = s->point_size;
+    *segment_offset = s->segment_size;
+    *detail = 0;
+
+    /* Every glyph gets at least the grid size, so that failed glyphs are
+       serialized as empty ones. */
+    if (__reserve_meta(s, 1))
+        return -1;
+
+    s->_meta_size = 0;
+    if (__reserve_glyph_meta(s, 1))
+        goto error;
+    s->_meta[s->_meta_size++] = 0;
+
+    if (FT_Load_Glyph(face, glyph, FT_LOAD_NO_SCALE))
+        goto error;
 
     FT_Outline_Funcs fns;
     fns.shift = 0;
@@ -200,18 +919,47 @@ int msdfgl_serialize_glyph(FT_Face face, int code, char *meta_buffer,
     fns.move_to = __add_contour;
     fns.line_to = __add_linear;
     fns.conic_to = __add_quad;
-    fns.cubic_to = 0;
+    fns.cubic_to = __add_cubic;
 
     struct __glyph_data_ctx ctx;
-    ctx.meta_buffer = meta_buffer;
-    ctx.meta_index = 1;
-    ctx.meta_buffer[0] = 0;
-    /* Start 1 before the actual buffer. The pointer is moved in the move_to callback. 
-       FT_Outline_Decompose does not have a callback for finishing a contour. */
-    ctx.segment = ((vec2 *)&point_buffer[0]) - 1;
+    ctx.s = s;
+    /* Start 1 before the first point of the outline. The index is moved in the
+       move_to callback. FT_Outline_Decompose does not have a callback for
+       finishing a contour. */
+    ctx.segment = (size_t)-1;
 
     if (FT_Outline_Decompose(&face->glyph->outline, &fns, &ctx))
-        return -1;
+        goto error;
+    size_t npoints = ctx.segment + 1;
+
+    if (s->tolerance > 0 && __simplify_glyph(s, &npoints))
+        goto error;
+
+    if (__finalize_glyph(s) || __encode_glyph(s) || __reserve_points(s, npoints))
+        goto error;
+    if (s->measure_detail && __measure_detail(s, detail))
+        goto error;
+
+    const vec2 *outline = (const vec2 *)s->_outline;
+    for (size_t i = 0; i < npoints; ++i) {
+        s->points[2 * s->point_size] = __pack(outline[i].x);
+        s->points[2 * s->point_size + 1] = __pack(outline[i].y);
+        s->point_size++;
+    }
+    return 0;
+
+error:
+    s->meta_size = *meta_offset + 1;
+    s->meta[*meta_offset] = 0;
+    s->point_size = *point_offset;
+    s->segment_size = *segment_offset;
+    return -1;
+}
+
+/* Calculate the windings and the edge coloring of a decomposed glyph. */
+static int __finalize_glyph(msdfgl_serializer_t *s) {
+    int *meta_buffer = s->_meta;
+    GLfloat *point_buffer = (GLfloat *)s->_outline;
 
     /* Calculate windings. */
     int meta_index = 0;
@@ -252,7 +1000,7 @@ int msdfgl_serialize_glyph(FT_Face face, int code, char *meta_buffer,
             point_ptr += npoints - 1;
             meta_index += 2;
         } else {
-            int prev_npoints = meta_buffer[meta_index + 2 * (nsegments - 2) + 1];
+            int prev_npoints = meta_buffer[meta_index + 2 * (nsegments - 1) + 1];
             vec2 *prev_ptr = point_ptr;
             for (int j = 0; j < nsegments - 1; ++j) {
                 int _npoints = meta_buffer[meta_index + 2 * j + 1];
@@ -275,6 +1023,20 @@ int msdfgl_serialize_glyph(FT_Face face, int code, char *meta_buffer,
         meta_buffer[winding_index] = total > 0 ? 2 : 0;
     }
 
+    if (s->single_channel) {
+        meta_index = 0;
+        ncontours = meta_buffer[meta_index++];
+        for (int i = 0; i < ncontours; ++i) {
+            meta_index++; /* Winding */
+            int nsegments = meta_buffer[meta_index++];
+            for (int j = 0; j < nsegments; ++j) {
+                meta_buffer[meta_index++] = WHITE;
+                meta_index++; /* npoints */
+            }
+        }
+        return 0;
+    }
+
     /* Calculate coloring */
     float cross_threshold = (float)sin(3.0);
     unsigned long long seed = 0;
@@ -282,20 +1044,25 @@ int msdfgl_serialize_glyph(FT_Face face, int code, char *meta_buffer,
     meta_index = 0;
     point_ptr = (vec2 *)&point_buffer[0];
 
-    int corners[30];
     int len_corners = 0;
 
     ncontours = meta_buffer[meta_index++];
     for (int i = 0; i < ncontours; ++i) {
         meta_index++; /* Winding */
         int nsegments = meta_buffer[meta_index++];
+
+        /* At most one corner per segment. */
+        if (__reserve((void **)&s->_corners, &s->_corners_alloc, nsegments ? nsegments : 1,
+                      sizeof(int)))
+            return -1;
+        int *corners = (int *)s->_corners;
         int _meta = meta_index;
         vec2 *_point = point_ptr;
 
         len_corners = 0; /*clear*/
 
         if (nsegments) {
-            int prev_npoints = meta_buffer[meta_index + 2 * (nsegments - 2) + 1];
+            int prev_npoints = meta_buffer[meta_index + 2 * (nsegments - 1) + 1];
             vec2 *prev_ptr = point_ptr;
             for (int j = 0; j < nsegments - 1; ++j)
                 prev_ptr += (meta_buffer[meta_index + 2 * j + 1] - 1);
@@ -340,7 +1107,7 @@ int msdfgl_serialize_glyph(FT_Face face, int code, char *meta_buffer,
                 for (int i = 0; i < m; ++i) {
                     enum Color c =
                         (colors + 1)[(int)(3 + 2.875 * i / (m - 1) - 1.4375 + .5) - 3];
-                    meta_buffer[meta_index + 2 * ((corner + i) % m)] = (char)c;
+                    meta_buffer[meta_index + 2 * ((corner + i) % m)] = c;
                 }
             } else if (nsegments >= 1) {
                 /* TODO: whoa, split in thirds and stuff */
@@ -364,7 +1131,7 @@ int msdfgl_serialize_glyph(FT_Face face, int code, char *meta_buffer,
                         (enum Color)((spline == corner_count - 1) * initial_color);
                     switch_color(&color, &seed, &banned);
                 }
-                meta_buffer[meta_index + 2 * index] = (char)color;
+                meta_buffer[meta_index + 2 * index] = color;
             }
         }
 
@@ -378,6 +1145,5 @@ int msdfgl_serialize_glyph(FT_Face face, int code, char *meta_buffer,
         }
         point_ptr += 1;
     }
-
     return 0;
 }
@@ -4,12 +4,155 @@
 
 #include "msdfgl.h"
 
+/**
+ * Outlines are processed in font units divided by SERIALIZER_SCALE, but
+ * uploaded in whole font units.
+ */
 #define SERIALIZER_SCALE 64.0f
+#define SERIALIZER_INITIAL_SIZE 4096
 
-int msdfgl_glyph_buffer_size(FT_Face face, int code, size_t *meta_size,
-                             size_t *point_size);
+/**
+ * Floats per segment table entry, three RGBA texels.
+ */
+#define SERIALIZER_SEGMENT_SIZE 12
 
-int msdfgl_serialize_glyph(FT_Face face, int code, char *meta_buffer,
-                           GLfloat *point_buffer);
+/**
+ * Words before the cells of a glyph's grid, and most cells per side.
+ */
+#define SERIALIZER_GRID_HEADER 6
+#define SERIALIZER_GRID_MAX 16
+
+/**
+ * Detail of a glyph, the smallest scale keeping its shape: the thinnest part
+ * spans SERIALIZER_DETAIL_TEXELS texels, and the tightest curve has a radius of
+ * SERIALIZER_CURVE_TEXELS texels, at which bilinear filtering follows it
+ * within a sixteenth of a texel. Segments are flattened into
+ * SERIALIZER_DETAIL_STEPS lines to measure it.
+ */
+#define SERIALIZER_DETAIL_TEXELS 3.0f
+#define SERIALIZER_CURVE_TEXELS 2.0f
+#define SERIALIZER_DETAIL_STEPS 4
+
+/**
+ * Growable arena for serialized glyph data. Glyphs are appended one after
+ * another, and the arena can be reused between batches without reallocating.
+ *
+ * The metadata of a glyph is a coarse grid over the area generated for it,
+ * a stream of 32-bit words uploaded as GL_R32UI:
+ *
+ *     n, origin x, origin y, cell width, cell height, reach
+ *     per cell, row by row: first list word, nsegments << 3 | around << 1 | inside
+ *     the lists, segment indices relative to the glyph
+ *
+ * The grid has n by n cells, and the floats are stored as their bits. The
+ * list of a cell has every segment which may be within `reach` of the cell,
+ * in table order, and list words are relative to the glyph's metadata. A
+ * pixel whose nearest listed segment is further than `reach`, less its
+ * distance from the cell, has no segment close enough to matter. It is then
+ * inside the glyph if the cell is. A glyph without segments has just n = 0.
+ *
+ * Contours around the cell with no listed segment are as far, and still fill
+ * the cell where other contours overlap them. `around` is 1 if they wind
+ * positively in sum, 2 if negatively and 0 otherwise.
+ *
+ * The segments of all contours follow each other in the segment table,
+ * uploaded as GL_RGBA32F, three texels per segment:
+ *
+ *     first point (relative to the glyph), npoints, color,
+ *         contour << 1 | positive winding
+ *     direction at the start, direction at the end
+ *     direction of the previous segment at its end, of the next at its start
+ *
+ * The directions are normalized. Everything the generator needs to know
+ * about a segment's place in its contour is in its entry, and degenerate
+ * contours are left out altogether. Contours are numbered from zero in
+ * each glyph.
+ */
+typedef struct _msdfgl_serializer {
+    /**
+     * Segment grids, `meta_size` words in use.
+     */
+    GLuint *meta;
+    size_t meta_size;
+    size_t meta_alloc;
+
+    /**
+     * Point data as (x, y) pairs of font units for a GL_RG16I buffer,
+     * `point_size` points in use.
+     */
+    GLshort *points;
+    size_t point_size;
+    size_t point_alloc;
+
+    /**
+     * Segment table, `segment_size` entries in use.
+     */
+    GLfloat *segments;
+    size_t segment_size;
+    size_t segment_alloc;
+
+    /**
+     * If positive, outlines are simplified: flat curves become lines, runs of
+     * collinear lines are merged and segments and contours smaller than the
+     * tolerance are removed. In the same units as the points.
+     */
+    float tolerance;
+
+    /**
+     * Distance range of the generated fields, how far segments reach in the
+     * grid. In the same units as the points.
+     */
+    float range;
+
+    /**
+     * If set, edges are not colored but all white, for single-channel
+     * distance fields.
+     */
+    int single_channel;
+
+    /**
+     * If set, the detail of glyphs is measured, see SERIALIZER_DETAIL_TEXELS.
+     */
+    int measure_detail;
+
+    /* Metadata and outline of the glyph being serialized, in an unpacked form
+       with an int per value. */
+    int *_meta;
+    size_t _meta_size;
+    size_t _meta_alloc;
+    void *_outline;
+    size_t _outline_alloc;
+
+    /* Scratch space for simplification, edge coloring and detail. */
+    void *_segments;
+    size_t _segments_alloc;
+    void *_corners;
+    size_t _corners_alloc;
+    void *_pieces;
+    size_t _pieces_alloc;
+    int *_bins;
+    size_t _bins_alloc;
+} msdfgl_serializer_t;
+
+void msdfgl_serializer_init(msdfgl_serializer_t *s);
+
+/**
+ * Forget the serialized glyphs but keep the allocated memory.
+ */
+void msdfgl_serializer_reset(msdfgl_serializer_t *s);
+
+void msdfgl_serializer_destroy(msdfgl_serializer_t *s);
+
+/**
+ * Load and decompose a glyph once, appending its data to the arena. The
+ * offsets of the glyph's metadata (in words), points (in points) and segment
+ * table (in entries) are written to `meta_offset`, `point_offset` and
+ * `segment_offset`, and its detail to `detail` (0 if it is not measured or
+ * the glyph has no segments). A glyph which fails to load is serialized as an
+ * empty glyph and -1 is returned.
+ */
+int msdfgl_serialize_glyph(FT_Face face, FT_UInt glyph, msdfgl_serializer_t *s,
+                           size_t *meta_offset, size_t *point_offset,
+                           size_t *segment_offset, float *detail);
 
 #endif  /* MSDFGL_SERIALIZER_H */
@@ -0,0 +1,225 @@
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "msdfgl_worker.h"
+
+void msdfgl_workers_init(msdfgl_workers_t *w, FT_Face face, const FT_Open_Args *source) {
+    w->nactive = 0;
+    w->nallocated = 0;
+    memset(&w->source, 0, sizeof(FT_Open_Args));
+
+    if (!(w->workers = calloc(1, sizeof(msdfgl_worker_t))))
+        return;
+    w->nallocated = 1;
+
+    /* The first worker borrows the font's face, it is not owned by us. */
+    w->workers[0].library = NULL;
+    w->workers[0].face = face;
+    msdfgl_serializer_init(&w->workers[0].serializer);
+
+    if (source)
+        w->source = *source;
+}
+
+int msdfgl_workers_default_count(void) {
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#else
+    return 1;
+#endif
+}
+
+/**
+ * Serialize a glyph into `s`. A glyph which fails to load is left empty, and
+ * gets no metrics instead of those of the glyph the face loaded before it.
+ */
+static void __worker_serialize(FT_Face face, msdfgl_serializer_t *s, int32_t glyph,
+                               msdfgl_serialized_glyph_t *g) {
+    if (msdfgl_serialize_glyph(face, glyph, s, &g->meta_offset, &g->point_offset,
+                               &g->segment_offset, &g->detail))
+        memset(&g->metrics, 0, sizeof(FT_Glyph_Metrics));
+    else
+        g->metrics = face->glyph->metrics;
+    g->nsegments = (int)(s->segment_size - g->segment_offset);
+}
+
+static void __worker_run(msdfgl_worker_t *worker) {
+    msdfgl_serializer_reset(&worker->serializer);
+
+    for (int i = 0; i < worker->nglyphs; ++i)
+        __worker_serialize(worker->face, &worker->serializer, worker->glyphs[i],
+                           &worker->out[i]);
+    worker->status = 0;
+}
+
+#ifdef MSDFGL_THREADS
+static int __worker_open_face(msdfgl_workers_t *w, msdfgl_worker_t *worker) {
+    if (worker->face)
+        return 0;
+
+    if (FT_Init_FreeType(&worker->library))
+        return -1;
+
+    if (FT_Open_Face(worker->library, &w->source, 0, &worker->face)) {
+        FT_Done_FreeType(worker->library);
+        worker->library = NULL;
+        worker->face = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+static void *__worker_thread(void *user) {
+    msdfgl_worker_t *worker = (msdfgl_worker_t *)user;
+    __worker_run(worker);
+    return NULL;
+}
+#endif
+
+int msdfgl_workers_serialize(msdfgl_workers_t *w, int nthreads, float tolerance,
+                             float range, int single_channel, int measure_detail,
+                             const int32_t *glyphs, int n, msdfgl_serialized_glyph_t *out) {
+    if (!w->nallocated)
+        return -1;
+
+    int nworkers = 1;
+#ifdef MSDFGL_THREADS
+    if (w->source.flags) {
+        nworkers = (n + MSDFGL_WORKER_MIN_CHUNK - 1) / MSDFGL_WORKER_MIN_CHUNK;
+        nworkers = nworkers < nthreads ? nworkers : nthreads;
+        nworkers = nworkers > 1 ? nworkers : 1;
+    }
+#endif
+
+    if (nworkers > w->nallocated) {
+        msdfgl_worker_t *new = realloc(w->workers, nworkers * sizeof(msdfgl_worker_t));
+        if (new) {
+            memset(&new[w->nallocated], 0,
+                   (nworkers - w->nallocated) * sizeof(msdfgl_worker_t));
+            for (int i = w->nallocated; i < nworkers; ++i)
+                msdfgl_serializer_init(&new[i].serializer);
+            w->workers = new;
+            w->nallocated = nworkers;
+        } else {
+            nworkers = w->nallocated;
+        }
+    }
+
+    /* Split the batch into contiguous chunks, one per worker. */
+    for (int i = 0; i < nworkers; ++i) {
+        msdfgl_worker_t *worker = &w->workers[i];
+        int first = (int)((long long)n * i / nworkers);
+        int last = (int)((long long)n * (i + 1) / nworkers);
+
+        worker->glyphs = &glyphs[first];
+        worker->nglyphs = last - first;
+        worker->out = &out[first];
+        worker->status = -1;
+        worker->started = 0;
+        worker->serializer.tolerance = tolerance;
+        worker->serializer.range = range;
+        worker->serializer.single_channel = single_channel;
+        worker->serializer.measure_detail = measure_detail;
+
+        for (int j = first; j < last; ++j)
+            out[j].worker = i;
+    }
+
+#ifdef MSDFGL_THREADS
+    for (int i = 1; i < nworkers; ++i) {
+        msdfgl_worker_t *worker = &w->workers[i];
+        worker->started = !__worker_open_face(w, worker) &&
+                          !pthread_create(&worker->thread, NULL, __worker_thread, worker);
+    }
+#endif
+
+    __worker_run(&w->workers[0]);
+
+#ifdef MSDFGL_THREADS
+    for (int i = 1; i < nworkers; ++i) {
+        if (w->workers[i].started)
+            pthread_join(w->workers[i].thread, NULL);
+    }
+#endif
+
+    /* Chunks whose thread could not be started are serialized here, into the
+       arena of the first worker. */
+    for (int i = 1; i < nworkers; ++i) {
+        msdfgl_worker_t *worker = &w->workers[i];
+        if (!worker->status)
+            continue;
+
+        msdfgl_serializer_reset(&worker->serializer);
+        for (int j = 0; j < worker->nglyphs; ++j) {
+            __worker_serialize(w->workers[0].face, &w->workers[0].serializer,
+                               worker->glyphs[j], &worker->out[j]);
+            worker->out[j].worker = 0;
+        }
+    }
+    w->nactive = nworkers;
+
+    /* Rebase the offsets onto the concatenation of the arenas. */
+    w->workers[0].meta_base = 0;
+    w->workers[0].point_base = 0;
+    w->workers[0].segment_base = 0;
+    for (int i = 1; i < nworkers; ++i) {
+        msdfgl_worker_t *prev = &w->workers[i - 1];
+        w->workers[i].meta_base = prev->meta_base + prev->serializer.meta_size;
+        w->workers[i].point_base = prev->point_base + prev->serializer.point_size;
+        w->workers[i].segment_base = prev->segment_base + prev->serializer.segment_size;
+    }
+    for (int i = 0; i < n; ++i) {
+        out[i].meta_offset += w->workers[out[i].worker].meta_base;
+        out[i].point_offset += w->workers[out[i].worker].point_base;
+        out[i].segment_offset += w->workers[out[i].worker].segment_base;
+    }
+
+    return 0;
+}
+
+size_t msdfgl_workers_meta_size(msdfgl_workers_t *w) {
+    size_t size = 0;
+    for (int i = 0; i < w->nactive; ++i)
+        size += w->workers[i].serializer.meta_size;
+    return size;
+}
+
+size_t msdfgl_workers_point_size(msdfgl_workers_t *w) {
+    size_t size = 0;
+    for (int i = 0; i < w->nactive; ++i)
+        size += w->workers[i].serializer.point_size;
+    return size;
+}
+
+size_t msdfgl_workers_segment_size(msdfgl_workers_t *w) {
+    size_t size = 0;
+    for (int i = 0; i < w->nactive; ++i)
+        size += w->workers[i].serializer.segment_size;
+    return size;
+}
+
+void msdfgl_workers_destroy(msdfgl_workers_t *w) {
+    for (int i = 0; i < w->nallocated; ++i) {
+        msdfgl_worker_t *worker = &w->workers[i];
+        if (worker->library) {
+            FT_Done_Face(worker->face);
+            FT_Done_FreeType(worker->library);
+        }
+        msdfgl_serializer_destroy(&worker->serializer);
+    }
+    if (w->workers)
+        free(w->workers);
+    w->workers = NULL;
+    w->nallocated = 0;
+    w->nactive = 0;
+}
@@ -0,0 +1,117 @@
+#ifndef MSDFGL_WORKER_H
+#define MSDFGL_WORKER_H
+
+/**
+ * Parallel glyph serialization.
+ *
+ * The glyphs of a batch are split into contiguous chunks. Each chunk is
+ * serialized by its own thread into its own arena. Every worker thread has
+ * a private FT_Library and FT_Face opened on the same font data, since
+ * FreeType faces must not be shared between threads. The first chunk is
+ * serialized on the calling thread with the font's own face.
+ */
+
+#ifdef MSDFGL_THREADS
+#include <pthread.h>
+#endif
+
+#include "msdfgl_serializer.h"
+
+/**
+ * Smallest amount of glyphs worth handing to a thread of its own.
+ */
+#define MSDFGL_WORKER_MIN_CHUNK 32
+
+typedef struct _msdfgl_serialized_glyph {
+    /**
+     * Offsets of the glyph data in the concatenation of the worker arenas.
+     */
+    size_t meta_offset;
+    size_t point_offset;
+    size_t segment_offset;
+
+    FT_Glyph_Metrics metrics;
+    int nsegments;
+
+    /**
+     * Smallest scale keeping the glyph's shape, if measured.
+     */
+    float detail;
+
+    /* Worker whose arena holds the glyph. */
+    int worker;
+} msdfgl_serialized_glyph_t;
+
+typedef struct _msdfgl_worker {
+    FT_Library library;
+    FT_Face face;
+    msdfgl_serializer_t serializer;
+
+    /* The chunk of the current batch. */
+    const int32_t *glyphs;
+    int nglyphs;
+    msdfgl_serialized_glyph_t *out;
+    int status;
+
+    /**
+     * Offsets of this worker's arena in the concatenation of all arenas.
+     */
+    size_t meta_base;
+    size_t point_base;
+    size_t segment_base;
+
+    int started;
+#ifdef MSDFGL_THREADS
+    pthread_t thread;
+#endif
+} msdfgl_worker_t;
+
+typedef struct _msdfgl_workers {
+    msdfgl_worker_t *workers;
+    int nallocated;
+
+    /**
+     * Amount of workers whose arenas hold data from the last batch.
+     */
+    int nactive;
+
+    /**
+     * Where the worker faces are opened from.
+     */
+    FT_Open_Args source;
+} msdfgl_workers_t;
+
+/**
+ * Set up the workers of a font. `face` is used on the calling thread, and
+ * `source` is used to open a face for each additional thread. A NULL source
+ * disables threading for the font.
+ */
+void msdfgl_workers_init(msdfgl_workers_t *w, FT_Face face, const FT_Open_Args *source);
+
+/**
+ * Serialize `n` glyphs using up to `nthreads` threads. Outlines are simplified
+ * with `tolerance` if it is positive, segment grids are built for `range`,
+ * edges are left uncolored for `single_channel` fields and the detail of the
+ * glyphs is measured if `measure_detail` is set, see msdfgl_serializer_t.
+ * Returns 0 on success.
+ */
+int msdfgl_workers_serialize(msdfgl_workers_t *w, int nthreads, float tolerance,
+                             float range, int single_channel, int measure_detail,
+                             const int32_t *glyphs, int n, msdfgl_serialized_glyph_t *out);
+
+/**
+ * Total amount of metadata (in words), points and segment table entries
+ * serialized in the last batch.
+ */
+size_t msdfgl_workers_meta_size(msdfgl_workers_t *w);
+size_t msdfgl_workers_point_size(msdfgl_workers_t *w);
+size_t msdfgl_workers_segment_size(msdfgl_workers_t *w);
+
+/**
+ * Amount of usable hardware threads.
+ */
+int msdfgl_workers_default_count(void);
+
+void msdfgl_workers_destroy(msdfgl_workers_t *w);
+
+#endif /* MSDFGL_WORKER_H */
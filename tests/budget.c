@@ -0,0 +1,129 @@
+#include "test.h"
+
+/**
+ * Draws two lines of text in turn on an atlas with a budget which holds
+ * either of them but not both, so that each batch evicts glyphs of the other
+ * line while its own glyphs are being placed. The text must come out the
+ * same as from an atlas without a budget, cycle after cycle.
+ *
+ * With msdfgl_atlas_next_frame, both lines drawn in one frame are kept, so
+ * the second one only fits on the atlas from the next frame on. Drawing
+ * both lines at once through the missing-glyph callback leaves out what does
+ * not fit, and the atlas still draws either line right in the next frame.
+ *
+ * Without a budget, a batch which fails on a glyph too wide for the atlas
+ * gives back the space of the glyphs it placed before.
+ */
+
+#define WIDTH 512
+#define BUDGET (WIDTH * 256 * 16)
+#define NCYCLES 4
+/* Narrower than an em dash. */
+#define NARROW_WIDTH 64
+
+static const char *lines[] = {
+    "the quick brown fox jumps over a lazy dog",
+    "THE QUICK BROWN FOX JUMPS OVER A LAZY DOG",
+};
+static const char *both_lines =
+    "the quick brown fox jumps over a lazy dog THE QUICK BROWN FOX JUMPS OVER A LAZY DOG";
+
+int main(int argc, char *argv[]) {
+    if (argc < 2)
+        return TEST_SKIP;
+
+    int retval = 1;
+    test_egl egl;
+    msdfgl_context_t ctx = NULL;
+    msdfgl_atlas_t atlas = NULL, reference_atlas = NULL, narrow_atlas = NULL;
+    msdfgl_font_t font = NULL, reference = NULL, narrow = NULL;
+    unsigned char *pixels = malloc(TEST_WIDTH * TEST_HEIGHT * 4);
+    unsigned char *expected = malloc(TEST_WIDTH * TEST_HEIGHT * 4);
+    int32_t codes[64];
+
+    if (test_create_egl(&egl, 3, 3)) {
+        retval = TEST_SKIP;
+        goto error;
+    }
+    CHECK(pixels && expected);
+    CHECK(ctx = msdfgl_create_context("330 core"));
+
+    CHECK(reference_atlas = msdfgl_create_atlas(ctx, WIDTH, 2));
+    CHECK(reference = msdfgl_load_font(ctx, argv[1], 4.0, 2.0, reference_atlas));
+    CHECK(atlas = msdfgl_create_atlas(ctx, WIDTH, 2));
+    CHECK(!msdfgl_set_atlas_budget(atlas, BUDGET));
+    CHECK(font = msdfgl_load_font(ctx, argv[1], 4.0, 2.0, atlas));
+
+    for (int cycle = 0; cycle < NCYCLES; ++cycle) {
+        for (size_t line = 0; line < 2; ++line) {
+            int n = (int)test_codepoints(lines[line], codes);
+            CHECK(msdfgl_generate_glyph_list(reference, codes, n) >= 0);
+            CHECK(!test_draw(reference, lines[line], expected));
+
+            CHECK(msdfgl_generate_glyph_list(font, codes, n) >= 0);
+            CHECK(!test_draw(font, lines[line], pixels));
+            /* The atlases differ in size, so the texture coordinates of
+               a glyph may round differently. */
+            if (test_compare(pixels, expected, TEST_WIDTH * TEST_HEIGHT * 4, 2)) {
+                fprintf(stderr, "line %zu differs at cycle %d\n", line, cycle);
+                goto error;
+            }
+        }
+    }
+
+    msdfgl_atlas_next_frame(atlas);
+    int n = (int)test_codepoints(lines[0], codes);
+    CHECK(msdfgl_generate_glyph_list(font, codes, n) >= 0);
+    CHECK(!test_draw(font, lines[0], pixels));
+    n = (int)test_codepoints(lines[1], codes);
+    CHECK(msdfgl_generate_glyph_list(font, codes, n) < 0);
+
+    msdfgl_atlas_next_frame(atlas);
+    CHECK(msdfgl_generate_glyph_list(font, codes, n) >= 0);
+    CHECK(!test_draw(font, lines[1], pixels));
+    CHECK(!test_draw(reference, lines[1], expected));
+    CHECK(!test_compare(pixels, expected, TEST_WIDTH * TEST_HEIGHT * 4, 2));
+
+    /* Generating glyphs unbinds the framebuffer of the test, so they are
+       generated by msdfgl_geometry before drawing in the same frame. */
+    msdfgl_set_missing_glyph_callback(ctx, msdfgl_generate_glyph, NULL);
+    float x = 0.0f, y = 0.0f, reference_x = 0.0f;
+    msdfgl_geometry(&reference_x, &y, reference, 18.0f, 0, both_lines);
+    msdfgl_atlas_next_frame(atlas);
+    msdfgl_geometry(&x, &y, font, 18.0f, 0, both_lines);
+    CHECK(x > 0.0f && x < reference_x);
+    CHECK(!test_draw(font, both_lines, pixels));
+
+    msdfgl_atlas_next_frame(atlas);
+    CHECK(!test_draw(font, lines[0], pixels));
+    CHECK(!test_draw(reference, lines[0], expected));
+    CHECK(!test_compare(pixels, expected, TEST_WIDTH * TEST_HEIGHT * 4, 2));
+
+    int32_t wide[] = {'A', 0x2014};
+    CHECK(narrow_atlas = msdfgl_create_atlas(ctx, NARROW_WIDTH, 2));
+    CHECK(narrow = msdfgl_load_font(ctx, argv[1], 4.0, 2.0, narrow_atlas));
+    CHECK(msdfgl_generate_glyph_list(narrow, wide, 2) < 0);
+    CHECK(msdfgl_atlas_fill_ratio(narrow_atlas) == 0.0f);
+    CHECK(msdfgl_generate_glyph_list(narrow, wide, 1) == 1);
+    retval = 0;
+
+error:
+    if (narrow)
+        msdfgl_destroy_font(narrow);
+    if (font)
+        msdfgl_destroy_font(font);
+    if (reference)
+        msdfgl_destroy_font(reference);
+    if (narrow_atlas)
+        msdfgl_destroy_atlas(narrow_atlas);
+    if (atlas)
+        msdfgl_destroy_atlas(atlas);
+    if (reference_atlas)
+        msdfgl_destroy_atlas(reference_atlas);
+    if (ctx)
+        msdfgl_destroy_context(ctx);
+    test_destroy_egl(&egl);
+    free(pixels);
+    free(expected);
+    return retval;
+}
@@ -0,0 +1,103 @@
+#include "test.h"
+
+/**
+ * Saves an atlas after a second font on it has been destroyed and the atlas
+ * compacted onto fewer pages, and restores it for the remaining font. The
+ * file must load, and draw the same text as the atlas it was saved from.
+ * Saving again replaces the file, and a failed save leaves it as it was.
+ * Fonts with another outline tolerance or adaptive scale do not match it.
+ */
+
+#define WIDTH 256
+#define PAGE_HEIGHT 128
+#define PATH "test_cache.atlas"
+
+static const char *text = "Sphinx of black quartz, judge my vow! 0123456789";
+
+int main(int argc, char *argv[]) {
+    if (argc < 2)
+        return TEST_SKIP;
+
+    int retval = 1;
+    test_egl egl;
+    msdfgl_context_t ctx = NULL;
+    msdfgl_atlas_t atlas = NULL, restored_atlas = NULL, stale_atlas = NULL;
+    msdfgl_font_t font = NULL, other = NULL, restored = NULL, stale = NULL;
+    unsigned char *pixels = malloc(TEST_WIDTH * TEST_HEIGHT * 4);
+    unsigned char *expected = malloc(TEST_WIDTH * TEST_HEIGHT * 4);
+
+    if (test_create_egl(&egl, 3, 3)) {
+        retval = TEST_SKIP;
+        goto error;
+    }
+    CHECK(pixels && expected);
+    CHECK(ctx = msdfgl_create_context("330 core"));
+
+    CHECK(atlas = msdfgl_create_atlas(ctx, WIDTH, 2));
+    CHECK(!msdfgl_set_atlas_page_height(atlas, PAGE_HEIGHT));
+    CHECK(font = msdfgl_load_font(ctx, argv[1], 4.0, 2.0, atlas));
+    CHECK(other = msdfgl_load_font(ctx, argv[1], 4.0, 3.0, atlas));
+    CHECK(msdfgl_generate_glyphs(other, 32, 126) >= 0);
+    CHECK(msdfgl_generate_glyphs(font, 32, 126) >= 0);
+    CHECK(!test_draw(font, text, expected));
+
+    msdfgl_destroy_font(other);
+    other = NULL;
+    CHECK(msdfgl_compact_atlas(atlas, 0) == 0);
+    CHECK(!test_draw(font, text, pixels));
+    CHECK(!test_compare(pixels, expected, TEST_WIDTH * TEST_HEIGHT * 4, 2));
+    CHECK(!msdfgl_save_atlas(atlas, &font, 1, PATH));
+
+    CHECK(restored_atlas = msdfgl_create_atlas(ctx, WIDTH, 2));
+    CHECK(!msdfgl_set_atlas_page_height(restored_atlas, PAGE_HEIGHT));
+    CHECK(restored = msdfgl_load_font(ctx, argv[1], 4.0, 2.0, restored_atlas));
+    CHECK(msdfgl_load_atlas(restored_atlas, &restored, 1, PATH) == 0);
+    CHECK(!test_draw(restored, text, pixels));
+    CHECK(!test_compare(pixels, expected, TEST_WIDTH * TEST_HEIGHT * 4, 2));
+
+    CHECK(!msdfgl_save_atlas(restored_atlas, &restored, 1, PATH));
+    CHECK(msdfgl_save_atlas(restored_atlas, &font, 1, PATH));
+    msdfgl_destroy_font(restored);
+    restored = NULL;
+    msdfgl_destroy_atlas(restored_atlas);
+    restored_atlas = NULL;
+    CHECK(restored_atlas = msdfgl_create_atlas(ctx, WIDTH, 2));
+    CHECK(!msdfgl_set_atlas_page_height(restored_atlas, PAGE_HEIGHT));
+    CHECK(restored = msdfgl_load_font(ctx, argv[1], 4.0, 2.0, restored_atlas));
+    CHECK(msdfgl_load_atlas(restored_atlas, &restored, 1, PATH) == 0);
+    CHECK(!test_draw(restored, text, pixels));
+    CHECK(!test_compare(pixels, expected, TEST_WIDTH * TEST_HEIGHT * 4, 2));
+
+    CHECK(stale_atlas = msdfgl_create_atlas(ctx, WIDTH, 2));
+    CHECK(!msdfgl_set_atlas_page_height(stale_atlas, PAGE_HEIGHT));
+    CHECK(stale = msdfgl_load_font(ctx, argv[1], 4.0, 2.0, stale_atlas));
+    msdfgl_set_outline_tolerance(stale, 0.25f);
+    CHECK(msdfgl_load_atlas(stale_atlas, &stale, 1, PATH) == 1);
+    msdfgl_set_outline_tolerance(stale, 0.0f);
+    msdfgl_set_adaptive_scale(stale, 1.0f, 2.0f);
+    CHECK(msdfgl_load_atlas(stale_atlas, &stale, 1, PATH) == 1);
+    retval = 0;
+
+error:
+    remove(PATH);
+    if (stale)
+        msdfgl_destroy_font(stale);
+    if (restored)
+        msdfgl_destroy_font(restored);
+    if (other)
+        msdfgl_destroy_font(other);
+    if (font)
+        msdfgl_destroy_font(font);
+    if (stale_atlas)
+        msdfgl_destroy_atlas(stale_atlas);
+    if (restored_atlas)
+        msdfgl_destroy_atlas(restored_atlas);
+    if (atlas)
+        msdfgl_destroy_atlas(atlas);
+    if (ctx)
+        msdfgl_destroy_context(ctx);
+    test_destroy_egl(&egl);
+    free(pixels);
+    free(expected);
+    return retval;
+}
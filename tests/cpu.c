@@ -0,0 +1,139 @@
+#define _POSIX_C_SOURCE 200112L
+#include <math.h>
+
+#include "test.h"
+
+/**
+ * A tolerance comparison of the CPU generator with the GPU: generates the same
+ * glyphs on the GPU and with MSDFGL_GENERATOR_CPU, onto two atlases of the
+ * same configuration, and compares the atlas textures. The GPU rounds its
+ * float arithmetic in its own way, so the bits differ, but the distances must
+ * match within TOLERANCE. The kernels test holds the CPU paths to the same
+ * bits. This is done on an OpenGL 3.3 context, where the GPU generates with
+ * the fragment shader, and on 4.3 with the compute shader if the driver has
+ * it. Mesa creates its newest version for any requested one, and is held to
+ * 3.3 by MESA_GL_VERSION_OVERRIDE.
+ */
+
+#define WIDTH 512
+#define TOLERANCE 1e-5f
+/* Where a pixel is as far from two edges, such as in the middle of a stem,
+   rounding picks either of them and a channel may take the other edge's
+   distance. The median, which text is drawn with, is the same. */
+#define MAX_TIES(ntexels) ((ntexels) / 10000)
+
+static const int versions[][2] = {{3, 3}, {4, 3}};
+
+static GLfloat *read_atlas(msdfgl_font_t font, GLint *width, GLint *height, GLint *depth) {
+    glBindTexture(GL_TEXTURE_2D_ARRAY, _msdfgl_atlas_texture(font));
+    glGetTexLevelParameteriv(GL_TEXTURE_2D_ARRAY, 0, GL_TEXTURE_WIDTH, width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D_ARRAY, 0, GL_TEXTURE_HEIGHT, height);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D_ARRAY, 0, GL_TEXTURE_DEPTH, depth);
+
+    GLfloat *texels = malloc((size_t)*width * *height * *depth * 4 * sizeof(GLfloat));
+    if (texels) {
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glGetTexImage(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA, GL_FLOAT, texels);
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    return texels;
+}
+
+/* The GPU rasterizes the quad of a glyph by pixel centers, and leaves the
+   last partial row and column of its bitmap empty. The CPU writes them, so
+   texels left empty by the GPU are not compared. */
+static float median(const GLfloat *d) {
+    float lo = d[0] < d[1] ? d[0] : d[1], hi = d[0] < d[1] ? d[1] : d[0];
+    return d[2] < lo ? lo : d[2] > hi ? hi : d[2];
+}
+
+static int compare_atlases(const GLfloat *gpu, const GLfloat *cpu, size_t ntexels) {
+    size_t ncompared = 0, nmedians = 0, nties = 0;
+    float max = 0;
+    for (size_t i = 0; i < ntexels; ++i) {
+        const GLfloat *a = &gpu[4 * i], *b = &cpu[4 * i];
+        if (a[0] == 0 && a[1] == 0 && a[2] == 0)
+            continue;
+        ++ncompared;
+        nmedians += fabsf(median(a) - median(b)) > TOLERANCE;
+
+        int tie = 0;
+        for (int c = 0; c < 3; ++c) {
+            float d = fabsf(a[c] - b[c]);
+            max = d > max ? d : max;
+            tie |= d > TOLERANCE;
+        }
+        nties += tie;
+    }
+    fprintf(stderr,
+            "%zu of %zu texels compared, %zu medians and %zu texels differ, by up to %g\n",
+            ncompared, ntexels, nmedians, nties, max);
+    return !ncompared || nmedians || nties > MAX_TIES(ncompared) ? -1 : 0;
+}
+
+static int run(const char *path, int major, int minor) {
+    int retval = 1;
+    test_egl egl;
+    msdfgl_context_t ctx = NULL;
+    msdfgl_atlas_t gpu_atlas = NULL, cpu_atlas = NULL;
+    msdfgl_font_t gpu = NULL, cpu = NULL;
+    GLfloat *gpu_texels = NULL, *cpu_texels = NULL;
+    GLint width, height, depth, cpu_width, cpu_height, cpu_depth;
+
+    if (major * 10 + minor < 43)
+        setenv("MESA_GL_VERSION_OVERRIDE", "3.3", 1);
+    else
+        unsetenv("MESA_GL_VERSION_OVERRIDE");
+    if (test_create_egl(&egl, major, minor)) {
+        retval = TEST_SKIP;
+        goto error;
+    }
+    fprintf(stderr, "OpenGL %s\n", glGetString(GL_VERSION));
+    CHECK(ctx = msdfgl_create_context("330 core"));
+
+    CHECK(gpu_atlas = msdfgl_create_atlas(ctx, WIDTH, 2));
+    CHECK(gpu = msdfgl_load_font(ctx, path, 4.0, 2.0, gpu_atlas));
+    CHECK(msdfgl_generate_glyphs(gpu, 32, 126) >= 0);
+
+    msdfgl_set_generator(ctx, MSDFGL_GENERATOR_CPU);
+    CHECK(cpu_atlas = msdfgl_create_atlas(ctx, WIDTH, 2));
+    CHECK(cpu = msdfgl_load_font(ctx, path, 4.0, 2.0, cpu_atlas));
+    CHECK(msdfgl_generate_glyphs(cpu, 32, 126) >= 0);
+
+    CHECK(gpu_texels = read_atlas(gpu, &width, &height, &depth));
+    CHECK(cpu_texels = read_atlas(cpu, &cpu_width, &cpu_height, &cpu_depth));
+    CHECK(glGetError() == GL_NO_ERROR);
+    CHECK(width == cpu_width && height == cpu_height && depth == cpu_depth);
+    CHECK(!compare_atlases(gpu_texels, cpu_texels, (size_t)width * height * depth));
+    retval = 0;
+
+error:
+    free(gpu_texels);
+    free(cpu_texels);
+    if (cpu)
+        msdfgl_destroy_font(cpu);
+    if (gpu)
+        msdfgl_destroy_font(gpu);
+    if (cpu_atlas)
+        msdfgl_destroy_atlas(cpu_atlas);
+    if (gpu_atlas)
+        msdfgl_destroy_atlas(gpu_atlas);
+    if (ctx)
+        msdfgl_destroy_context(ctx);
+    test_destroy_egl(&egl);
+    return retval;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2)
+        return TEST_SKIP;
+
+    int retval = TEST_SKIP;
+    for (size_t i = 0; i < sizeof(versions) / sizeof(versions[0]); ++i) {
+        int status = run(argv[1], versions[i][0], versions[i][1]);
+        if (status == 1)
+            return 1;
+        retval = status ? retval : 0;
+    }
+    return retval;
+}
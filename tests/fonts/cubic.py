@@ -0,0 +1,78 @@
+"""Writes cubic.otf, a font of cubic curves for the kernels test. Needs fontTools.
+
+'O' is a ring of four arcs, 'S' a stroke of S-bends, and 'C' a wedge whose
+curves have control points on top of their end points. 'L' has a curve which
+loops over itself.
+"""
+from fontTools.fontBuilder import FontBuilder
+from fontTools.pens.t2CharStringPen import T2CharStringPen
+
+K = 0.5523
+QUARTERS = [((1, 0), (0, 1)), ((0, 1), (-1, 0)), ((-1, 0), (0, -1)), ((0, -1), (1, 0))]
+
+
+def ellipse(pen, cx, cy, rx, ry, clockwise=False):
+    sy = -1 if clockwise else 1
+
+    def at(x, y):
+        return (cx + x * rx, cy + sy * y * ry)
+
+    pen.moveTo(at(1, 0))
+    for (x0, y0), (x1, y1) in QUARTERS:
+        pen.curveTo(at(x0 + K * x1, y0 + K * y1), at(x1 + K * x0, y1 + K * y0), at(x1, y1))
+    pen.closePath()
+
+
+def ring(pen):
+    ellipse(pen, 400, 350, 320, 360)
+    ellipse(pen, 400, 350, 200, 240, clockwise=True)
+
+
+def bends(pen):
+    pen.moveTo((120, 80))
+    pen.curveTo((600, -40), (720, 300), (380, 360))
+    pen.curveTo((100, 410), (220, 760), (650, 640))
+    pen.lineTo((640, 540))
+    pen.curveTo((330, 620), (250, 450), (400, 450))
+    pen.curveTo((840, 420), (640, -150), (120, -20))
+    pen.closePath()
+
+
+def wedge(pen):
+    pen.moveTo((100, 0))
+    pen.curveTo((100, 0), (700, 100), (700, 700))
+    pen.curveTo((300, 500), (100, 300), (100, 300))
+    pen.closePath()
+
+
+def loop(pen):
+    pen.moveTo((100, 100))
+    pen.curveTo((900, 800), (-100, 800), (700, 100))
+    pen.closePath()
+
+
+def glyph(draw):
+    pen = T2CharStringPen(800, None)
+    draw(pen)
+    return pen.getCharString()
+
+
+names = [".notdef", "O", "S", "C", "L"]
+charstrings = {
+    ".notdef": glyph(lambda pen: ellipse(pen, 400, 350, 300, 300)),
+    "O": glyph(ring),
+    "S": glyph(bends),
+    "C": glyph(wedge),
+    "L": glyph(loop),
+}
+
+builder = FontBuilder(1000, isTTF=False)
+builder.setupGlyphOrder(names)
+builder.setupCharacterMap({ord(name): name for name in names[1:]})
+builder.setupCFF("Cubic", {"FullName": "Cubic"}, charstrings, {})
+builder.setupHorizontalMetrics({name: (800, 0) for name in names})
+builder.setupHorizontalHeader(ascent=800, descent=-200)
+builder.setupNameTable({"familyName": "Cubic", "styleName": "Regular"})
+builder.setupOS2(sTypoAscender=800, usWinAscent=800, usWinDescent=200)
+builder.setupPost()
+builder.save("cubic.otf")
@@ -0,0 +1,54 @@
+"""Writes overlap.ttf, the font of the winding test. Needs fontTools.
+
+'A' is two overlapping squares and 'B' the single contour of their union.
+'C' is a square with a smaller one of the same winding inside it, and 'D'
+the outer square alone. The sides of the outer square are split into many
+segments, so that the glyph gets a fine grid.
+"""
+from fontTools.fontBuilder import FontBuilder
+from fontTools.pens.ttGlyphPen import TTGlyphPen
+
+
+def polygon(pen, points):
+    pen.moveTo(points[0])
+    for point in points[1:]:
+        pen.lineTo(point)
+    pen.closePath()
+
+
+def square(pen, x0, y0, x1, y1, pieces=1):
+    corners = [(x0, y0), (x0, y1), (x1, y1), (x1, y0), (x0, y0)]
+    points = []
+    for (ax, ay), (bx, by) in zip(corners, corners[1:]):
+        for i in range(pieces):
+            points.append((ax + (bx - ax) * i // pieces, ay + (by - ay) * i // pieces))
+    polygon(pen, points)
+
+
+def glyph(*contours):
+    pen = TTGlyphPen(None)
+    for draw, args in contours:
+        draw(pen, *args)
+    return pen.glyph()
+
+
+names = [".notdef", "A", "B", "C", "D"]
+glyphs = {
+    ".notdef": glyph((square, (0, 0, 500, 500))),
+    "A": glyph((square, (100, 0, 600, 500)), (square, (350, 250, 850, 750))),
+    "B": glyph((polygon, ([(100, 0), (100, 500), (350, 500), (350, 750), (850, 750),
+                           (850, 250), (600, 250), (600, 0)],))),
+    "C": glyph((square, (100, 0, 900, 800, 16)), (square, (600, 300, 800, 500))),
+    "D": glyph((square, (100, 0, 900, 800, 16))),
+}
+
+builder = FontBuilder(1000, isTTF=True)
+builder.setupGlyphOrder(names)
+builder.setupCharacterMap({ord(name): name for name in names[1:]})
+builder.setupGlyf(glyphs)
+builder.setupHorizontalMetrics({name: (1000, 0) for name in names})
+builder.setupHorizontalHeader(ascent=800, descent=-200)
+builder.setupNameTable({"familyName": "Overlap", "styleName": "Regular"})
+builder.setupOS2(sTypoAscender=800, usWinAscent=800, usWinDescent=200)
+builder.setupPost()
+builder.save("overlap.ttf")
@@ -0,0 +1,156 @@
+#include <math.h>
+
+#include "test.h"
+
+#include "msdfgl_cpu.h"
+#include "msdfgl_serializer.h"
+
+/**
+ * Generates the glyphs of each font on the CPU with every vector kernel the
+ * processor runs, and compares the bitmaps with those of the scalar path bit
+ * by bit, in three channels and in one. The glyphs are serialized and
+ * generated in memory, without a context. Takes the fonts as its arguments,
+ * DejaVu Sans for lines and quadratic curves and cubic.otf for cubic ones.
+ */
+
+#define RANGE 4.0f
+#define SCALE 2.0f
+#define NTHREADS 4
+#define FIRST_CODE 32
+#define NCODES 95
+
+typedef struct {
+    msdfgl_cpu_glyph_t *glyphs;
+    int n;
+    size_t size;
+    msdfgl_serializer_t serializer;
+} font_glyphs;
+
+/* Serialize the glyphs of the printable ASCII characters which have an
+   outline, and lay out their bitmaps as the atlas does. */
+static int serialize(FT_Face face, int single_channel, font_glyphs *f) {
+    size_t *offsets = calloc(3 * NCODES, sizeof(size_t));
+    f->glyphs = calloc(NCODES, sizeof(msdfgl_cpu_glyph_t));
+    if (!offsets || !f->glyphs) {
+        free(offsets);
+        return -1;
+    }
+
+    f->serializer.range = RANGE;
+    f->serializer.single_channel = single_channel;
+    f->n = 0;
+    f->size = 0;
+    for (FT_ULong code = FIRST_CODE; code < FIRST_CODE + NCODES; ++code) {
+        FT_UInt index = FT_Get_Char_Index(face, code);
+        size_t *offset = &offsets[3 * f->n];
+        float detail;
+        if (!index)
+            continue;
+        if (msdfgl_serialize_glyph(face, index, &f->serializer, &offset[0], &offset[1],
+                                   &offset[2], &detail)) {
+            free(offsets);
+            return -1;
+        }
+        if (!f->serializer.meta[offset[0]])
+            continue;
+
+        FT_Glyph_Metrics *metrics = &face->glyph->metrics;
+        msdfgl_cpu_glyph_t *glyph = &f->glyphs[f->n++];
+        glyph->size[0] = (metrics->width / SERIALIZER_SCALE + RANGE) * SCALE;
+        glyph->size[1] = (metrics->height / SERIALIZER_SCALE + RANGE) * SCALE;
+        glyph->translate[0] = -metrics->horiBearingX / SERIALIZER_SCALE + RANGE / 2.0f;
+        glyph->translate[1] =
+            (metrics->height - metrics->horiBearingY) / SERIALIZER_SCALE + RANGE / 2.0f;
+        glyph->scale = SCALE;
+        glyph->width = (int)ceilf(glyph->size[0]);
+        glyph->height = (int)ceilf(glyph->size[1]);
+        f->size += (size_t)glyph->width * glyph->height;
+    }
+
+    /* The arena has its final place once every glyph is in. */
+    for (int i = 0; i < f->n; ++i) {
+        const size_t *offset = &offsets[3 * i];
+        f->glyphs[i].meta = &f->serializer.meta[offset[0]];
+        f->glyphs[i].points = &f->serializer.points[2 * offset[1]];
+        f->glyphs[i].segments = &f->serializer.segments[SERIALIZER_SEGMENT_SIZE * offset[2]];
+    }
+    free(offsets);
+    return 0;
+}
+
+static unsigned char *generate(font_glyphs *f, enum msdfgl_cpu_format format,
+                               enum msdfgl_cpu_kernel kernel) {
+    size_t texel_size = msdfgl_cpu_texel_size(format);
+    unsigned char *bitmaps = malloc(f->size * texel_size);
+    if (!bitmaps)
+        return NULL;
+
+    size_t size = 0;
+    for (int i = 0; i < f->n; ++i) {
+        f->glyphs[i].bitmap = &bitmaps[size];
+        size += (size_t)f->glyphs[i].width * f->glyphs[i].height * texel_size;
+    }
+    if (msdfgl_cpu_generate(f->glyphs, f->n, RANGE, format, kernel, NTHREADS)) {
+        free(bitmaps);
+        return NULL;
+    }
+    return bitmaps;
+}
+
+static int compare(const unsigned char *scalar, const unsigned char *vector, size_t ntexels,
+                   size_t texel_size, const char *name) {
+    size_t ndiffer = 0;
+    for (size_t i = 0; i < ntexels; ++i)
+        ndiffer += memcmp(&scalar[i * texel_size], &vector[i * texel_size], texel_size) != 0;
+    fprintf(stderr, "%s: %zu of %zu texels differ\n", name, ndiffer, ntexels);
+    return ndiffer ? -1 : 0;
+}
+
+static int run(FT_Library library, const char *path, int single_channel) {
+    static const char *names[] = {"scalar", "SSE2", "AVX2"};
+    enum msdfgl_cpu_format format = single_channel ? MSDFGL_CPU_R16F : MSDFGL_CPU_RGBA32F;
+    size_t texel_size = msdfgl_cpu_texel_size(format);
+    int retval = 1;
+    FT_Face face = NULL;
+    font_glyphs f = {NULL, 0, 0, {0}};
+    unsigned char *scalar = NULL, *vector = NULL;
+
+    msdfgl_serializer_init(&f.serializer);
+    CHECK(!FT_New_Face(library, path, 0, &face));
+    CHECK(!serialize(face, single_channel, &f));
+    CHECK(f.n > 0);
+    fprintf(stderr, "%s, %d glyphs in %d channel(s)\n", path, f.n, single_channel ? 1 : 3);
+
+    CHECK(scalar = generate(&f, format, MSDFGL_CPU_SCALAR));
+    int best = (int)msdfgl_cpu_best_kernel();
+    for (int kernel = MSDFGL_CPU_SCALAR + 1; kernel <= best; ++kernel) {
+        CHECK(vector = generate(&f, format, (enum msdfgl_cpu_kernel)kernel));
+        CHECK(!compare(scalar, vector, f.size, texel_size, names[kernel]));
+        free(vector);
+        vector = NULL;
+    }
+    retval = 0;
+
+error:
+    free(vector);
+    free(scalar);
+    free(f.glyphs);
+    msdfgl_serializer_destroy(&f.serializer);
+    if (face)
+        FT_Done_Face(face);
+    return retval;
+}
+
+int main(int argc, char *argv[]) {
+    FT_Library library;
+    if (argc < 2 || msdfgl_cpu_best_kernel() == MSDFGL_CPU_SCALAR)
+        return TEST_SKIP;
+    if (FT_Init_FreeType(&library))
+        return 1;
+
+    int retval = 0;
+    for (int i = 1; i < argc && !retval; ++i)
+        retval = run(library, argv[i], 0) || run(library, argv[i], 1);
+    FT_Done_FreeType(library);
+    return retval;
+}
@@ -0,0 +1,132 @@
+#include "test.h"
+
+#include "msdfgl_packer.h"
+
+/**
+ * Places many bitmaps of random sizes with each packer, with and without
+ * padding, onto pages of a limited height. Every bitmap must lie within the
+ * border of its page, and no two padded bitmaps may overlap. MaxRects is then
+ * rebuilt from every other bitmap, as eviction does, and filled again. Needs
+ * neither a context nor the font.
+ */
+
+#define WIDTH 256
+#define PAGE_HEIGHT 256
+#define NRECTS 1500
+#define MAX_SIZE 40
+
+typedef struct {
+    msdfgl_packer_rect_t rect;
+    int page;
+} placed;
+
+static unsigned int seed = 1;
+
+static int random_size(void) {
+    seed = seed * 1103515245u + 12345u;
+    return 1 + (int)((seed >> 16) % MAX_SIZE);
+}
+
+static int overlap(const placed *a, const placed *b, int padding) {
+    return a->page == b->page && a->rect.x < b->rect.x + b->rect.width + padding &&
+           b->rect.x < a->rect.x + a->rect.width + padding &&
+           a->rect.y < b->rect.y + b->rect.height + padding &&
+           b->rect.y < a->rect.y + a->rect.height + padding;
+}
+
+static int check(const msdfgl_packer_t *p, const placed *rects, size_t n) {
+    size_t area = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const msdfgl_packer_rect_t *r = &rects[i].rect;
+        if (r->x < 1 || r->y < 1 || r->x + r->width > WIDTH ||
+            r->y + r->height > PAGE_HEIGHT || rects[i].page >= p->npages) {
+            fprintf(stderr, "packer %d: bitmap %zu at %d,%d outside the page\n", p->kind, i,
+                    r->x, r->y);
+            return -1;
+        }
+        for (size_t j = 0; j < i; ++j) {
+            if (overlap(&rects[i], &rects[j], p->padding)) {
+                fprintf(stderr, "packer %d: bitmaps %zu and %zu overlap\n", p->kind, j, i);
+                return -1;
+            }
+        }
+        area += (size_t)r->width * r->height;
+    }
+    return area == msdfgl_packer_area(p) ? 0 : -1;
+}
+
+static int insert(msdfgl_packer_t *p, placed *rects, size_t *n, size_t count) {
+    for (size_t end = *n + count; *n < end; ++*n) {
+        placed *r = &rects[*n];
+        r->rect.width = random_size();
+        r->rect.height = random_size();
+        if (msdfgl_packer_insert(p, r->rect.width, r->rect.height, &r->rect.x, &r->rect.y,
+                                 &r->page))
+            return -1;
+    }
+    return 0;
+}
+
+/* Keep every other bitmap, and rebuild the free space of each page from them. */
+static int remove_half(msdfgl_packer_t *p, placed *rects, size_t *n) {
+    msdfgl_packer_rect_t *used = malloc(*n * sizeof(msdfgl_packer_rect_t));
+    if (!used)
+        return -1;
+
+    size_t kept = 0;
+    for (size_t i = 0; i < *n; i += 2)
+        rects[kept++] = rects[i];
+    *n = kept;
+
+    int retval = 0;
+    for (int page = 0; page < p->npages && !retval; ++page) {
+        size_t nused = 0;
+        for (size_t i = 0; i < kept; ++i) {
+            if (rects[i].page == page)
+                used[nused++] = rects[i].rect;
+        }
+        retval = msdfgl_packer_rebuild(p, page, used, nused);
+    }
+    free(used);
+    return retval;
+}
+
+static int run(enum msdfgl_atlas_packer kind, int padding, placed *rects) {
+    int retval = 1;
+    size_t n = 0;
+    msdfgl_packer_t packer;
+    CHECK(!msdfgl_packer_init(&packer, kind, WIDTH, PAGE_HEIGHT, padding));
+
+    CHECK(!insert(&packer, rects, &n, NRECTS));
+    CHECK(!check(&packer, rects, n));
+
+    if (kind == MSDFGL_PACKER_MAXRECTS) {
+        CHECK(!remove_half(&packer, rects, &n));
+        CHECK(!check(&packer, rects, n));
+        CHECK(!insert(&packer, rects, &n, NRECTS / 2));
+        CHECK(!check(&packer, rects, n));
+    }
+    retval = 0;
+
+error:
+    msdfgl_packer_destroy(&packer);
+    return retval;
+}
+
+int main(void) {
+    static const enum msdfgl_atlas_packer kinds[] = {
+        MSDFGL_PACKER_SHELF, MSDFGL_PACKER_SKYLINE, MSDFGL_PACKER_MAXRECTS};
+    static const int paddings[] = {0, 2};
+
+    placed *rects = malloc(2 * NRECTS * sizeof(placed));
+    if (!rects)
+        return 1;
+
+    int retval = 0;
+    for (size_t i = 0; i < sizeof(kinds) / sizeof(kinds[0]) && !retval; ++i) {
+        for (size_t j = 0; j < sizeof(paddings) / sizeof(paddings[0]) && !retval; ++j)
+            retval = run(kinds[i], paddings[j], rects);
+    }
+    free(rects);
+    return retval;
+}
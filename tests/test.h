@@ -0,0 +1,187 @@
+#ifndef MSDFGL_TEST_H
+#define MSDFGL_TEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#define GL_GLEXT_PROTOTYPES
+#include <msdfgl.h>
+
+/**
+ * Helpers shared by the tests. They run without a display, on an EGL context
+ * like msdfgl-bake, and take the font to test with as their first argument.
+ * A test returns 0 when it passes, 77 when it cannot run here and 1 when it
+ * fails.
+ */
+
+#define TEST_SKIP 77
+
+/**
+ * Report a failed condition and jump to the `error` label of the test.
+ */
+#define CHECK(condition)                                                                     \
+    do {                                                                                     \
+        if (!(condition)) {                                                                  \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition);    \
+            goto error;                                                                      \
+        }                                                                                    \
+    } while (0)
+
+typedef struct test_egl {
+    EGLDisplay display;
+    EGLContext context;
+    EGLSurface surface;
+} test_egl;
+
+/**
+ * Make a core desktop OpenGL context current without a window, surfaceless
+ * if the driver supports it and on a small pbuffer otherwise. Of the
+ * versions from 4.3 down to 3.3, the first one at or below `major`.`minor`
+ * is used. Returns -1 if there is none.
+ */
+static inline int test_create_egl(test_egl *egl, int major, int minor) {
+    egl->display = EGL_NO_DISPLAY;
+    egl->context = EGL_NO_CONTEXT;
+    egl->surface = EGL_NO_SURFACE;
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (get_platform_display)
+        egl->display =
+            get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+#endif
+    if (egl->display == EGL_NO_DISPLAY)
+        egl->display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (egl->display == EGL_NO_DISPLAY || !eglInitialize(egl->display, NULL, NULL) ||
+        !eglBindAPI(EGL_OPENGL_API))
+        return -1;
+
+    const EGLint config_attributes[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+    const EGLint pbuffer_config_attributes[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                                                EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_NONE};
+    const char *extensions = eglQueryString(egl->display, EGL_EXTENSIONS);
+    int surfaceless = extensions && strstr(extensions, "EGL_KHR_surfaceless_context");
+
+    EGLConfig config;
+    EGLint nconfigs = 0;
+    if (!eglChooseConfig(egl->display,
+                         surfaceless ? config_attributes : pbuffer_config_attributes, &config,
+                         1, &nconfigs))
+        return -1;
+    if (!nconfigs) {
+#ifdef EGL_KHR_no_config_context
+        if (!surfaceless || !strstr(extensions, "EGL_KHR_no_config_context"))
+            return -1;
+        config = EGL_NO_CONFIG_KHR;
+#else
+        return -1;
+#endif
+    }
+
+    static const EGLint versions[][2] = {{4, 3}, {3, 3}};
+    for (size_t i = 0; i < 2 && egl->context == EGL_NO_CONTEXT; ++i) {
+        if (versions[i][0] * 10 + versions[i][1] > major * 10 + minor)
+            continue;
+        const EGLint context_attributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION, versions[i][0], EGL_CONTEXT_MINOR_VERSION, versions[i][1],
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE};
+        egl->context = eglCreateContext(egl->display, config, EGL_NO_CONTEXT, context_attributes);
+    }
+    if (egl->context == EGL_NO_CONTEXT)
+        return -1;
+
+    if (!surfaceless) {
+        const EGLint pbuffer_attributes[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+        if ((egl->surface = eglCreatePbufferSurface(egl->display, config,
+                                                    pbuffer_attributes)) == EGL_NO_SURFACE)
+            return -1;
+    }
+    return eglMakeCurrent(egl->display, egl->surface, egl->surface, egl->context) ? 0 : -1;
+}
+
+static inline void test_destroy_egl(test_egl *egl) {
+    if (egl->display == EGL_NO_DISPLAY)
+        return;
+    eglMakeCurrent(egl->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (egl->context != EGL_NO_CONTEXT)
+        eglDestroyContext(egl->display, egl->context);
+    if (egl->surface != EGL_NO_SURFACE)
+        eglDestroySurface(egl->display, egl->surface);
+    eglTerminate(egl->display);
+}
+
+#define TEST_WIDTH 640
+#define TEST_HEIGHT 48
+
+/**
+ * Draw `text` in white on black with msdfgl_printf, and read the RGBA pixels
+ * of the TEST_WIDTH by TEST_HEIGHT image to `pixels`. Returns 0 on success.
+ */
+static inline int test_draw(msdfgl_font_t font, const char *text, unsigned char *pixels) {
+    GLuint framebuffer, renderbuffer;
+    glGenRenderbuffers(1, &renderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, TEST_WIDTH, TEST_HEIGHT);
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER,
+                              renderbuffer);
+    int complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+    if (complete) {
+        GLfloat projection[4][4];
+        _msdfgl_ortho(0.0, TEST_WIDTH, TEST_HEIGHT, 0.0, -1.0, 1.0, projection);
+        glViewport(0, 0, TEST_WIDTH, TEST_HEIGHT);
+        glClearColor(0.0, 0.0, 0.0, 1.0);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        msdfgl_printf(4.0, TEST_HEIGHT * 0.75f, font, 18.0, 0xffffffff, (GLfloat *)projection,
+                      0, text);
+        glDisable(GL_BLEND);
+
+        /* The atlas may have been resized by the draw call, which resets the
+           framebuffer binding. */
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, TEST_WIDTH, TEST_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(1, &renderbuffer);
+    return complete && glGetError() == GL_NO_ERROR ? 0 : -1;
+}
+
+/**
+ * Count the bytes of `a` and `b` which differ by more than `tolerance`.
+ */
+static inline size_t test_compare(const unsigned char *a, const unsigned char *b, size_t n,
+                                  int tolerance) {
+    size_t ndiffer = 0;
+    int max = 0;
+    for (size_t i = 0; i < n; ++i) {
+        int d = abs((int)a[i] - (int)b[i]);
+        max = d > max ? d : max;
+        ndiffer += d > tolerance;
+    }
+    if (ndiffer)
+        fprintf(stderr, "%zu of %zu bytes differ, by up to %d\n", ndiffer, n, max);
+    return ndiffer;
+}
+
+/**
+ * Codepoints of a NUL-terminated string of ASCII characters.
+ */
+static inline size_t test_codepoints(const char *text, int32_t *codes) {
+    size_t n = 0;
+    for (; text[n]; ++n)
+        codes[n] = (unsigned char)text[n];
+    return n;
+}
+
+#endif /* MSDFGL_TEST_H */
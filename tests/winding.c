@@ -0,0 +1,60 @@
+#include "test.h"
+
+/**
+ * fonts/overlap.ttf has pairs of glyphs of the same shape. 'A' is drawn as two
+ * overlapping squares and 'B' as the single contour of their union. 'C' is a
+ * square with a smaller one of the same winding inside, and 'D' the outer
+ * square alone. Areas covered by either contour are inside, so the glyphs of
+ * a pair must come out the same. At the larger scale, parts of the squares
+ * are farther than the range from any edge.
+ */
+
+static const double scales[] = {2.0, 12.0};
+static const char *pairs[][2] = {{"A", "B"}, {"C", "D"}};
+
+int main(int argc, char *argv[]) {
+    if (argc < 2)
+        return TEST_SKIP;
+
+    int retval = 1;
+    test_egl egl;
+    msdfgl_context_t ctx = NULL;
+    msdfgl_font_t font = NULL;
+    unsigned char *pixels = malloc(TEST_WIDTH * TEST_HEIGHT * 4);
+    unsigned char *expected = malloc(TEST_WIDTH * TEST_HEIGHT * 4);
+
+    if (test_create_egl(&egl, 3, 3)) {
+        retval = TEST_SKIP;
+        goto error;
+    }
+    CHECK(pixels && expected);
+    CHECK(ctx = msdfgl_create_context("330 core"));
+
+    for (size_t i = 0; i < sizeof(scales) / sizeof(scales[0]); ++i) {
+        CHECK(font = msdfgl_load_font(ctx, argv[1], 4.0, scales[i], NULL));
+        CHECK(msdfgl_generate_glyphs(font, 'A', 'D') >= 0);
+
+        for (size_t j = 0; j < sizeof(pairs) / sizeof(pairs[0]); ++j) {
+            CHECK(!test_draw(font, pairs[j][0], pixels));
+            CHECK(!test_draw(font, pairs[j][1], expected));
+            if (test_compare(pixels, expected, TEST_WIDTH * TEST_HEIGHT * 4, 4)) {
+                fprintf(stderr, "%s and %s differ at scale %g\n", pairs[j][0], pairs[j][1],
+                        scales[i]);
+                goto error;
+            }
+        }
+        msdfgl_destroy_font(font);
+        font = NULL;
+    }
+    retval = 0;
+
+error:
+    if (font)
+        msdfgl_destroy_font(font);
+    if (ctx)
+        msdfgl_destroy_context(ctx);
+    test_destroy_egl(&egl);
+    free(pixels);
+    free(expected);
+    return retval;
+}
@@ -0,0 +1,493 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#define GL_GLEXT_PROTOTYPES
+#include <msdfgl.h>
+
+/**
+ * Generates an atlas ahead of time, without a display, e.g. on a build
+ * machine with a software rasterizer such as Mesa llvmpipe:
+ *
+ *     msdfgl-bake -c 32-126,0xa0-0xff -m Lato.json Lato-Regular.ttf Lato.atlas
+ *
+ * The atlas is written with msdfgl_save_atlas, and is restored on clients
+ * with msdfgl_load_atlas for the same font, range, scale and atlas settings.
+ * Those include the page height, which is fixed rather than the texture size
+ * limit of the baking driver, so that clients on other GPUs can match it.
+ * The metrics file lists the font units of each glyph as JSON.
+ */
+
+#define BAKE_DEFAULT_CODEPOINTS "32-126"
+/* Within the texture size limit of any desktop GPU msdfgl runs on. */
+#define BAKE_DEFAULT_PAGE_HEIGHT 4096
+
+enum bake_phase {
+    PHASE_CONTEXT,
+    PHASE_CODEPOINTS,
+    PHASE_FONT,
+    PHASE_RESERVE,
+    PHASE_GENERATE,
+    PHASE_SAVE,
+    PHASE_METRICS,
+    NPHASES
+};
+
+static const char *phase_names[NPHASES] = {
+    "context", "codepoints", "font", "reserve", "generate", "save", "metrics",
+};
+
+typedef struct bake_options {
+    float range;
+    float scale;
+    int padding;
+    int width;
+    int page_height;
+    GLenum format;
+    enum msdfgl_atlas_packer packer;
+    int threads;
+    const char *codepoints;
+    const char *text;
+    const char *metrics;
+    const char *font;
+    const char *output;
+} bake_options;
+
+typedef struct bake_codepoints {
+    int32_t *codes;
+    size_t n;
+    size_t nallocated;
+} bake_codepoints;
+
+static double now_ms(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static void usage(void) {
+    fprintf(stderr,
+            "Usage: msdfgl-bake [options] <font file> <atlas file>\n"
+            "  -c <ranges>   codepoints, e.g. 32-126,0x400-0x4ff (default " BAKE_DEFAULT_CODEPOINTS ")\n"
+            "  -t <file>     add the codepoints of a UTF-8 text file\n"
+            "  -m <file>     write glyph metrics as JSON\n"
+            "  -r <range>    distance range in pixels (default 4)\n"
+            "  -s <scale>    glyph scale (default 2)\n"
+            "  -p <padding>  pixels between glyphs (default 2)\n"
+            "  -w <width>    atlas width (default 2048)\n"
+            "  -h <height>   atlas page height, clients must set the same (default %d)\n"
+            "  -f <format>   rgba32f, rgba16f, rgb10a2, rgba8, r16f or r8 (default rgba32f)\n"
+            "  -k <packer>   shelf, skyline or maxrects (default skyline)\n"
+            "  -j <threads>  serialization threads, 0 for one per CPU (default 0)\n",
+            BAKE_DEFAULT_PAGE_HEIGHT);
+}
+
+static int parse_format(const char *name, GLenum *format) {
+    static const struct {
+        const char *name;
+        GLenum format;
+    } formats[] = {
+        {"rgba32f", GL_RGBA32F}, {"rgba16f", GL_RGBA16F}, {"rgb10a2", GL_RGB10_A2},
+        {"rgba8", GL_RGBA8},     {"r16f", GL_R16F},       {"r8", GL_R8},
+    };
+    for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); ++i) {
+        if (!strcmp(name, formats[i].name)) {
+            *format = formats[i].format;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int parse_packer(const char *name, enum msdfgl_atlas_packer *packer) {
+    if (!strcmp(name, "shelf"))
+        *packer = MSDFGL_PACKER_SHELF;
+    else if (!strcmp(name, "skyline"))
+        *packer = MSDFGL_PACKER_SKYLINE;
+    else if (!strcmp(name, "maxrects"))
+        *packer = MSDFGL_PACKER_MAXRECTS;
+    else
+        return -1;
+    return 0;
+}
+
+static int parse_options(int argc, char *argv[], bake_options *o) {
+    o->range = 4.0f;
+    o->scale = 2.0f;
+    o->padding = 2;
+    o->width = 2048;
+    o->page_height = BAKE_DEFAULT_PAGE_HEIGHT;
+    o->format = GL_RGBA32F;
+    o->packer = MSDFGL_PACKER_SKYLINE;
+    o->threads = 0;
+    o->codepoints = NULL;
+    o->text = NULL;
+    o->metrics = NULL;
+
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-' && argv[i][1]; ++i) {
+        if (argv[i][2] || i + 1 >= argc)
+            return -1;
+        const char *value = argv[++i];
+        switch (argv[i - 1][1]) {
+        case 'c':
+            o->codepoints = value;
+            break;
+        case 't':
+            o->text = value;
+            break;
+        case 'm':
+            o->metrics = value;
+            break;
+        case 'r':
+            o->range = (float)atof(value);
+            break;
+        case 's':
+            o->scale = (float)atof(value);
+            break;
+        case 'p':
+            o->padding = atoi(value);
+            break;
+        case 'w':
+            o->width = atoi(value);
+            break;
+        case 'h':
+            o->page_height = atoi(value);
+            break;
+        case 'f':
+            if (parse_format(value, &o->format))
+                return -1;
+            break;
+        case 'k':
+            if (parse_packer(value, &o->packer))
+                return -1;
+            break;
+        case 'j':
+            o->threads = atoi(value);
+            break;
+        default:
+            return -1;
+        }
+    }
+    /* A width of 0, the texture size limit of the baking driver, would not
+       match the atlases of clients on other GPUs. */
+    if (argc - i != 2 || o->range <= 0 || o->scale <= 0 || o->padding < 0 || o->width <= 0 ||
+        o->page_height < 2)
+        return -1;
+    o->font = argv[i];
+    o->output = argv[i + 1];
+    if (!o->codepoints && !o->text)
+        o->codepoints = BAKE_DEFAULT_CODEPOINTS;
+    return 0;
+}
+
+static int add_codepoint(bake_codepoints *c, int32_t code) {
+    if (c->n == c->nallocated) {
+        size_t nallocated = c->nallocated ? c->nallocated * 2 : 256;
+        int32_t *codes = realloc(c->codes, nallocated * sizeof(int32_t));
+        if (!codes)
+            return -1;
+        c->codes = codes;
+        c->nallocated = nallocated;
+    }
+    c->codes[c->n++] = code;
+    return 0;
+}
+
+/**
+ * Add codepoint ranges given as comma-separated `first-last` or single
+ * codepoints, in decimal or hexadecimal.
+ */
+static int parse_ranges(bake_codepoints *c, const char *spec) {
+    const char *s = spec;
+    while (*s) {
+        char *end;
+        long first = strtol(s, &end, 0), last = first;
+        if (end == s)
+            return -1;
+        s = end;
+        if (*s == '-') {
+            last = strtol(++s, &end, 0);
+            if (end == s)
+                return -1;
+            s = end;
+        }
+        if (first < 0 || last < first || last >= 0x110000)
+            return -1;
+        for (long code = first; code <= last; ++code) {
+            if (add_codepoint(c, (int32_t)code))
+                return -1;
+        }
+        if (*s == ',')
+            ++s;
+        else if (*s)
+            return -1;
+    }
+    return 0;
+}
+
+/**
+ * Add the codepoints of a UTF-8 text file, skipping line breaks.
+ */
+static int parse_text(bake_codepoints *c, const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return -1;
+
+    int retval = 0, ch;
+    while ((ch = fgetc(f)) != EOF) {
+        int32_t code = ch;
+        int ncontinuation = 0;
+        if (ch >= 0xf0)
+            code = ch & 0x07, ncontinuation = 3;
+        else if (ch >= 0xe0)
+            code = ch & 0x0f, ncontinuation = 2;
+        else if (ch >= 0xc0)
+            code = ch & 0x1f, ncontinuation = 1;
+        for (int i = 0; i < ncontinuation && (ch = fgetc(f)) != EOF; ++i)
+            code = (code << 6) | (ch & 0x3f);
+        if (code == '\n' || code == '\r')
+            continue;
+        if ((retval = add_codepoint(c, code)))
+            break;
+    }
+    fclose(f);
+    return retval;
+}
+
+static int compare_codepoints(const void *a, const void *b) {
+    return *(const int32_t *)a - *(const int32_t *)b;
+}
+
+/**
+ * Sort the codepoints and drop duplicates and the ones the font has no
+ * glyph for. Returns the amount dropped for missing glyphs.
+ */
+static size_t filter_codepoints(bake_codepoints *c, FT_Face face) {
+    qsort(c->codes, c->n, sizeof(int32_t), compare_codepoints);
+    size_t n = 0, nmissing = 0;
+    for (size_t i = 0; i < c->n; ++i) {
+        if (n && c->codes[n - 1] == c->codes[i])
+            continue;
+        if (!FT_Get_Char_Index(face, c->codes[i])) {
+            ++nmissing;
+            continue;
+        }
+        c->codes[n++] = c->codes[i];
+    }
+    c->n = n;
+    return nmissing;
+}
+
+static int write_metrics(const char *path, FT_Face face, const bake_options *o,
+                         const bake_codepoints *c) {
+    FILE *f = fopen(path, "w");
+    if (!f)
+        return -1;
+
+    fprintf(f, "{\n  \"units_per_em\": %d,\n  \"ascender\": %d,\n  \"descender\": %d,\n",
+            face->units_per_EM, face->ascender, face->descender);
+    fprintf(f, "  \"height\": %d,\n  \"range\": %g,\n  \"scale\": %g,\n  \"glyphs\": [",
+            face->height, o->range, o->scale);
+    for (size_t i = 0; i < c->n; ++i) {
+        if (FT_Load_Char(face, c->codes[i], FT_LOAD_NO_SCALE)) {
+            fclose(f);
+            return -1;
+        }
+        FT_Glyph_Metrics *m = &face->glyph->metrics;
+        fprintf(f,
+                "%s\n    {\"codepoint\": %d, \"advance\": [%ld, %ld], \"bearing\": [%ld, %ld], "
+                "\"size\": [%ld, %ld]}",
+                i ? "," : "", c->codes[i], m->horiAdvance, m->vertAdvance, m->horiBearingX,
+                m->horiBearingY, m->width, m->height);
+    }
+    fprintf(f, "\n  ]\n}\n");
+    return fclose(f) ? -1 : 0;
+}
+
+/**
+ * Make a desktop OpenGL context current without a window, surfaceless if the
+ * driver supports it and on a small pbuffer otherwise. A 4.3 context lets
+ * msdfgl generate with compute shaders, 3.3 is the minimum.
+ */
+static int create_egl_context(EGLDisplay *display, EGLContext *context, EGLSurface *surface) {
+    *display = EGL_NO_DISPLAY;
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (get_platform_display)
+        *display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+#endif
+    if (*display == EGL_NO_DISPLAY)
+        *display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (*display == EGL_NO_DISPLAY || !eglInitialize(*display, NULL, NULL) ||
+        !eglBindAPI(EGL_OPENGL_API))
+        return -1;
+
+    const EGLint config_attributes[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+    const EGLint pbuffer_config_attributes[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                                                EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_NONE};
+    const char *extensions = eglQueryString(*display, EGL_EXTENSIONS);
+    int surfaceless = extensions && strstr(extensions, "EGL_KHR_surfaceless_context");
+
+    EGLConfig config;
+    EGLint nconfigs = 0;
+    if (!eglChooseConfig(*display, surfaceless ? config_attributes : pbuffer_config_attributes,
+                         &config, 1, &nconfigs))
+        return -1;
+    if (!nconfigs) {
+        /* Surfaceless displays may have no configs at all. */
+#ifdef EGL_KHR_no_config_context
+        if (!surfaceless || !strstr(extensions, "EGL_KHR_no_config_context"))
+            return -1;
+        config = EGL_NO_CONFIG_KHR;
+#else
+        return -1;
+#endif
+    }
+
+    static const EGLint versions[][2] = {{4, 3}, {3, 3}};
+    *context = EGL_NO_CONTEXT;
+    for (size_t i = 0; i < 2 && *context == EGL_NO_CONTEXT; ++i) {
+        const EGLint context_attributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION, versions[i][0], EGL_CONTEXT_MINOR_VERSION, versions[i][1],
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE};
+        *context = eglCreateContext(*display, config, EGL_NO_CONTEXT, context_attributes);
+    }
+    if (*context == EGL_NO_CONTEXT)
+        return -1;
+
+    *surface = EGL_NO_SURFACE;
+    if (!surfaceless) {
+        const EGLint pbuffer_attributes[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+        if ((*surface = eglCreatePbufferSurface(*display, config, pbuffer_attributes)) ==
+            EGL_NO_SURFACE)
+            return -1;
+    }
+    return eglMakeCurrent(*display, *surface, *surface, *context) ? 0 : -1;
+}
+
+int main(int argc, char *argv[]) {
+    bake_options o;
+    if (parse_options(argc, argv, &o)) {
+        usage();
+        return -1;
+    }
+
+    double times[NPHASES] = {0};
+    double start = now_ms(), t = start;
+    int retval = -1;
+
+    EGLDisplay display;
+    EGLContext context = EGL_NO_CONTEXT;
+    EGLSurface surface = EGL_NO_SURFACE;
+    msdfgl_context_t ctx = NULL;
+    msdfgl_atlas_t atlas = NULL;
+    msdfgl_font_t font = NULL;
+    FT_Library library = NULL;
+    FT_Face face = NULL;
+    bake_codepoints codepoints = {NULL, 0, 0};
+
+    if (create_egl_context(&display, &context, &surface)) {
+        fprintf(stderr, "Failed to create an EGL context\n");
+        goto error;
+    }
+    if (!(ctx = msdfgl_create_context("330 core"))) {
+        fprintf(stderr, "Failed to create context!\n");
+        goto error;
+    }
+    msdfgl_set_worker_threads(ctx, o.threads);
+    times[PHASE_CONTEXT] = now_ms() - t;
+
+    t = now_ms();
+    if (FT_Init_FreeType(&library) || FT_New_Face(library, o.font, 0, &face)) {
+        fprintf(stderr, "Failed to load font %s\n", o.font);
+        goto error;
+    }
+    if ((o.codepoints && parse_ranges(&codepoints, o.codepoints)) ||
+        (o.text && parse_text(&codepoints, o.text))) {
+        fprintf(stderr, "Invalid codepoints\n");
+        goto error;
+    }
+    size_t nmissing = filter_codepoints(&codepoints, face);
+    times[PHASE_CODEPOINTS] = now_ms() - t;
+
+    t = now_ms();
+    if (!(atlas = msdfgl_create_atlas(ctx, o.width, o.padding)) ||
+        msdfgl_set_atlas_format(atlas, o.format) || msdfgl_set_atlas_packer(atlas, o.packer) ||
+        msdfgl_set_atlas_page_height(atlas, o.page_height)) {
+        fprintf(stderr, "Failed to create atlas\n");
+        goto error;
+    }
+    if (!(font = msdfgl_load_font(ctx, o.font, o.range, o.scale, atlas))) {
+        fprintf(stderr, "Failed to load font %s\n", o.font);
+        goto error;
+    }
+    times[PHASE_FONT] = now_ms() - t;
+
+    /* Size the atlas once instead of growing it during generation. */
+    t = now_ms();
+    if (msdfgl_reserve_glyph_list(font, codepoints.codes, codepoints.n)) {
+        fprintf(stderr, "Failed to reserve the atlas\n");
+        goto error;
+    }
+    glFinish();
+    times[PHASE_RESERVE] = now_ms() - t;
+
+    t = now_ms();
+    if (codepoints.n && msdfgl_generate_glyph_list(font, codepoints.codes, codepoints.n) < 0) {
+        fprintf(stderr, "Failed to generate glyphs\n");
+        goto error;
+    }
+    glFinish();
+    times[PHASE_GENERATE] = now_ms() - t;
+
+    t = now_ms();
+    if (msdfgl_save_atlas(atlas, &font, 1, o.output)) {
+        fprintf(stderr, "Failed to write %s\n", o.output);
+        goto error;
+    }
+    times[PHASE_SAVE] = now_ms() - t;
+
+    t = now_ms();
+    if (o.metrics && write_metrics(o.metrics, face, &o, &codepoints)) {
+        fprintf(stderr, "Failed to write %s\n", o.metrics);
+        goto error;
+    }
+    times[PHASE_METRICS] = now_ms() - t;
+
+    printf("%-40s %zu glyphs, %zu missing, fill %.3f\n", o.font, codepoints.n, nmissing,
+           msdfgl_atlas_fill_ratio(atlas));
+    printf("%s\n", (const char *)glGetString(GL_RENDERER));
+    printf("%-12s %12s\n", "phase", "ms");
+    for (int i = 0; i < NPHASES; ++i)
+        printf("%-12s %12.3f\n", phase_names[i], times[i]);
+    printf("%-12s %12.3f\n", "total", now_ms() - start);
+    retval = 0;
+
+error:
+    if (font)
+        msdfgl_destroy_font(font);
+    if (atlas)
+        msdfgl_destroy_atlas(atlas);
+    if (ctx)
+        msdfgl_destroy_context(ctx);
+    if (face)
+        FT_Done_Face(face);
+    if (library)
+        FT_Done_FreeType(library);
+    if (context != EGL_NO_CONTEXT) {
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(display, context);
+    }
+    if (surface != EGL_NO_SURFACE)
+        eglDestroySurface(display, surface);
+    if (context != EGL_NO_CONTEXT)
+        eglTerminate(display);
+    free(codepoints.codes);
+    return retval;
+}